@@ -0,0 +1,146 @@
+//
+// Created by Pei Yuhang on 2023/6/3.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "benchutil.hpp"
+
+/*
+ * 运行时基准测试程序
+ *
+ * 用法：CP_Bench <编译器路径> <测试程序目录> [-o 输出文件] [-r 重复次数]
+ *
+ * 对测试程序目录下的每个 .c 文件，分别在 -O0 ~ -O3 四个优化级别、JIT 与 AOT 两种模式下编译并运行，
+ * 将编译耗时、JIT 耗时和运行耗时以 JSON 格式输出。每项耗时取多次重复中的最小值。
+ */
+
+struct BenchResult {
+    std::string program;    // 测试程序名称
+    unsigned optLevel;      // 优化级别
+    std::string mode;       // "jit" 或 "aot"
+    bool ok = true;         // 编译和运行是否均成功
+    double compileTime = std::numeric_limits<double>::infinity();
+    double jitTime = std::numeric_limits<double>::infinity();
+    double runTime = std::numeric_limits<double>::infinity();
+};
+
+/**
+ * @brief 以 JIT 模式编译并运行一次测试程序，耗时全部由编译器自身统计
+ */
+static bool RunJIT(const std::string &compiler, const fs::path &program, unsigned optLevel,
+                   const fs::path &workDir, BenchResult &result) {
+    const fs::path statsFile = workDir / "stats.json";
+    fs::remove(statsFile);
+
+    if (!RunCommand({ compiler, "-O" + std::to_string(optLevel), "-bench-json=" + statsFile.string(), program.string() },
+                    workDir))
+        return false;
+
+    const std::string stats = ReadFile(statsFile);
+    result.compileTime = std::min(result.compileTime, ReadJSONNumber(stats, "compile_seconds"));
+    result.jitTime = std::min(result.jitTime, ReadJSONNumber(stats, "jit_seconds"));
+    result.runTime = std::min(result.runTime, ReadJSONNumber(stats, "run_seconds"));
+    return true;
+}
+
+/**
+ * @brief 以 AOT 模式编译并运行一次测试程序，运行耗时为可执行文件的墙钟时间
+ */
+static bool RunAOT(const std::string &compiler, const fs::path &program, unsigned optLevel,
+                   const fs::path &workDir, BenchResult &result) {
+    const fs::path statsFile = workDir / "stats.json";
+    const fs::path exeFile = workDir / (program.stem().string() + "_O" + std::to_string(optLevel));
+    fs::remove(statsFile);
+
+    if (!RunCommand({ compiler, "-O" + std::to_string(optLevel), "-exec=false", "-exe=" + exeFile.string(),
+                      "-bench-json=" + statsFile.string(), program.string() }, workDir))
+        return false;
+
+    result.compileTime = std::min(result.compileTime, ReadJSONNumber(ReadFile(statsFile), "compile_seconds"));
+
+    auto runStart = std::chrono::steady_clock::now();
+    if (!RunCommand({ exeFile.string() }, workDir))
+        return false;
+    double runTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - runStart).count();
+    result.runTime = std::min(result.runTime, runTime);
+    return true;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " <compiler> <programs dir> [-o output.json] [-r repeats]" << std::endl;
+        return 1;
+    }
+
+    const std::string compiler = fs::absolute(argv[1]).string();
+    const fs::path programsDir = fs::absolute(argv[2]);
+    std::string outputFile;
+    unsigned repeats = 3;
+    for (int i = 3; i + 1 < argc; i += 2) {
+        if (std::strcmp(argv[i], "-o") == 0)
+            outputFile = argv[i + 1];
+        else if (std::strcmp(argv[i], "-r") == 0)
+            repeats = std::max(1, std::atoi(argv[i + 1]));
+    }
+
+    // 收集测试程序，按名称排序以保证输出顺序稳定，便于对比不同版本的结果
+    std::vector<fs::path> programs;
+    for (const auto &entry : fs::directory_iterator(programsDir))
+        if (entry.path().extension() == ".c")
+            programs.push_back(entry.path());
+    std::sort(programs.begin(), programs.end());
+
+    // 统计文件和可执行文件都写在临时目录中
+    char workDirTemplate[] = "/tmp/cp_bench_XXXXXX";
+    const fs::path workDir = mkdtemp(workDirTemplate);
+
+    std::vector<BenchResult> results;
+    for (const auto &program : programs) {
+        for (unsigned optLevel = 0; optLevel <= 3; ++optLevel) {
+            for (const std::string mode : { "jit", "aot" }) {
+                BenchResult result{ program.stem().string(), optLevel, mode };
+                for (unsigned i = 0; i < repeats && result.ok; ++i)
+                    result.ok = mode == "jit" ? RunJIT(compiler, program, optLevel, workDir, result)
+                                              : RunAOT(compiler, program, optLevel, workDir, result);
+                std::cerr << result.program << " -O" << optLevel << " " << mode << (result.ok ? "" : " FAILED") << std::endl;
+                results.push_back(result);
+            }
+        }
+    }
+
+    fs::remove_all(workDir);
+
+    std::ofstream outputFileStream;
+    if (!outputFile.empty())
+        outputFileStream.open(outputFile);
+    std::ostream &out = outputFile.empty() ? std::cout : outputFileStream;
+
+    out << "{\n  \"compiler\": \"" << compiler << "\",\n  \"repeats\": " << repeats << ",\n  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchResult &result = results[i];
+        out << "    {\"program\": \"" << result.program << "\", \"opt_level\": " << result.optLevel
+            << ", \"mode\": \"" << result.mode << "\", \"ok\": " << (result.ok ? "true" : "false") << ", ";
+        WriteJSONNumber(out, "compile_seconds", result.compileTime);
+        out << ", ";
+        WriteJSONNumber(out, "jit_seconds", result.mode == "jit" ? result.jitTime : std::numeric_limits<double>::infinity());
+        out << ", ";
+        WriteJSONNumber(out, "run_seconds", result.runTime);
+        out << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}" << std::endl;
+
+    bool allOk = std::all_of(results.begin(), results.end(), [](const BenchResult &result) { return result.ok; });
+    return allOk ? 0 : 1;
+}
@@ -0,0 +1,85 @@
+//
+// Created by Pei Yuhang on 2023/6/4.
+//
+
+#ifndef CP_PROJECT_BENCHUTIL_HPP
+#define CP_PROJECT_BENCHUTIL_HPP
+
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/* 基准测试程序共用的工具函数 */
+
+namespace fs = std::filesystem;
+
+/**
+ * @brief 在 workDir 下运行一个命令，标准输出和标准错误重定向到 /dev/null
+ * @param args 命令及其参数
+ * @param workDir 命令的工作目录
+ * @return 命令是否正常退出且退出码为 0
+ */
+inline bool RunCommand(const std::vector<std::string> &args, const fs::path &workDir) {
+    pid_t pid = fork();
+    if (pid < 0)
+        return false;
+
+    if (pid == 0) {
+        int devNull = open("/dev/null", O_WRONLY);
+        dup2(devNull, STDOUT_FILENO);
+        dup2(devNull, STDERR_FILENO);
+        if (chdir(workDir.c_str()) != 0)
+            _exit(127);
+
+        std::vector<char *> argv;
+        for (const auto &arg : args)
+            argv.push_back(const_cast<char *>(arg.c_str()));
+        argv.push_back(nullptr);
+        execv(argv[0], argv.data());
+        _exit(127);
+    }
+
+    int status;
+    waitpid(pid, &status, 0);
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+/**
+ * @brief 从编译器 -bench-json 输出的 JSON 中读取一个数值字段
+ * @param json JSON 文本
+ * @param key 字段名
+ * @param from 从该位置开始查找，用于读取嵌套对象中的字段
+ * @return 字段的值，字段不存在时返回无穷大
+ */
+inline double ReadJSONNumber(const std::string &json, const std::string &key, size_t from = 0) {
+    size_t pos = json.find("\"" + key + "\"", from);
+    if (pos == std::string::npos)
+        return std::numeric_limits<double>::infinity();
+    pos = json.find(':', pos);
+    return std::strtod(json.c_str() + pos + 1, nullptr);
+}
+
+inline std::string ReadFile(const fs::path &path) {
+    std::ifstream file(path);
+    std::stringstream content;
+    content << file.rdbuf();
+    return content.str();
+}
+
+inline void WriteJSONNumber(std::ostream &out, const char *key, double value) {
+    out << "\"" << key << "\": ";
+    if (value == std::numeric_limits<double>::infinity())
+        out << "null";
+    else
+        out << value;
+}
+
+#endif //CP_PROJECT_BENCHUTIL_HPP
@@ -0,0 +1,12 @@
+int fib(int n) {
+    int result = n;
+    if (1 < n) {
+        result = fib(n - 1) + fib(n - 2);
+    }
+    return result;
+}
+
+int main(void) {
+    printInt(fib(35));
+    return 0;
+}
@@ -0,0 +1,11 @@
+int main(void) {
+    int i, j, sum;
+    sum = 0;
+    for (i = 0; i < 20000; i = i + 1) {
+        for (j = 0; j < 5000; j = j + 1) {
+            sum = sum + i * j - sum / 3 * 2;
+        }
+    }
+    printInt(sum);
+    return 0;
+}
@@ -0,0 +1,26 @@
+int main(void) {
+    int a[200][200], b[200][200], c[200][200];
+    int i, j, k, sum;
+    for (i = 0; i < 200; i = i + 1) {
+        for (j = 0; j < 200; j = j + 1) {
+            a[i][j] = i + j;
+            b[i][j] = i - j;
+            c[i][j] = 0;
+        }
+    }
+    for (i = 0; i < 200; i = i + 1) {
+        for (k = 0; k < 200; k = k + 1) {
+            for (j = 0; j < 200; j = j + 1) {
+                c[i][j] = c[i][j] + a[i][k] * b[k][j];
+            }
+        }
+    }
+    sum = 0;
+    for (i = 0; i < 200; i = i + 1) {
+        for (j = 0; j < 200; j = j + 1) {
+            sum = sum + c[i][j];
+        }
+    }
+    printInt(sum);
+    return 0;
+}
@@ -0,0 +1,36 @@
+soa struct Particle {
+    float x;
+    float y;
+    float z;
+    float vx;
+    float vy;
+    float vz;
+    float mass;
+    int id;
+};
+
+const int N = 65536;
+
+struct Particle ps[N];
+
+int main(void) {
+    int i, step;
+    float sum;
+    for (i = 0; i < N; i = i + 1) {
+        ps[i].x = i % 100;
+        ps[i].vx = i % 7 * 0.001f;
+        ps[i].mass = 1.0f;
+        ps[i].id = i;
+    }
+    for (step = 0; step < 500; step = step + 1) {
+        for (i = 0; i < N; i = i + 1) {
+            ps[i].x = ps[i].x + ps[i].vx;
+        }
+    }
+    sum = 0.0f;
+    for (i = 0; i < N; i = i + 1) {
+        sum = sum + ps[i].x * ps[i].mass;
+    }
+    printFloat(sum);
+    return 0;
+}
@@ -0,0 +1,9 @@
+int main(void) {
+    int i;
+    for (i = 0; i < 200000; i = i + 1) {
+        printInt(i);
+        printChar('x');
+    }
+    printConstString("done");
+    return 0;
+}
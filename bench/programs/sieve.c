@@ -0,0 +1,20 @@
+int main(void) {
+    int composite[500000];
+    int i, j, count, round;
+    for (round = 0; round < 20; round = round + 1) {
+        for (i = 0; i < 500000; i = i + 1) {
+            composite[i] = 0;
+        }
+        count = 0;
+        for (i = 2; i < 500000; i = i + 1) {
+            if (composite[i] == 0) {
+                count = count + 1;
+                for (j = i + i; j < 500000; j = j + i) {
+                    composite[j] = 1;
+                }
+            }
+        }
+    }
+    printInt(count);
+    return 0;
+}
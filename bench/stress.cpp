@@ -0,0 +1,125 @@
+//
+// Created by Pei Yuhang on 2023/6/4.
+//
+
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "benchutil.hpp"
+#include "stressgen.hpp"
+
+/*
+ * 编译器可扩展性基准测试
+ *
+ * 用法：CP_Stress <编译器路径> [-o 输出文件] [-steps N]
+ *
+ * 以 StressConfig 的默认值为基准，每次只放大一个维度（函数数量、语句数量、嵌套深度、表达式长度、局部变量数量，
+ * 以及单条语句中的超长表达式），
+ * 每一步将该维度翻倍，生成程序后只编译不执行，记录编译器各阶段的耗时和峰值内存。
+ * 若某个阶段的耗时随规模翻倍而增长到约 4 倍，说明该阶段存在平方复杂度。
+ */
+
+// 编译器在 -bench-json 中输出的阶段名称
+static const char *Phases[] = { "parse", "codegen", "optimize", "emit" };
+
+struct StressAxis {
+    const char *name;                                   // 维度名称
+    unsigned start;                                     // 该维度的起始规模
+    std::function<void(StressConfig &, unsigned)> set;  // 将规模写入 StressConfig
+};
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <compiler> [-o output.json] [-steps N]" << std::endl;
+        return 1;
+    }
+
+    const std::string compiler = fs::absolute(argv[1]).string();
+    std::string outputFile;
+    unsigned steps = 5;
+    for (int i = 2; i + 1 < argc; i += 2) {
+        if (std::strcmp(argv[i], "-o") == 0)
+            outputFile = argv[i + 1];
+        else if (std::strcmp(argv[i], "-steps") == 0)
+            steps = std::max(1, std::atoi(argv[i + 1]));
+    }
+
+    const std::vector<StressAxis> axes = {
+        { "functions", 100, [](StressConfig &config, unsigned n) { config.functions = n; } },
+        { "stmts", 100, [](StressConfig &config, unsigned n) { config.stmts = n; } },
+        { "depth", 16, [](StressConfig &config, unsigned n) { config.depth = n; } },
+        { "expr_length", 64, [](StressConfig &config, unsigned n) { config.exprLength = n; } },
+        { "locals", 64, [](StressConfig &config, unsigned n) { config.locals = n; } },
+        // 只有一条语句的超长表达式，检查代码生成的栈深度不随表达式长度增长
+        { "long_expr", 65536, [](StressConfig &config, unsigned n) {
+            config.functions = 1;
+            config.stmts = 1;
+            config.exprLength = n;
+        } },
+    };
+
+    // 统计文件和可执行文件都写在临时目录中
+    char workDirTemplate[] = "/tmp/cp_stress_XXXXXX";
+    const fs::path workDir = mkdtemp(workDirTemplate);
+    const fs::path programFile = workDir / "stress.c";
+    const fs::path statsFile = workDir / "stats.json";
+
+    std::ofstream outputFileStream;
+    if (!outputFile.empty())
+        outputFileStream.open(outputFile);
+    std::ostream &out = outputFile.empty() ? std::cout : outputFileStream;
+
+    out << "{\n  \"compiler\": \"" << compiler << "\",\n  \"results\": [\n";
+    bool first = true, allOk = true;
+    for (const auto &axis : axes) {
+        for (unsigned step = 0, size = axis.start; step < steps; ++step, size *= 2) {
+            StressConfig config;
+            axis.set(config, size);
+            {
+                std::ofstream program(programFile);
+                GenerateProgram(program, config);
+            }
+
+            fs::remove(statsFile);
+            bool ok = RunCommand({ compiler, "-exec=false", "-bench-json=" + statsFile.string(), programFile.string() },
+                                 workDir);
+            allOk = allOk && ok;
+            std::cerr << axis.name << " = " << size << (ok ? "" : " FAILED") << std::endl;
+
+            out << (first ? "" : ",\n") << "    {\"axis\": \"" << axis.name << "\", \"size\": " << size
+                << ", \"source_bytes\": " << fs::file_size(programFile) << ", \"ok\": " << (ok ? "true" : "false");
+            first = false;
+            if (ok) {
+                const std::string stats = ReadFile(statsFile);
+                out << ", ";
+                WriteJSONNumber(out, "compile_seconds", ReadJSONNumber(stats, "compile_seconds"));
+                for (const char *phase : Phases) {
+                    size_t phasePos = stats.find(std::string("\"") + phase + "\"");
+                    out << ", \"" << phase << "\": {";
+                    WriteJSONNumber(out, "seconds", phasePos == std::string::npos
+                                                    ? std::numeric_limits<double>::infinity()
+                                                    : ReadJSONNumber(stats, "seconds", phasePos));
+                    out << ", ";
+                    WriteJSONNumber(out, "peak_rss_kb", phasePos == std::string::npos
+                                                        ? std::numeric_limits<double>::infinity()
+                                                        : ReadJSONNumber(stats, "peak_rss_kb", phasePos));
+                    out << "}";
+                }
+            }
+            out << "}";
+        }
+    }
+    out << "\n  ]\n}" << std::endl;
+
+    fs::remove_all(workDir);
+    return allOk ? 0 : 1;
+}
@@ -0,0 +1,44 @@
+//
+// Created by Pei Yuhang on 2023/6/4.
+//
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "stressgen.hpp"
+
+/*
+ * 用法：CP_StressGen [-functions N] [-stmts N] [-depth N] [-expr-length N] [-locals N]
+ *
+ * 按照给定参数生成一个测试程序，输出到标准输出
+ */
+
+int main(int argc, char **argv) {
+    StressConfig config;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        unsigned value = std::strtoul(argv[i + 1], nullptr, 10);
+        if (std::strcmp(argv[i], "-functions") == 0)
+            config.functions = value;
+        else if (std::strcmp(argv[i], "-stmts") == 0)
+            config.stmts = value;
+        else if (std::strcmp(argv[i], "-depth") == 0)
+            config.depth = value;
+        else if (std::strcmp(argv[i], "-expr-length") == 0)
+            config.exprLength = value;
+        else if (std::strcmp(argv[i], "-locals") == 0)
+            config.locals = value;
+        else {
+            std::cerr << "Unknown option " << argv[i] << std::endl;
+            return 1;
+        }
+    }
+
+    if (config.locals == 0 || config.exprLength == 0) {
+        std::cerr << "-locals and -expr-length must be positive" << std::endl;
+        return 1;
+    }
+
+    GenerateProgram(std::cout, config);
+    return 0;
+}
@@ -0,0 +1,98 @@
+//
+// Created by Pei Yuhang on 2023/6/4.
+//
+
+#ifndef CP_PROJECT_STRESSGEN_HPP
+#define CP_PROJECT_STRESSGEN_HPP
+
+#include <ostream>
+#include <string>
+
+/*
+ * 编译器可扩展性测试的程序生成器
+ *
+ * 生成的程序只使用语言当前支持的语法：局部变量都在函数开头定义，
+ * 语句都是赋值表达式语句，嵌套结构按 Block、IfStmt、ForStmt 的顺序循环出现。
+ */
+
+struct StressConfig {
+    unsigned functions = 10;    // 函数数量（不含 main）
+    unsigned stmts = 10;        // 每个函数中的语句数量
+    unsigned depth = 1;         // 语句所在的 Block/IfStmt/ForStmt 嵌套深度
+    unsigned exprLength = 4;    // 每个表达式中的操作数数量
+    unsigned locals = 4;        // 每个函数中的局部变量数量，至少为 1
+};
+
+/**
+ * @brief 生成一个形如 v0 + v1 * 3 - v2 / 7 ... 的表达式
+ * @param out 输出流
+ * @param config 生成参数
+ * @param seed 用于改变操作数和运算符的选择，使不同语句的表达式不同
+ */
+inline void GenerateExpr(std::ostream &out, const StressConfig &config, unsigned seed) {
+    static const char *operators[] = { " + ", " - ", " * ", " / " };
+    for (unsigned i = 0; i < config.exprLength; ++i) {
+        if (i > 0)
+            out << operators[(seed + i) % 4];
+        // 除法的右操作数总是非零常量，避免生成除零的程序
+        if (i > 0 && (seed + i) % 4 == 3)
+            out << (seed + i) % 7 + 1;
+        else
+            out << "v" << (seed * 31 + i) % config.locals;
+    }
+}
+
+/**
+ * @brief 生成第 index 个函数，函数调用前一个函数，使所有函数都可达
+ */
+inline void GenerateFunc(std::ostream &out, const StressConfig &config, unsigned index) {
+    out << "int f" << index << "(int a, int b) {\n";
+
+    // 局部变量都在函数开头定义
+    out << "    int ";
+    for (unsigned i = 0; i < config.locals; ++i)
+        out << (i ? ", " : "") << "v" << i << " = " << i + 1;
+    out << ";\n";
+
+    // 进入 depth 层嵌套结构
+    std::string indent = "    ";
+    for (unsigned level = 0; level < config.depth; ++level) {
+        switch (level % 3) {
+            case 0: out << indent << "{\n"; break;
+            case 1: out << indent << "if (v0 < " << 1000 + level << ") {\n"; break;
+            // 循环变量使用形参 a，循环体只给局部变量赋值，保证生成的程序能够结束
+            case 2: out << indent << "for (a = 0; a < 2; a = a + 1) {\n"; break;
+        }
+        indent += "    ";
+    }
+
+    for (unsigned i = 0; i < config.stmts; ++i) {
+        out << indent << "v" << i % config.locals << " = ";
+        GenerateExpr(out, config, index * config.stmts + i);
+        out << ";\n";
+    }
+
+    for (unsigned level = 0; level < config.depth; ++level) {
+        indent.resize(indent.size() - 4);
+        out << indent << "}\n";
+    }
+
+    if (index > 0)
+        out << "    v0 = v0 + f" << index - 1 << "(a, b);\n";
+    out << "    return v0 + a - b;\n}\n\n";
+}
+
+/**
+ * @brief 按照 config 生成一个完整的程序
+ */
+inline void GenerateProgram(std::ostream &out, const StressConfig &config) {
+    for (unsigned i = 0; i < config.functions; ++i)
+        GenerateFunc(out, config, i);
+
+    out << "int main(void) {\n";
+    if (config.functions > 0)
+        out << "    printInt(f" << config.functions - 1 << "(1, 2));\n";
+    out << "    return 0;\n}\n";
+}
+
+#endif //CP_PROJECT_STRESSGEN_HPP
@@ -0,0 +1,360 @@
+//
+// Created by Pei Yuhang on 2023/6/7.
+//
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include <fcntl.h>
+#include <stdio_ext.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "executor.h"
+#include "../runtime/parallel.h"
+
+/* worker 每完成一次运行向进程池发送的消息 */
+struct WorkerMessage {
+    RunResult result;
+    double processCpuSeconds;   // worker 进程累计使用的 CPU 时间，用于计算被终止的运行的 CPU 时间
+};
+
+/**
+ * @brief 读取 /proc/self/status 中以 KB 为单位的一项，例如 VmHWM、VmSize
+ * @return 该项的值，不存在时为 0
+ */
+static long ReadProcStatus(const std::string &field) {
+    std::ifstream status("/proc/self/status");
+    for (std::string line; std::getline(status, line);)
+        if (line.compare(0, field.size() + 1, field + ":") == 0)
+            return std::stol(line.substr(field.size() + 1));
+    return 0;
+}
+
+/**
+ * @brief 获取进程累计使用的 CPU 时间（秒）
+ */
+static double GetProcessCpuSeconds() {
+    timespec time{};
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time);
+    return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+/**
+ * @brief 将当前进程的 CPU 计时器设为 seconds 秒，到期时 SIGPROF 终止进程；seconds 为 0 时关闭计时器
+ */
+void SetCpuTimer(double seconds) {
+    itimerval timer{};
+    timer.it_value.tv_sec = static_cast<time_t>(seconds);
+    timer.it_value.tv_usec = static_cast<suseconds_t>((seconds - timer.it_value.tv_sec) * 1e6);
+    setitimer(ITIMER_PROF, &timer, nullptr);
+}
+
+/**
+ * @brief 以当前进程的大小为基准限制地址空间，只允许额外使用 extraBytes 字节；extraBytes 为 0 时不限制
+ */
+void SetAddressSpaceLimit(size_t extraBytes) {
+    if (!extraBytes)
+        return;
+    rlim_t addressSpace = ReadProcStatus("VmSize") * 1024 + extraBytes;
+    rlimit limit{ addressSpace, addressSpace };
+    setrlimit(RLIMIT_AS, &limit);
+}
+
+/**
+ * @brief 限制当前进程写入的文件大小，超过时 SIGXFSZ 终止进程；bytes 为 0 时不限制
+ */
+void SetOutputLimit(size_t bytes) {
+    rlimit limit{ RLIM_INFINITY, RLIM_INFINITY };
+    if (bytes)
+        limit.rlim_cur = limit.rlim_max = bytes;
+    setrlimit(RLIMIT_FSIZE, &limit);
+}
+
+/**
+ * @brief 创建进程池，调用前 mainFunc 所在的代码必须已经完成 JIT 编译
+ * @param mainFunc main 函数
+ * @param globals 可写的全局变量，每次运行前恢复为此时的内容
+ * @param inputs 各次运行的命令行参数和标准输入，运行次数为其长度
+ * @param workerCount worker 数量
+ * @param limits 每次运行的资源限制
+ * @param onSpawn 每 fork 一个 worker（包括代替被终止的 worker）后调用，在 worker 开始运行之前完成，可以为空
+ */
+ExecutorPool::ExecutorPool(MainFunction mainFunc, GlobalData globals, std::vector<RunInput> inputs, unsigned workerCount,
+                           RunLimits limits, std::function<void(pid_t)> onSpawn)
+    : mainFunc(mainFunc), globals(std::move(globals)), inputs(std::move(inputs)), limits(std::move(limits)),
+      onSpawn(std::move(onSpawn)), workers(std::max(1u, workerCount)) {
+    for (const auto &global : this->globals)
+        this->initialGlobals.emplace_back(static_cast<const char *>(global.first), global.second);
+    void *baselines = mmap(nullptr, std::max<size_t>(1, this->inputs.size()) * sizeof(long), PROT_READ | PROT_WRITE,
+                           MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (baselines == MAP_FAILED)
+        throw std::runtime_error(std::string("Cannot map shared memory: ") + std::strerror(errno));
+    this->baselineRSS = static_cast<long *>(baselines);
+    for (auto &worker : this->workers)
+        SpawnWorker(worker);
+}
+
+ExecutorPool::~ExecutorPool() {
+    for (auto &worker : this->workers)
+        StopWorker(worker);
+    munmap(this->baselineRSS, std::max<size_t>(1, this->inputs.size()) * sizeof(long));
+}
+
+/**
+ * @brief fork 一个新的 worker
+ */
+void ExecutorPool::SpawnWorker(Worker &worker) {
+    int jobPipe[2], resultPipe[2];
+    if (pipe(jobPipe) < 0 || pipe(resultPipe) < 0)
+        throw std::runtime_error(std::string("Cannot create pipe: ") + std::strerror(errno));
+
+    // fork 之前清空缓冲区，避免 worker 重复输出进程池尚未写出的内容
+    std::fflush(nullptr);
+    pid_t pid = fork();
+    if (pid < 0)
+        throw std::runtime_error(std::string("Cannot fork: ") + std::strerror(errno));
+
+    if (pid == 0) {
+        // 关闭其他 worker 的管道，使进程池关闭管道时其他 worker 能读到 EOF
+        for (const auto &other : this->workers)
+            if (other.pid > 0) {
+                close(other.jobFd);
+                close(other.resultFd);
+            }
+        close(jobPipe[1]);
+        close(resultPipe[0]);
+        WorkerLoop(jobPipe[0], resultPipe[1]);
+    }
+
+    close(jobPipe[0]);
+    close(resultPipe[1]);
+    worker = Worker();
+    worker.pid = pid;
+    worker.jobFd = jobPipe[1];
+    worker.resultFd = resultPipe[0];
+    if (this->onSpawn)
+        this->onSpawn(pid);
+}
+
+/**
+ * @brief 关闭 worker 的管道并等待其退出，worker 读到 EOF 后会自行退出
+ */
+void ExecutorPool::StopWorker(Worker &worker) {
+    if (worker.pid <= 0)
+        return;
+    close(worker.jobFd);
+    close(worker.resultFd);
+    waitpid(worker.pid, nullptr, 0);
+    worker.pid = -1;
+}
+
+/**
+ * @brief 将编号为 index 的运行分配给空闲的 worker
+ */
+void ExecutorPool::Dispatch(Worker &worker, unsigned index) {
+    worker.currentRun = static_cast<int>(index);
+    worker.runStart = std::chrono::steady_clock::now();
+    if (write(worker.jobFd, &index, sizeof(index)) != sizeof(index))
+        throw std::runtime_error(std::string("Cannot dispatch run to worker: ") + std::strerror(errno));
+}
+
+/**
+ * @brief 对每个输入运行一次程序，各次运行按 worker 的空闲情况分配
+ * @return 按运行编号排列的运行结果
+ */
+std::vector<RunResult> ExecutorPool::Run() {
+    const auto runCount = static_cast<unsigned>(this->inputs.size());
+    std::vector<RunResult> results(runCount);
+    unsigned nextRun = 0, finished = 0;
+
+    for (auto &worker : this->workers)
+        if (nextRun < runCount)
+            Dispatch(worker, nextRun++);
+
+    std::vector<pollfd> pollFds(this->workers.size());
+    while (finished < runCount) {
+        for (size_t i = 0; i < this->workers.size(); ++i)
+            pollFds[i] = { this->workers[i].currentRun >= 0 ? this->workers[i].resultFd : -1, POLLIN, 0 };
+        if (poll(pollFds.data(), pollFds.size(), -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            throw std::runtime_error(std::string("Cannot poll workers: ") + std::strerror(errno));
+        }
+
+        for (size_t i = 0; i < this->workers.size(); ++i) {
+            Worker &worker = this->workers[i];
+            if (worker.currentRun < 0 || !(pollFds[i].revents & (POLLIN | POLLHUP | POLLERR)))
+                continue;
+
+            WorkerMessage message{};
+            if (read(worker.resultFd, &message, sizeof(message)) == sizeof(message)) {
+                results[message.result.index] = message.result;
+                worker.cpuSeconds = message.processCpuSeconds;
+            } else {
+                // 管道被关闭说明 worker 在运行中被信号终止，用 wait4 得到的资源使用量补全结果
+                int status = 0;
+                rusage usage{};
+                wait4(worker.pid, &status, 0, &usage);
+                RunResult &result = results[worker.currentRun];
+                result.index = worker.currentRun;
+                result.signal = WIFSIGNALED(status) ? WTERMSIG(status) : 0;
+                result.exitCode = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+                result.cpuSeconds = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6
+                                    + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6 - worker.cpuSeconds;
+                result.wallSeconds =
+                        std::chrono::duration<double>(std::chrono::steady_clock::now() - worker.runStart).count();
+                // worker 的峰值常驻内存在运行开始时被重置，退出时的 ru_maxrss 即本次运行期间的峰值
+                result.peakRSS = std::max(0L, usage.ru_maxrss - this->baselineRSS[result.index]);
+                if (!this->limits.outputDir.empty()) {
+                    struct stat outputStat{};
+                    if (stat((this->limits.outputDir + "/" + std::to_string(result.index) + ".out").c_str(), &outputStat) == 0)
+                        result.outputBytes = outputStat.st_size;
+                }
+
+                close(worker.jobFd);
+                close(worker.resultFd);
+                worker.pid = -1;
+                SpawnWorker(worker);
+            }
+
+            ++finished;
+            worker.currentRun = -1;
+            if (nextRun < runCount)
+                Dispatch(worker, nextRun++);
+        }
+    }
+
+    return results;
+}
+
+/**
+ * @brief worker 的主循环：设置地址空间限制后，逐个读取运行编号并运行，直到管道被关闭
+ */
+void ExecutorPool::WorkerLoop(int jobFd, int resultFd) {
+    // 地址空间限制以 worker 当前的大小为基准，只限制运行时额外使用的部分（主要是栈上的局部数组）；
+    // parallel for 的线程池在此之前创建，线程的栈不计入限制，不会在运行中因 -run-mem-limit 而无法创建线程
+    cp_parallel_start();
+    SetAddressSpaceLimit(this->limits.memoryBytes);
+
+    // 不保存输出时，写入一个每次运行前清空的临时文件，仍然可以统计输出大小并施加限制
+    FILE *scratchFile = this->limits.outputDir.empty() ? std::tmpfile() : nullptr;
+    int scratchFd = scratchFile ? fileno(scratchFile) : -1;
+
+    // worker 的初始常驻内存包括 fork 时继承的编译器和 JIT 代码，从每次运行的峰值中减去；
+    // 以第一次运行之前而不是每次运行之前为基准，前几次运行留下的栈页不会使之后的运行显得不占内存
+    const long baselineRSS = ReadProcStatus("VmRSS");
+
+    for (unsigned index; read(jobFd, &index, sizeof(index)) == sizeof(index);) {
+        WorkerMessage message{ RunOnce(index, scratchFd, baselineRSS), GetProcessCpuSeconds() };
+        if (write(resultFd, &message, sizeof(message)) != sizeof(message))
+            break;
+    }
+    _exit(0);
+}
+
+/**
+ * @brief 在 worker 进程内运行一次程序
+ * @param index 运行编号
+ * @param scratchFd 不保存输出时使用的临时文件
+ * @param baselineRSS worker 的初始常驻内存（KB）
+ * @return 运行结果
+ */
+RunResult ExecutorPool::RunOnce(unsigned index, int scratchFd, long baselineRSS) {
+    int outputFd = scratchFd;
+    if (outputFd >= 0) {
+        ftruncate(outputFd, 0);
+        lseek(outputFd, 0, SEEK_SET);
+    } else {
+        const std::string outputFile = this->limits.outputDir + "/" + std::to_string(index) + ".out";
+        outputFd = open(outputFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    }
+    dup2(outputFd, STDOUT_FILENO);
+
+    // 标准输入重定向到本次运行的输入文件，并丢弃上一次运行在 stdin 缓冲区中剩余的内容
+    const RunInput &input = this->inputs[index];
+    RunResult result;
+    result.index = index;
+    int inputFd = open(input.inputFile.empty() ? "/dev/null" : input.inputFile.c_str(), O_RDONLY);
+    if (inputFd < 0) {
+        result.inputError = true;
+        if (outputFd != scratchFd)
+            close(outputFd);
+        return result;
+    }
+    dup2(inputFd, STDIN_FILENO);
+    close(inputFd);
+    __fpurge(stdin);
+    std::clearerr(stdin);
+
+    // 恢复全局变量的初始值，使每次运行互不影响
+    for (size_t i = 0; i < this->globals.size(); ++i)
+        std::memcpy(this->globals[i].first, this->initialGlobals[i].data(), this->globals[i].second);
+
+    // 从 Linux 4.0 开始，向 clear_refs 写入 5 可以把峰值常驻内存重置为当前值
+    std::ofstream("/proc/self/clear_refs") << "5";
+    this->baselineRSS[index] = baselineRSS;
+
+    // 输出超过限制时 SIGXFSZ 终止 worker
+    SetOutputLimit(this->limits.outputBytes);
+
+    // argv 按 C 的约定以空指针结尾，字符串指向 inputs 中的参数，在本次运行期间有效
+    std::vector<char *> argv;
+    for (const std::string &arg : input.args)
+        argv.push_back(const_cast<char *>(arg.c_str()));
+    argv.push_back(nullptr);
+
+    SetCpuTimer(this->limits.cpuSeconds);
+    double cpuStart = GetProcessCpuSeconds();
+    auto wallStart = std::chrono::steady_clock::now();
+
+    result.exitCode = this->mainFunc(static_cast<int>(input.args.size()), argv.data());
+    // 缓冲区中的输出也计入本次运行，须在计时结束前写出
+    std::fflush(stdout);
+
+    result.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+    result.cpuSeconds = GetProcessCpuSeconds() - cpuStart;
+    SetCpuTimer(0);
+
+    result.peakRSS = std::max(0L, ReadProcStatus("VmHWM") - baselineRSS);
+    result.outputBytes = lseek(STDOUT_FILENO, 0, SEEK_END);
+    if (outputFd != scratchFd)
+        close(outputFd);
+    return result;
+}
+
+/**
+ * @brief 以 JSON 格式输出各次运行的结果
+ * @param out 输出流
+ * @param results 运行结果
+ * @param wallSeconds 全部运行的墙钟时间
+ */
+void WriteRunReport(std::ostream &out, const std::vector<RunResult> &results, double wallSeconds) {
+    out << "{\"runs\": " << results.size() << ", \"wall_seconds\": " << wallSeconds << ", \"results\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const RunResult &result = results[i];
+        // 被终止的原因：SIGPROF 来自 CPU 计时器，SIGXFSZ 来自输出大小限制；无法打开输入文件时没有运行
+        const char *status = result.inputError ? "input_error"
+                            : result.signal == 0 ? "ok"
+                            : result.signal == SIGPROF ? "cpu_limit"
+                            : result.signal == SIGXFSZ ? "output_limit"
+                                                       : "signal";
+        out << "  {\"run\": " << result.index << ", \"status\": \"" << status << "\", \"exit_code\": " << result.exitCode
+            << ", \"signal\": " << result.signal << ", \"cpu_seconds\": " << result.cpuSeconds
+            << ", \"wall_seconds\": " << result.wallSeconds << ", \"peak_rss_kb\": " << result.peakRSS
+            << ", \"output_bytes\": " << result.outputBytes << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "]}" << std::endl;
+}
@@ -0,0 +1,115 @@
+//
+// Created by Pei Yuhang on 2023/6/7.
+//
+
+#ifndef CP_PROJECT_EXECUTOR_H
+#define CP_PROJECT_EXECUTOR_H
+
+#include <chrono>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <sys/types.h>
+
+/* JIT 编译后的 main 函数，形参为空或为 (int argc, char **argv) */
+struct MainFunction {
+    void *address = nullptr;    // main 函数的地址
+    bool hasArgs = false;       // 是否接收 argc 和 argv
+
+    /**
+     * @brief 调用 main 函数，不接收参数时忽略 argc 和 argv
+     */
+    int operator()(int argc, char **argv) const {
+        return this->hasArgs ? reinterpret_cast<int (*)(int, char **)>(this->address)(argc, argv)
+                             : reinterpret_cast<int (*)()>(this->address)();
+    }
+};
+
+// JIT 编译后可写的全局变量的地址和大小
+using GlobalData = std::vector<std::pair<void *, size_t>>;
+
+/* 每次运行的资源限制，取值为 0 表示不限制 */
+struct RunLimits {
+    double cpuSeconds = 0;      // CPU 时间（秒）
+    size_t memoryBytes = 0;     // 运行时可以额外使用的地址空间（字节）
+    size_t outputBytes = 0;     // 标准输出的大小（字节）
+    std::string outputDir;      // 每次运行的标准输出写入 <outputDir>/<编号>.out，为空时丢弃
+};
+
+/* 一次运行的输入 */
+struct RunInput {
+    std::vector<std::string> args;  // 传给 main 的 argv，第一项为程序名
+    std::string inputFile;          // 重定向到标准输入的文件，为空时从 /dev/null 读取
+};
+
+/* 一次运行的结果 */
+struct RunResult {
+    unsigned index = 0;         // 运行编号
+    int exitCode = -1;          // main 函数的返回值，被信号终止时为 -1
+    int signal = 0;             // 终止运行的信号，正常结束时为 0
+    double cpuSeconds = 0;      // CPU 时间（秒）
+    double wallSeconds = 0;     // 墙钟时间（秒）
+    long peakRSS = 0;           // 运行期间常驻内存的峰值超出 worker 初始大小的部分（KB），不含 worker 自身的编译器和 JIT 代码
+    size_t outputBytes = 0;     // 标准输出的字节数
+    bool inputError = false;    // 无法打开输入文件，没有运行
+};
+
+/**
+ * @brief 预先 fork 的执行进程池，用于大量、重复地运行同一个 JIT 编译后的程序
+ *
+ * 每个 worker 是从已完成 JIT 编译的进程 fork 出来的，直接在进程内调用 main 函数，每次运行都不需要重新编译或 exec。
+ * 超出 CPU 时间或输出大小限制的运行会被信号终止，worker 随之退出，进程池会 fork 一个新的 worker 代替它。
+ * 同一个 worker 中的多次运行共享进程状态，但每次运行前可写的全局变量会被恢复为初始值。
+ * 每次运行有各自的命令行参数和标准输入，在创建进程池时给出，worker 按运行编号取用。
+ */
+class ExecutorPool {
+public:
+    ExecutorPool(MainFunction mainFunc, GlobalData globals, std::vector<RunInput> inputs, unsigned workerCount,
+                 RunLimits limits, std::function<void(pid_t)> onSpawn = nullptr);
+
+    ~ExecutorPool();
+
+    std::vector<RunResult> Run();
+
+private:
+    struct Worker {
+        pid_t pid = -1;
+        int jobFd = -1;             // 向 worker 发送运行编号的管道
+        int resultFd = -1;          // 从 worker 读取运行结果的管道
+        int currentRun = -1;        // 正在进行的运行编号，空闲时为 -1
+        double cpuSeconds = 0;      // worker 在已完成的运行结束时累计使用的 CPU 时间
+        std::chrono::steady_clock::time_point runStart;
+    };
+
+    void SpawnWorker(Worker &worker);
+
+    void StopWorker(Worker &worker);
+
+    void Dispatch(Worker &worker, unsigned index);
+
+    [[noreturn]] void WorkerLoop(int jobFd, int resultFd);
+
+    RunResult RunOnce(unsigned index, int scratchFd, long baselineRSS);
+
+    MainFunction mainFunc;
+    GlobalData globals;
+    std::vector<std::string> initialGlobals;    // 创建进程池时各全局变量的内容
+    std::vector<RunInput> inputs;   // 各次运行的输入，按运行编号排列
+    long *baselineRSS = nullptr;    // 各次运行所在 worker 的初始常驻内存（KB），与 worker 共享，worker 被终止时仍可读取
+    RunLimits limits;
+    std::function<void(pid_t)> onSpawn;     // 每 fork 一个 worker 后在进程池中调用，参数为 worker 的 pid
+    std::vector<Worker> workers;
+};
+
+void SetCpuTimer(double seconds);
+
+void SetAddressSpaceLimit(size_t extraBytes);
+
+void SetOutputLimit(size_t bytes);
+
+void WriteRunReport(std::ostream &out, const std::vector<RunResult> &results, double wallSeconds);
+
+#endif //CP_PROJECT_EXECUTOR_H
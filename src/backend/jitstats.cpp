@@ -0,0 +1,33 @@
+//
+// Created by Pei Yuhang on 2023/6/11.
+//
+
+#include "jitstats.h"
+
+/**
+ * @brief 目标文件被 JIT 加载后，统计其中定义的函数符号
+ * @param key 目标文件的编号（未使用）
+ * @param obj 被加载的目标文件
+ * @param loadedInfo 目标文件各节加载到内存后的信息（未使用）
+ */
+void FunctionCountListener::notifyObjectLoaded(ObjectKey key, const llvm::object::ObjectFile &obj,
+                                               const llvm::RuntimeDyld::LoadedObjectInfo &loadedInfo) {
+    for (const auto &symbol : obj.symbols()) {
+        // 未定义的符号是对其他目标文件、运行时库或 C 库函数的引用，不在此处生成
+        llvm::Expected<uint32_t> flags = symbol.getFlags();
+        if (!flags) {
+            llvm::consumeError(flags.takeError());
+            continue;
+        }
+        if (*flags & llvm::object::SymbolRef::SF_Undefined)
+            continue;
+
+        llvm::Expected<llvm::object::SymbolRef::Type> symbolType = symbol.getType();
+        if (!symbolType) {
+            llvm::consumeError(symbolType.takeError());
+            continue;
+        }
+        if (*symbolType == llvm::object::SymbolRef::ST_Function)
+            ++this->functionCount;
+    }
+}
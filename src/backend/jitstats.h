@@ -0,0 +1,32 @@
+//
+// Created by Pei Yuhang on 2023/6/11.
+//
+
+#ifndef CP_PROJECT_JITSTATS_H
+#define CP_PROJECT_JITSTATS_H
+
+#include <llvm/ExecutionEngine/JITEventListener.h>
+#include <llvm/ExecutionEngine/RuntimeDyld.h>
+#include <llvm/Object/ObjectFile.h>
+
+/**
+ * @brief 统计 JIT 加载的目标文件中定义的函数数量
+ *
+ * MCJIT 在 finalizeObject() 时把整个 module 编译为目标文件后加载，增量编译时直接加载各编译单元的目标文件，
+ * 两种情况下都通过 notifyObjectLoaded() 得到实际生成了机器码的函数。
+ */
+class FunctionCountListener : public llvm::JITEventListener {
+public:
+    void notifyObjectLoaded(ObjectKey key, const llvm::object::ObjectFile &obj,
+                            const llvm::RuntimeDyld::LoadedObjectInfo &loadedInfo) override;
+
+    /**
+     * @brief 获取已加载的函数数量
+     */
+    size_t GetFunctionCount() const { return this->functionCount; }
+
+private:
+    size_t functionCount = 0;   // 已加载的目标文件中定义的函数数量
+};
+
+#endif //CP_PROJECT_JITSTATS_H
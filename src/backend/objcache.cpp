@@ -0,0 +1,52 @@
+//
+// Created by Pei Yuhang on 2023/6/6.
+//
+
+#include <stdexcept>
+#include <utility>
+
+#include <unistd.h>
+
+#include <llvm/Support/FileSystem.h>
+
+#include "objcache.h"
+
+/**
+ * @brief 打开缓存目录，目录不存在时创建
+ * @param dir 缓存目录
+ */
+ObjectCache::ObjectCache(std::string dir) : dir(std::move(dir)) {
+    if (std::error_code errorCode = llvm::sys::fs::create_directories(this->dir))
+        throw std::runtime_error("Cannot create cache directory " + this->dir + ": " + errorCode.message());
+}
+
+/**
+ * @brief 获取指纹对应的目标文件的路径
+ */
+std::string ObjectCache::GetPath(const std::string &fingerprint) const {
+    return this->dir + "/" + fingerprint + ".o";
+}
+
+/**
+ * @brief 判断缓存中是否已有指纹对应的目标文件
+ */
+bool ObjectCache::Contains(const std::string &fingerprint) const {
+    return llvm::sys::fs::exists(GetPath(fingerprint));
+}
+
+/**
+ * @brief 获取写入指纹对应的目标文件时使用的临时文件路径，路径中包含进程号，避免并发的编译器互相覆盖
+ */
+std::string ObjectCache::GetTempPath(const std::string &fingerprint) const {
+    return GetPath(fingerprint) + ".tmp" + std::to_string(getpid());
+}
+
+/**
+ * @brief 将写好的临时文件重命名为指纹对应的目标文件，使其对之后的编译可见
+ * @param tempPath GetTempPath() 返回的临时文件路径
+ * @param fingerprint 编译单元的指纹
+ */
+void ObjectCache::Commit(const std::string &tempPath, const std::string &fingerprint) const {
+    if (std::error_code errorCode = llvm::sys::fs::rename(tempPath, GetPath(fingerprint)))
+        throw std::runtime_error("Cannot write cache entry " + GetPath(fingerprint) + ": " + errorCode.message());
+}
@@ -0,0 +1,31 @@
+//
+// Created by Pei Yuhang on 2023/6/6.
+//
+
+#ifndef CP_PROJECT_OBJCACHE_H
+#define CP_PROJECT_OBJCACHE_H
+
+#include <string>
+
+/**
+ * @brief 增量编译的目标文件缓存，每个编译单元的目标文件以其指纹命名，保存在缓存目录中
+ *
+ * 写入时先写临时文件再重命名，因此即使编译中途退出或多个编译器同时运行，缓存中也不会出现不完整的文件。
+ */
+class ObjectCache {
+public:
+    explicit ObjectCache(std::string dir);
+
+    std::string GetPath(const std::string &fingerprint) const;
+
+    bool Contains(const std::string &fingerprint) const;
+
+    std::string GetTempPath(const std::string &fingerprint) const;
+
+    void Commit(const std::string &tempPath, const std::string &fingerprint) const;
+
+private:
+    std::string dir;    // 缓存目录
+};
+
+#endif //CP_PROJECT_OBJCACHE_H
@@ -0,0 +1,90 @@
+//
+// Created by Pei Yuhang on 2023/6/2.
+//
+
+#include <cerrno>
+#include <cstring>
+#include <string>
+
+#include <unistd.h>
+
+#include <llvm/Object/SymbolSize.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Format.h>
+
+#include "perfmap.h"
+
+static std::string GetMapFileName(pid_t pid) {
+    return "/tmp/perf-" + std::to_string(pid) + ".map";
+}
+
+PerfMapListener::PerfMapListener() : fileName(GetMapFileName(getpid())) {
+    std::error_code errorCode;
+    this->mapFile = std::make_unique<llvm::raw_fd_ostream>(this->fileName, errorCode, llvm::sys::fs::OF_None);
+    // 无法创建 perf map 文件时不影响程序执行，只是无法符号化
+    if (errorCode) {
+        llvm::errs() << "Cannot open perf map file " << this->fileName << ": " << errorCode.message() << "\n";
+        this->mapFile.reset();
+    }
+}
+
+/**
+ * @brief 为 JIT 之后从当前进程 fork 出的子进程创建 perf map 文件
+ *
+ * 子进程中运行的是继承来的 JIT 代码，但 perf 按样本所属进程的 pid 查找 map 文件，
+ * 因此为子进程创建指向当前文件的硬链接，当前进程之后再 JIT 的函数也会出现在子进程的文件中。
+ * @param pid 子进程的 pid
+ */
+void PerfMapListener::AddProcess(pid_t pid) const {
+    if (!this->mapFile)
+        return;
+    const std::string childFileName = GetMapFileName(pid);
+    // 同一 pid 的旧进程可能留下过 map 文件
+    unlink(childFileName.c_str());
+    if (link(this->fileName.c_str(), childFileName.c_str()) < 0)
+        llvm::errs() << "Cannot create perf map file " << childFileName << ": " << std::strerror(errno) << "\n";
+}
+
+/**
+ * @brief 目标文件被 JIT 加载后，把其中每个函数符号的加载地址和长度写入 perf map 文件
+ * @param key 目标文件的编号（未使用）
+ * @param obj 被加载的目标文件
+ * @param loadedInfo 目标文件各节加载到内存后的信息
+ */
+void PerfMapListener::notifyObjectLoaded(ObjectKey key, const llvm::object::ObjectFile &obj,
+                                         const llvm::RuntimeDyld::LoadedObjectInfo &loadedInfo) {
+    if (!this->mapFile)
+        return;
+
+    // getObjectForDebug() 返回的目标文件中，符号地址已被改写为实际加载地址
+    llvm::object::OwningBinary<llvm::object::ObjectFile> debugObj = loadedInfo.getObjectForDebug(obj);
+    const llvm::object::ObjectFile &debugObjFile = *debugObj.getBinary();
+
+    for (const auto &symbolSize : llvm::object::computeSymbolSizes(debugObjFile)) {
+        const llvm::object::SymbolRef &symbol = symbolSize.first;
+
+        // 只记录函数符号
+        llvm::Expected<llvm::object::SymbolRef::Type> symbolType = symbol.getType();
+        if (!symbolType) {
+            llvm::consumeError(symbolType.takeError());
+            continue;
+        }
+        if (*symbolType != llvm::object::SymbolRef::ST_Function)
+            continue;
+
+        llvm::Expected<llvm::StringRef> symbolName = symbol.getName();
+        llvm::Expected<uint64_t> symbolAddress = symbol.getAddress();
+        if (!symbolName || !symbolAddress) {
+            llvm::consumeError(symbolName.takeError());
+            llvm::consumeError(symbolAddress.takeError());
+            continue;
+        }
+
+        *this->mapFile << llvm::format_hex_no_prefix(*symbolAddress, 1) << " "
+                       << llvm::format_hex_no_prefix(symbolSize.second, 1) << " "
+                       << *symbolName << "\n";
+    }
+
+    // perf 可能在程序运行过程中读取 map 文件，因此每次加载后立即刷新
+    this->mapFile->flush();
+}
@@ -0,0 +1,40 @@
+//
+// Created by Pei Yuhang on 2023/6/2.
+//
+
+#ifndef CP_PROJECT_PERFMAP_H
+#define CP_PROJECT_PERFMAP_H
+
+#include <memory>
+#include <string>
+
+#include <sys/types.h>
+
+#include <llvm/ExecutionEngine/JITEventListener.h>
+#include <llvm/ExecutionEngine/RuntimeDyld.h>
+#include <llvm/Object/ObjectFile.h>
+#include <llvm/Support/raw_ostream.h>
+
+/**
+ * @brief 将 JIT 生成的函数写入 /tmp/perf-<pid>.map，使 perf report 能够显示用户函数名
+ *
+ * perf map 文件的每一行格式为 "<起始地址> <长度> <符号名>"，均为十六进制，
+ * perf 会在解析匿名可执行内存时自动读取该文件。JIT 之后 fork 出的子进程需要用 AddProcess() 创建各自的文件。
+ */
+class PerfMapListener : public llvm::JITEventListener {
+public:
+    PerfMapListener();
+
+    ~PerfMapListener() override = default;
+
+    void notifyObjectLoaded(ObjectKey key, const llvm::object::ObjectFile &obj,
+                            const llvm::RuntimeDyld::LoadedObjectInfo &loadedInfo) override;
+
+    void AddProcess(pid_t pid) const;
+
+private:
+    std::string fileName;                           // 当前进程的 perf map 文件名
+    std::unique_ptr<llvm::raw_fd_ostream> mapFile;  // perf map 文件的输出流
+};
+
+#endif //CP_PROJECT_PERFMAP_H
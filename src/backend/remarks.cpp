@@ -0,0 +1,107 @@
+//
+// Created by Pei Yuhang on 2023/6/12.
+//
+
+#include <stdexcept>
+
+#include <llvm/IR/DiagnosticInfo.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/LLVMRemarkStreamer.h>
+#include <llvm/Remarks/RemarkStreamer.h>
+#include <llvm/Support/Regex.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include "remarks.h"
+
+namespace {
+
+    /* 按 pass 名称过滤优化报告并写入标准错误 */
+    class RemarkHandler : public llvm::DiagnosticHandler {
+    public:
+        RemarkHandler(const RemarkOptions &options, std::string sourceFileName)
+                : passed(CreateFilter(options.passed, "-Rpass")), missed(CreateFilter(options.missed, "-Rpass-missed")),
+                  analysis(CreateFilter(options.analysis, "-Rpass-analysis")), sourceFileName(std::move(sourceFileName)) {}
+
+        bool isPassedOptRemarkEnabled(llvm::StringRef passName) const override { return Matches(this->passed, passName); }
+
+        bool isMissedOptRemarkEnabled(llvm::StringRef passName) const override { return Matches(this->missed, passName); }
+
+        bool isAnalysisRemarkEnabled(llvm::StringRef passName) const override { return Matches(this->analysis, passName); }
+
+        bool isAnyRemarkEnabled() const override { return this->passed || this->missed || this->analysis; }
+
+        bool handleDiagnostics(const llvm::DiagnosticInfo &diagnostic) override {
+            // 错误和警告仍由 LLVMContext 默认的方式输出
+            auto remark = llvm::dyn_cast<llvm::DiagnosticInfoOptimizationBase>(&diagnostic);
+            if (!remark)
+                return false;
+            // 记录文件需要全部报告，因此 pass 会生成未被选项选中的报告，这里将其丢弃
+            if (!remark->isEnabled())
+                return true;
+
+            const char *option = remark->isPassed() ? "-Rpass" : remark->isMissed() ? "-Rpass-missed" : "-Rpass-analysis";
+            llvm::raw_ostream &os = llvm::errs();
+            if (remark->isLocationAvailable())
+                os << remark->getLocationStr();
+            else
+                os << this->sourceFileName;
+            os << ": remark: in function " << remark->getFunction().getName() << ": " << remark->getMsg()
+               << " [" << option << "=" << remark->getPassName() << "]\n";
+            return true;
+        }
+
+    private:
+        static std::unique_ptr<llvm::Regex> CreateFilter(const std::string &pattern, const std::string &optionName) {
+            if (pattern.empty())
+                return nullptr;
+            auto filter = std::make_unique<llvm::Regex>(pattern);
+            std::string error;
+            if (!filter->isValid(error))
+                throw std::invalid_argument("Invalid regular expression for " + optionName + ": " + error);
+            return filter;
+        }
+
+        static bool Matches(const std::unique_ptr<llvm::Regex> &filter, llvm::StringRef passName) {
+            return filter && filter->match(passName);
+        }
+
+        std::unique_ptr<llvm::Regex> passed;
+        std::unique_ptr<llvm::Regex> missed;
+        std::unique_ptr<llvm::Regex> analysis;
+        std::string sourceFileName;     // 报告没有源代码位置时显示的文件名
+    };
+
+}
+
+/**
+ * @brief 在 context 上安装过滤优化报告的诊断信息处理器，并按需打开 YAML 记录文件
+ * @param context 生成代码所用的 LLVMContext，优化报告经由它的诊断信息处理器输出
+ * @param options 优化报告的选项
+ * @param sourceFileName 源文件名，用于没有源代码位置的报告
+ */
+RemarkCollector::RemarkCollector(llvm::LLVMContext &context, const RemarkOptions &options,
+                                 const std::string &sourceFileName)
+        : context(context) {
+    auto handler = std::make_unique<RemarkHandler>(options, sourceFileName == "-" ? "<stdin>" : sourceFileName);
+
+    if (!options.recordFile.empty()) {
+        auto recordFile = llvm::setupLLVMOptimizationRemarks(context, options.recordFile, "", "yaml", false);
+        if (!recordFile)
+            throw std::runtime_error("Cannot open " + options.recordFile + ": " + llvm::toString(recordFile.takeError()));
+        this->recordFile = std::move(*recordFile);
+        this->recordFile->keep();
+    }
+
+    this->outerHandler = context.getDiagnosticHandler();
+    context.setDiagnosticHandler(std::move(handler));
+}
+
+/**
+ * @brief 恢复原来的诊断信息处理器，关闭记录文件
+ */
+RemarkCollector::~RemarkCollector() {
+    this->context.setDiagnosticHandler(std::move(this->outerHandler));
+    // 先移除引用记录文件的 remark streamer，再关闭文件
+    this->context.setLLVMRemarkStreamer(nullptr);
+    this->context.setMainRemarkStreamer(nullptr);
+}
@@ -0,0 +1,44 @@
+//
+// Created by Pei Yuhang on 2023/6/12.
+//
+
+#ifndef CP_PROJECT_REMARKS_H
+#define CP_PROJECT_REMARKS_H
+
+#include <memory>
+#include <string>
+
+#include <llvm/IR/DiagnosticHandler.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/Support/ToolOutputFile.h>
+
+/* 优化报告的选项，正则表达式为空时不输出该种类的报告 */
+struct RemarkOptions {
+    std::string passed;     // -Rpass：名称匹配的 pass 成功进行的优化
+    std::string missed;     // -Rpass-missed：名称匹配的 pass 未能进行的优化
+    std::string analysis;   // -Rpass-analysis：名称匹配的 pass 做出决策的依据
+    std::string recordFile; // -foptimization-record-file：以 YAML 格式记录全部优化报告的文件
+
+    bool IsEnabled() const { return !passed.empty() || !missed.empty() || !analysis.empty() || !recordFile.empty(); }
+};
+
+/**
+ * @brief 收集 LLVM 的优化报告（remark），存在期间接管 LLVMContext 的诊断信息处理
+ *
+ * 匹配 -Rpass 等选项的报告以 "<文件>:<行>:<列>: remark: in function <函数>: <内容> [-Rpass=<pass>]" 的格式写入标准错误，
+ * 没有源代码位置时省略行列号；指定了记录文件时，全部报告以 YAML 格式写入该文件，可用 opt-viewer 等工具查看。
+ * 报告中的行列号来自调试信息，未开启 -g 时编译器只生成不写入目标文件的位置信息。
+ */
+class RemarkCollector {
+public:
+    RemarkCollector(llvm::LLVMContext &context, const RemarkOptions &options, const std::string &sourceFileName);
+
+    ~RemarkCollector();
+
+private:
+    llvm::LLVMContext &context;
+    std::unique_ptr<llvm::DiagnosticHandler> outerHandler;  // 创建前 LLVMContext 的诊断信息处理器，析构时恢复
+    std::unique_ptr<llvm::ToolOutputFile> recordFile;       // YAML 记录文件
+};
+
+#endif //CP_PROJECT_REMARKS_H
@@ -2,9 +2,23 @@
 // Created by Pei Yuhang on 2023/5/8.
 //
 
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
 #include <iostream>
 #include <fstream>
+#include <functional>
+#include <memory>
+#include <set>
 #include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 #include <llvm/IR/Value.h>
 #include <llvm/IR/BasicBlock.h>
@@ -36,40 +50,602 @@
 #include <llvm/Transforms/InstCombine/InstCombine.h>
 #include <llvm/Transforms/Scalar.h>
 #include <llvm/Transforms/Scalar/GVN.h>
+#include <llvm/Support/CommandLine.h>
 #include <llvm/Support/FileSystem.h>
 #include <llvm/Support/Host.h>
+#include <llvm/Support/MD5.h>
+#include <llvm/Support/StringSaver.h>
 #include <llvm/Support/TargetSelect.h>
 #include <llvm/Target/TargetMachine.h>
 #include <llvm/Target/TargetOptions.h>
 
 #include "frontend/AST.h"
 #include "frontend/codegen.h"
+#include "frontend/fingerprint.h"
 #include "frontend/parser.hpp"
+#include "frontend/timer.h"
+#include "frontend/trace.h"
+#include "backend/executor.h"
+#include "backend/objcache.h"
+#include "backend/perfmap.h"
+#include "backend/remarks.h"
+#include "server.h"
 
 extern AST::Prog *Root;
+extern std::function<void(AST::Unit *)> UnitHandler;
 extern int yyparse();
 extern void CreateIOFunc(CodeGenContext *context);
 
-int main(int argc, char **argv) {
-    if (argc > 1)
-        freopen(argv[1], "r", stdin);
+/* 命令行选项 */
+
+static llvm::cl::opt<std::string> InputFile(llvm::cl::Positional, llvm::cl::desc("<input file>"), llvm::cl::init("-"));
+
+static llvm::cl::list<std::string> ProgramArgs(llvm::cl::ConsumeAfter, llvm::cl::desc("<program arguments>..."));
+
+static llvm::cl::opt<bool> PerfSupport("perf", llvm::cl::desc("Register perf map and jitdump listeners for JIT-compiled code"));
+
+static llvm::cl::opt<bool> GenerateDebugInfo("g", llvm::cl::desc("Generate DWARF debug information"));
+
+static llvm::cl::opt<bool> Stream("stream", llvm::cl::desc("Generate code for each function and global definition as soon as it is parsed, "
+                                                             "then release its AST"));
+
+static llvm::cl::opt<std::string> RemarksPassed("Rpass", llvm::cl::desc("Report optimizations done by passes whose name matches <regex>"),
+                                                 llvm::cl::value_desc("regex"));
+
+static llvm::cl::opt<std::string> RemarksMissed("Rpass-missed", llvm::cl::desc("Report optimizations missed by passes whose name matches <regex>"),
+                                                llvm::cl::value_desc("regex"));
+
+static llvm::cl::opt<std::string> RemarksAnalysis("Rpass-analysis", llvm::cl::desc("Report the analysis behind decisions of passes whose name matches <regex>"),
+                                                  llvm::cl::value_desc("regex"));
+
+static llvm::cl::opt<std::string> RemarksFile("foptimization-record-file", llvm::cl::desc("Write all optimization remarks to <file> as YAML"),
+                                              llvm::cl::value_desc("file"));
+
+static llvm::cl::opt<bool> BoundsCheck("fbounds-check", llvm::cl::desc("Check array subscripts against the array size and abort on failure"));
+
+static llvm::cl::opt<unsigned> OptLevel("O", llvm::cl::desc("Optimization level (0-3)"), llvm::cl::Prefix, llvm::cl::init(0));
+
+static llvm::cl::opt<bool> Execute("exec", llvm::cl::desc("Execute the program with the JIT after compilation"), llvm::cl::init(true));
+
+static llvm::cl::opt<std::string> ExeFile("exe", llvm::cl::desc("Link the program into a native executable with the system C compiler"),
+                                          llvm::cl::value_desc("filename"));
+
+/* 输出文件的类型 */
+enum class EmitKind {
+    None,   // 不输出任何文件
+    LL,     // 文本格式的 LLVM IR
+    BC,     // LLVM bitcode
+    Asm,    // 汇编代码
+    Obj     // 目标文件
+};
+
+static llvm::cl::list<EmitKind> Emit("emit", llvm::cl::desc("Kinds of output files to write (default: none)"),
+                                     llvm::cl::CommaSeparated,
+                                     llvm::cl::values(clEnumValN(EmitKind::None, "none", "Write no output file"),
+                                                      clEnumValN(EmitKind::LL, "ll", "Textual LLVM IR (.ll)"),
+                                                      clEnumValN(EmitKind::BC, "bc", "LLVM bitcode (.bc)"),
+                                                      clEnumValN(EmitKind::Asm, "asm", "Native assembly (.s)"),
+                                                      clEnumValN(EmitKind::Obj, "obj", "Native object file (.o)")));
+
+static llvm::cl::opt<std::string> OutputFile("o", llvm::cl::desc("Output file, only allowed when a single kind is emitted"),
+                                             llvm::cl::value_desc("filename"));
+
+static llvm::cl::opt<std::string> IncrementalCache("incremental", llvm::cl::desc("Compile each function separately and reuse object code cached in <dir>"),
+                                                   llvm::cl::value_desc("dir"));
+
+static llvm::cl::opt<std::string> ServerSocket("server", llvm::cl::desc("Serve compile-and-run requests on a Unix domain socket"),
+                                               llvm::cl::value_desc("socket path"));
+
+static llvm::cl::opt<double> ServerTimeout("server-timeout", llvm::cl::desc("Wall time limit of each -server request in seconds, from connection to response (0 for no limit)"),
+                                           llvm::cl::init(30));
+
+static llvm::cl::opt<unsigned> Runs("runs", llvm::cl::desc("Run the program <n> times in a pool of pre-forked workers and report each run as JSON"),
+                                    llvm::cl::value_desc("n"), llvm::cl::init(0));
+
+static llvm::cl::opt<std::string> Batch("batch", llvm::cl::desc("Run the program once for each line of <file> in a pool of pre-forked workers and report each run as JSON; "
+                                                                "a line holds the program arguments and an optional <input file for stdin"),
+                                       llvm::cl::value_desc("file"));
+
+static llvm::cl::opt<unsigned> Jobs("jobs", llvm::cl::desc("Number of workers for -runs and -batch, or of requests handled at the same time by -server (default: number of cores)"),
+                                    llvm::cl::init(0));
+
+static llvm::cl::opt<unsigned> ParallelThreads("parallel-threads", llvm::cl::desc("Number of threads running parallel for loops (default: $CP_NUM_THREADS or number of cores)"),
+                                               llvm::cl::init(0));
+
+static llvm::cl::opt<double> RunCpuLimit("run-cpu-limit", llvm::cl::desc("CPU time limit of each run, or of each -server request, in seconds (0 for no limit)"),
+                                         llvm::cl::init(0));
+
+static llvm::cl::opt<unsigned> RunMemLimit("run-mem-limit", llvm::cl::desc("Extra address space allowed for each run, or for each -server request, in MB (0 for no limit)"),
+                                           llvm::cl::init(0));
+
+static llvm::cl::opt<unsigned> RunOutputLimit("run-output-limit", llvm::cl::desc("Output size limit of each run, or of each -server request, in KB (0 for no limit)"),
+                                              llvm::cl::init(0));
+
+static llvm::cl::opt<std::string> RunOutputDir("run-output-dir", llvm::cl::desc("Write the output of each run to <dir>/<run>.out"),
+                                               llvm::cl::value_desc("dir"));
+
+static llvm::cl::opt<std::string> ExecReport("exec-report",
+                                             llvm::cl::desc("Write the exit code, JIT and run time, peak RSS and the number of JIT-compiled functions as JSON to <file> (\"-\" for stderr)"),
+                                             llvm::cl::value_desc("filename"));
+
+static llvm::cl::opt<std::string> RunReport("run-report", llvm::cl::desc("Write the -runs or -batch report to <file> instead of stdout"),
+                                            llvm::cl::value_desc("filename"));
+
+static llvm::cl::opt<TraceLevel> Trace("trace", llvm::cl::desc("Compile tracing level, written to stderr"),
+                                      llvm::cl::init(TraceLevel::None),
+                                      llvm::cl::values(clEnumValN(TraceLevel::None, "none", "No tracing (default)"),
+                                                       clEnumValN(TraceLevel::Phase, "phase", "Trace compile phases"),
+                                                       clEnumValN(TraceLevel::Node, "node", "Also trace code generation of each AST node"),
+                                                       clEnumValN(TraceLevel::IR, "ir", "Also print the generated LLVM IR")));
+
+static llvm::cl::opt<bool> TimeReport("ftime-report", llvm::cl::desc("Print the time spent in each compile phase and optimization pass"));
+
+static llvm::cl::opt<std::string> TimeTraceFile("ftime-trace", llvm::cl::desc("Write a Chrome trace-event JSON file of the compile pipeline"),
+                                                llvm::cl::value_desc("filename"));
+
+static llvm::cl::opt<std::string> StatsFile("bench-json", llvm::cl::desc("Write compile, JIT and run time and per-phase statistics as JSON"),
+                                            llvm::cl::value_desc("filename"));
+
+/* 编译阶段统计 */
+
+struct PhaseStat {
+    std::string name;   // 阶段名称
+    double seconds;     // 阶段耗时（秒）
+    long peakRSS;       // 阶段结束时进程的峰值常驻内存（KB）
+};
+
+static std::vector<PhaseStat> PhaseStats;
+
+/**
+ * @brief 记录一个编译阶段的耗时和阶段结束时的峰值内存
+ * @param name 阶段名称
+ * @param start 阶段开始的时间点，函数返回后被更新为当前时间，作为下一阶段的开始
+ */
+static void RecordPhase(const std::string &name, std::chrono::steady_clock::time_point &start) {
+    auto now = std::chrono::steady_clock::now();
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    PhaseStats.push_back({ name, std::chrono::duration<double>(now - start).count(), usage.ru_maxrss });
+    start = now;
+}
+
+/**
+ * @brief 确定某一类输出文件的路径
+ * @param kind 输出文件的类型
+ * @return 若指定了 -o 则为 -o 的值，否则为输入文件去掉扩展名后加上对应的扩展名，从标准输入读取时以 "a" 为文件名
+ */
+static std::string GetOutputFile(EmitKind kind) {
+    if (!OutputFile.empty())
+        return OutputFile;
+
+    std::string stem = InputFile == "-" ? "a" : InputFile.getValue();
+    size_t dot = stem.find_last_of('.');
+    if (dot != std::string::npos && stem.find('/', dot) == std::string::npos)
+        stem.erase(dot);
+
+    switch (kind) {
+        case EmitKind::LL: return stem + ".ll";
+        case EmitKind::BC: return stem + ".bc";
+        case EmitKind::Asm: return stem + ".s";
+        case EmitKind::Obj: return stem + ".o";
+        default: throw std::logic_error("No output file for this emit kind");
+    }
+}
+
+/**
+ * @brief 判断是否需要输出某一类文件
+ */
+static bool ShouldEmit(EmitKind kind) {
+    return std::find(Emit.begin(), Emit.end(), kind) != Emit.end();
+}
+
+/**
+ * @brief 获取编译器的构建标识，为编译器可执行文件内容的 MD5 摘要，任何一个源文件重新编译并链接后都会改变
+ *
+ * 无法读取可执行文件时以进程号和当前时间代替，此时缓存中的目标文件都不会被复用。
+ */
+static std::string GetCompilerBuildID() {
+    static const std::string buildID = []() -> std::string {
+        auto executable = llvm::MemoryBuffer::getFile("/proc/self/exe", false, false);
+        if (!executable)
+            return "unknown " + std::to_string(getpid()) + " "
+                   + std::to_string(std::chrono::system_clock::now().time_since_epoch().count());
+        llvm::MD5 hash;
+        hash.update((*executable)->getBuffer());
+        llvm::MD5::MD5Result result;
+        hash.final(result);
+        return result.digest().str().str();
+    }();
+    return buildID;
+}
+
+/**
+ * @brief 获取增量编译的 salt，编译器的构建、LLVM 的版本和影响生成代码的编译选项不同时，编译单元的指纹也不同
+ *
+ * 新增影响生成代码的编译选项时，需要将其加入 salt，否则会错误地复用按其他选项生成的目标文件。
+ */
+static std::string GetIncrementalSalt() {
+    return "CP_Project " + GetCompilerBuildID() + " LLVM " LLVM_VERSION_STRING " -O" + std::to_string(OptLevel)
+           + (GenerateDebugInfo ? " -g " : " ") + (BoundsCheck ? "-fbounds-check " : "") + llvm::sys::getDefaultTargetTriple();
+}
+
+/**
+ * @brief 调用系统的 C 编译器把目标文件链接为可执行文件，参数直接传给 cc，不经过 shell
+ * @return 是否链接成功
+ */
+static bool LinkExecutable(const std::vector<std::string> &objectFiles, const std::string &exeFile) {
+    std::vector<std::string> args = { "cc" };
+    args.insert(args.end(), objectFiles.begin(), objectFiles.end());
+#ifdef CP_RUNTIME_LIBRARY
+    args.insert(args.end(), { CP_RUNTIME_LIBRARY, "-lstdc++", "-lpthread" });
+#endif
+    args.insert(args.end(), { "-o", exeFile });
+
+    std::vector<char *> argv;
+    for (const std::string &arg : args)
+        argv.push_back(const_cast<char *>(arg.c_str()));
+    argv.push_back(nullptr);
+
+    std::fflush(nullptr);
+    pid_t pid = fork();
+    if (pid < 0)
+        return false;
+    if (pid == 0) {
+        execvp(argv[0], argv.data());
+        std::perror("cc");
+        _exit(127);
+    }
+
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0)
+        if (errno != EINTR)
+            return false;
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+/**
+ * @brief 检查服务模式的请求中的选项：请求只能使用影响代码生成和运行的选项，源代码总是来自请求本身，
+ *        不能指定输入文件，也不能读写服务进程所在机器上的其他文件
+ */
+static void CheckRequestOptions() {
+    static const std::set<const llvm::cl::Option *> allowedOptions = {
+            &GenerateDebugInfo, &Stream, &RemarksPassed, &RemarksMissed, &RemarksAnalysis, &BoundsCheck, &OptLevel,
+            &Execute, &Runs, &Jobs, &ParallelThreads, &RunCpuLimit, &RunMemLimit, &RunOutputLimit, &Trace, &TimeReport
+    };
+    for (const auto &entry : llvm::cl::getRegisteredOptions()) {
+        const llvm::cl::Option *option = entry.second;
+        // -exec-report 只能写入标准错误
+        if (option->getNumOccurrences() == 0 || allowedOptions.count(option) || (option == &ExecReport && ExecReport == "-"))
+            continue;
+        throw std::runtime_error("Option -" + entry.first().str() + " cannot be used in a server request");
+    }
+    if (InputFile != "-")
+        throw std::runtime_error("A server request cannot name an input file, the source code follows the options");
+}
+
+/**
+ * @brief 按 -run-cpu-limit、-run-mem-limit 和 -run-output-limit 获取每次运行的资源限制
+ */
+static RunLimits GetRunLimits() {
+    RunLimits limits;
+    limits.cpuSeconds = RunCpuLimit;
+    limits.memoryBytes = static_cast<size_t>(RunMemLimit) << 20;
+    limits.outputBytes = static_cast<size_t>(RunOutputLimit) << 10;
+    return limits;
+}
+
+/**
+ * @brief 获取 -runs、-batch 的 worker 数量或服务模式同时处理的请求数
+ */
+static unsigned GetJobCount() {
+    return Jobs ? Jobs : std::max(1u, std::thread::hardware_concurrency());
+}
+
+/**
+ * @brief 读取 -batch 的输入列表，每个非空行对应一次运行，以 # 开头的行为注释
+ *
+ * 一行按 shell 的规则拆分为参数（支持引号和反斜杠转义），形如 "<文件" 的参数或 "<" 之后的参数为该次运行的标准输入，
+ * 其余参数依次作为 argv[1] 之后的各项，argv[0] 为输入文件名。
+ * @param fileName 输入列表的路径
+ * @return 各次运行的输入，按行的顺序排列
+ */
+static std::vector<RunInput> ReadBatchFile(const std::string &fileName) {
+    std::ifstream batchFile(fileName);
+    if (!batchFile)
+        throw std::runtime_error("Cannot open batch file " + fileName);
+
+    std::vector<RunInput> inputs;
+    llvm::BumpPtrAllocator allocator;
+    llvm::StringSaver saver(allocator);
+    for (std::string line; std::getline(batchFile, line);) {
+        llvm::SmallVector<const char *, 8> tokens;
+        llvm::cl::TokenizeGNUCommandLine(line, saver, tokens);
+        if (tokens.empty() || tokens[0][0] == '#')
+            continue;
+
+        RunInput input;
+        input.args.emplace_back(InputFile);
+        for (size_t i = 0; i < tokens.size(); ++i) {
+            const llvm::StringRef token = tokens[i];
+            if (!token.startswith("<"))
+                input.args.emplace_back(token);
+            else if (token.size() > 1)
+                input.inputFile = token.drop_front().str();
+            else if (i + 1 < tokens.size())
+                input.inputFile = tokens[++i];
+            else
+                throw std::runtime_error("Missing input file after '<' in batch file " + fileName);
+        }
+        inputs.push_back(std::move(input));
+    }
+    return inputs;
+}
+
+/**
+ * @brief 按照命令行选项编译一个程序，并根据选项输出文件、链接或执行
+ * @param context 已创建内置函数的代码生成上下文
+ * @param programName 编译器的程序名，显示在 Chrome trace 中
+ * @param runStats 用于返回编译、JIT 和运行的耗时
+ * @return 进程的退出码
+ */
+static int Compile(CodeGenContext &context, const char *programName, RunStats &runStats) {
+    if (OptLevel > 3) {
+        std::cerr << "Invalid optimization level -O" << OptLevel << std::endl;
+        return 1;
+    }
+
+    // -o 只能对应一个输出文件，"none" 不能与其他类型同时出现
+    size_t emitCount = 0;
+    for (EmitKind kind : { EmitKind::LL, EmitKind::BC, EmitKind::Asm, EmitKind::Obj })
+        emitCount += ShouldEmit(kind);
+    if (ShouldEmit(EmitKind::None) && emitCount > 0) {
+        std::cerr << "-emit=none cannot be combined with other output kinds" << std::endl;
+        return 1;
+    }
+    if (!IncrementalCache.empty() && emitCount > 0) {
+        std::cerr << "-incremental cannot be combined with -emit" << std::endl;
+        return 1;
+    }
+    if (!OutputFile.empty() && emitCount != 1) {
+        std::cerr << "-o requires exactly one output kind in -emit" << std::endl;
+        return 1;
+    }
+    if (Stream && !IncrementalCache.empty()) {
+        std::cerr << "-stream cannot be combined with -incremental" << std::endl;
+        return 1;
+    }
+    if (Runs > 0 && !Batch.empty()) {
+        std::cerr << "-runs cannot be combined with -batch" << std::endl;
+        return 1;
+    }
+
+    // 输入文件为 "-" 时从标准输入读取源代码
+    if (InputFile != "-" && !freopen(InputFile.c_str(), "r", stdin)) {
+        std::cerr << "Cannot open input file " << InputFile << std::endl;
+        return 1;
+    }
+
+    CurrentTraceLevel = Trace;
+
+    // 后端的 legacy PassManager 通过全局变量 TimePassesIsEnabled 开启各 pass 的计时
+    TimeReportEnabled = llvm::TimePassesIsEnabled = TimeReport;
+    if (!TimeTraceFile.empty())
+        StartTimeTrace(programName);
+
+    auto compileStart = std::chrono::steady_clock::now();
+    auto phaseStart = compileStart;
+
+    context.SetPerfSupport(PerfSupport);
+    context.SetOptLevel(OptLevel);
+    context.SetDebugInfoEnabled(GenerateDebugInfo);
+    context.SetBoundsCheckEnabled(BoundsCheck);
+    RemarkOptions remarkOptions{ RemarksPassed, RemarksMissed, RemarksAnalysis, RemarksFile };
+    context.SetRemarkOptions(&remarkOptions);
+
+    // 流式编译时，语法分析与代码生成交替进行，每个顶层单元在归约后立即生成代码并释放
+    if (Stream) {
+        TRACE(TraceLevel::Phase, "\033[31mParsing and generating code...\033[0m");
+        {
+            PhaseTimer timer("codegen", InputFile);
+            context.BeginCodeGen();
+            UnitHandler = [&context](AST::Unit *unit) { context.GenerateUnit(unit); };
+            yyparse();
+            UnitHandler = nullptr;
+            context.EndCodeGen();
+        }
+        RecordPhase("codegen", phaseStart);
+    } else {
+        TRACE(TraceLevel::Phase, "\033[31mParsing code...\033[0m");
+        {
+            PhaseTimer timer("parse", InputFile);
+            yyparse();
+        }
+        TRACE(TraceLevel::Phase, "\033[32mParsing finishes\033[0m");
+        RecordPhase("parse", phaseStart);
+    }
+
+    // 增量编译时，在代码生成之前计算指纹，命中缓存的函数不再生成函数体
+    std::unique_ptr<ObjectCache> objectCache;
+    Fingerprints fingerprints;
+#if LLVM_VERSION_MAJOR >= 14
+    if (!IncrementalCache.empty()) {
+        objectCache = std::make_unique<ObjectCache>(IncrementalCache);
+        // 调试信息和越界检查的诊断信息都包含行号，函数的位置改变时须重新编译
+        fingerprints = ComputeFingerprints(Root, GetIncrementalSalt(), GenerateDebugInfo || BoundsCheck);
+        context.SetIncremental(&fingerprints, objectCache.get());
+    }
+#endif
+
+    if (!Stream) {
+        context.GenerateCode(Root);
+        RecordPhase("codegen", phaseStart);
+    }
+#if LLVM_VERSION_MAJOR >= 14
+    if (objectCache)
+        context.CompileIncremental();
+    else
+#endif
+        context.Optimize();
+    RecordPhase("optimize", phaseStart);
+
+    // 只写出 -emit 要求的文件；后端代码生成会修改 module，因此 LLVM IR 和 bitcode 须在此之前输出
+    if (ShouldEmit(EmitKind::LL))
+        context.DumpLLVMIR(GetOutputFile(EmitKind::LL));
+    if (ShouldEmit(EmitKind::BC))
+        context.DumpBitcode(GetOutputFile(EmitKind::BC));
+#if LLVM_VERSION_MAJOR >= 14
+    if (ShouldEmit(EmitKind::Asm))
+        context.GenerateAssembly(GetOutputFile(EmitKind::Asm));
+    if (ShouldEmit(EmitKind::Obj))
+        context.GenerateObject(GetOutputFile(EmitKind::Obj));
 
-    std::cout << "\033[31mParsing code...\033[0m" << std::endl;
-    yyparse();
-    std::cout << "\033[32mParsing finishes\033[0m\n" << std::endl;
+    // 生成目标文件后，调用系统的 C 编译器完成链接，printf 等函数来自 C 标准库，cp_parallel_for、cp_bounds_check_failed 等函数来自运行时库
+    // 增量编译时直接链接缓存中各编译单元的目标文件
+    if (!ExeFile.empty()) {
+        std::vector<std::string> objectFiles = context.GetObjectFiles();
+        if (objectFiles.empty()) {
+            objectFiles.push_back(ExeFile + ".o");
+            context.GenerateObject(objectFiles.back());
+        }
+        if (!LinkExecutable(objectFiles, ExeFile)) {
+            std::cerr << "Failed to link " << ExeFile << std::endl;
+            return 1;
+        }
+    }
+#endif
+    // 优化报告来自优化和目标代码的生成，执行程序之前写完记录文件
+    context.FinishRemarks();
+    RecordPhase("emit", phaseStart);
+
+    double compileTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - compileStart).count();
+
+    // 运行时库在第一次执行 parallel for 时按 CP_NUM_THREADS 创建线程池
+    if (ParallelThreads > 0)
+        setenv("CP_NUM_THREADS", std::to_string(ParallelThreads).c_str(), 1);
+
+    // 直接执行时进程的退出码为 main 函数的返回值
+    int exitCode = 0;
+
+    // argv[0] 为输入文件名，其后为输入文件之后的命令行参数
+    std::vector<std::string> programArgs = { InputFile };
+    programArgs.insert(programArgs.end(), ProgramArgs.begin(), ProgramArgs.end());
+
+    // 多次运行时，编译结果只 JIT 一次，由执行进程池中的 worker 反复调用；
+    // -runs 的每次运行使用相同的参数，-batch 的每次运行使用输入列表中的一行
+    if (Runs > 0 || !Batch.empty()) {
+        std::vector<RunInput> inputs = Batch.empty() ? std::vector<RunInput>(Runs, RunInput{ programArgs, "" })
+                                                     : ReadBatchFile(Batch);
+
+        RunLimits limits = GetRunLimits();
+        limits.outputDir = RunOutputDir;
+        if (!limits.outputDir.empty())
+            llvm::sys::fs::create_directories(limits.outputDir);
+
+        // 每个 worker 各自创建 parallel for 的线程池，同时运行的 worker 按其个数平分 CPU 核，
+        // 避免线程总数成为核数的平方；-parallel-threads 或 CP_NUM_THREADS 已指定线程数时不变
+        const unsigned jobCount = GetJobCount();
+        const auto activeWorkers = static_cast<unsigned>(std::min<size_t>(jobCount, inputs.size()));
+        if (activeWorkers > 1 && ParallelThreads == 0 && !std::getenv("CP_NUM_THREADS")) {
+            unsigned threadCount = std::max(1u, std::thread::hardware_concurrency() / activeWorkers);
+            setenv("CP_NUM_THREADS", std::to_string(threadCount).c_str(), 1);
+        }
+
+        MainFunction mainFunc = context.GetMainFunction();
+        auto runStart = std::chrono::steady_clock::now();
+        // worker 在 JIT 之后 fork，perf 按 worker 的 pid 查找 map 文件，需要为每个 worker 创建一份
+        std::function<void(pid_t)> onSpawn;
+        if (PerfMapListener *perfMap = context.GetPerfMapListener())
+            onSpawn = [perfMap](pid_t pid) { perfMap->AddProcess(pid); };
+        ExecutorPool pool(mainFunc, context.GetWritableGlobals(), std::move(inputs), jobCount, limits, onSpawn);
+        std::vector<RunResult> results = pool.Run();
+        double runTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - runStart).count();
+
+        std::ofstream reportFile;
+        if (!RunReport.empty())
+            reportFile.open(RunReport);
+        WriteRunReport(RunReport.empty() ? std::cout : reportFile, results, runTime);
+    } else if (Execute) {
+        exitCode = context.ExecuteCode(programArgs);
+
+        // 执行报告：JIT 和运行的耗时分开统计，峰值内存为整个进程（含编译）的峰值常驻内存
+        if (!ExecReport.empty()) {
+            rusage usage{};
+            getrusage(RUSAGE_SELF, &usage);
+            std::ofstream reportFile;
+            if (ExecReport != "-")
+                reportFile.open(ExecReport);
+            std::ostream &report = ExecReport == "-" ? std::cerr : reportFile;
+            report << "{\"exit_code\": " << exitCode
+                   << ", \"jit_seconds\": " << context.GetJITTime()
+                   << ", \"run_seconds\": " << context.GetRunTime()
+                   << ", \"peak_rss_kb\": " << usage.ru_maxrss
+                   << ", \"functions_materialized\": " << context.GetMaterializedFunctionCount() << "}" << std::endl;
+        }
+    }
+
+    runStats.compileSeconds = compileTime;
+    runStats.jitSeconds = context.GetJITTime();
+    runStats.runSeconds = context.GetRunTime();
+
+    FinishTimeTrace(TimeTraceFile);
+    PrintTimeReport();
+
+    // 以 JSON 格式输出各阶段耗时，供基准测试程序读取
+    if (!StatsFile.empty()) {
+        std::ofstream stats(StatsFile);
+        stats << "{\"compile_seconds\": " << compileTime
+              << ", \"jit_seconds\": " << context.GetJITTime()
+              << ", \"run_seconds\": " << context.GetRunTime()
+              << ", \"phases\": {";
+        for (size_t i = 0; i < PhaseStats.size(); ++i)
+            stats << (i ? ", " : "") << "\"" << PhaseStats[i].name << "\": {\"seconds\": " << PhaseStats[i].seconds
+                  << ", \"peak_rss_kb\": " << PhaseStats[i].peakRSS << "}";
+        stats << "}}" << std::endl;
+    }
+
+    return exitCode;
+}
+
+int main(int argc, char **argv) {
+    llvm::cl::ParseCommandLineOptions(argc, argv, "CP_Project compiler\n");
 
     llvm::InitializeNativeTarget();
     llvm::InitializeNativeTargetAsmPrinter();
     llvm::InitializeNativeTargetAsmParser();
 
-    CodeGenContext context(argv[1]);
-    CreateIOFunc(&context);
-    context.GenerateCode(Root);
-    context.DumpLLVMIR("./test/llvm.ll");
-#if LLVM_VERSION_MAJOR >= 16
-    context.GenerateObject("./test/object.o");
-#endif
-    context.ExecuteCode();
+    // 服务模式：预先完成目标机器、内置函数和 JIT 的初始化，每个请求在 fork 出的子进程中使用它们的副本
+    if (!ServerSocket.empty()) {
+        CodeGenContext context("-");
+        CreateIOFunc(&context);
+        context.PrepareJIT();
+
+        // 资源限制和并发数取自启动服务时的选项，在解析请求中的选项之前确定
+        ServerOptions serverOptions;
+        serverOptions.maxRequests = GetJobCount();
+        serverOptions.timeoutSeconds = ServerTimeout;
+        serverOptions.limits = GetRunLimits();
+
+        return RunServer(ServerSocket, serverOptions, [&context, argv](const std::vector<std::string> &args, RunStats &runStats) {
+            // 子进程中的选项恢复为默认值后，按请求中的选项重新解析；以 @ 开头的参数会被当作响应文件读取，不允许出现
+            std::vector<const char *> requestArgv = { argv[0] };
+            for (const auto &arg : args) {
+                if (arg[0] == '@')
+                    throw std::runtime_error("Response files cannot be used in a server request");
+                requestArgv.push_back(arg.c_str());
+            }
+            llvm::cl::ResetAllOptionOccurrences();
+            llvm::cl::ParseCommandLineOptions(static_cast<int>(requestArgv.size()), requestArgv.data(),
+                                              "CP_Project compiler\n");
+            CheckRequestOptions();
 
-    return 0;
-}
\ No newline at end of file
+            context.module->setModuleIdentifier(InputFile);
+            context.module->setSourceFileName(InputFile);
+            return Compile(context, argv[0], runStats);
+        });
+    }
+
+    CodeGenContext context(InputFile);
+    CreateIOFunc(&context);
+    RunStats runStats;
+    return Compile(context, argv[0], runStats);
+}
@@ -2,13 +2,34 @@
 // Created by Pei Yuhang on 2023/5/15.
 //
 
+#include <chrono>
 #include <iostream>
 
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/IR/PassTimingInfo.h>
+#include <llvm/Object/ObjectFile.h>
+#include <llvm/Transforms/Utils/Cloning.h>
+
 #include "AST.h"
+#include "boundscheck.hpp"
 #include "codegen.h"
+#include "consteval.hpp"
+#include "debuginfo.hpp"
+#include "fingerprint.h"
+#include "memory.hpp"
 #include "parser.hpp"
+#include "timer.h"
+#include "trace.h"
 #include "type.hpp"
 #include "util.hpp"
+#include "vector.hpp"
+#include "../backend/executor.h"
+#include "../backend/jitstats.h"
+#include "../backend/objcache.h"
+#include "../backend/perfmap.h"
+#include "../backend/remarks.h"
+#include "../runtime/bounds.h"
+#include "../runtime/parallel.h"
 
 
 /**
@@ -16,49 +37,194 @@
  * @param root 抽象语法树的根节点的指针
  */
 void CodeGenContext::GenerateCode(AST::Prog *root) {
-    std::cout << "\033[31mGenerating code for the program...\033[0m\n" << std::endl;
-
-    // 为了处理全局变量和类型的定义，创建一个临时的 _AST_GLOBAL 函数
-    std::vector<llvm::Type *> paramTypes;   // 为 _AST_GLOBAL 定义空的形参列表
-    // 创建返回类型为空、形参列表为空、参数数量不可变的函数类型
-    llvm::FunctionType *funcType =
-            llvm::FunctionType::get(llvm::Type::getVoidTy(Context), llvm::ArrayRef(paramTypes), false);
-    // 创建 _AST_GLOBAL 函数
-    llvm::Function *globalFunc =
-            llvm::Function::Create(funcType, llvm::GlobalValue::InternalLinkage, "_AST_GLOBAL", this->module);
-    // 创建临时基本块
-    llvm::BasicBlock *basicBlock =
-            llvm::BasicBlock::Create(Context, "_AST_GLOBAL_entry", globalFunc, nullptr);
-
-    // 基本块入栈
-    PushBasicBlock(basicBlock);
+    PhaseTimer timer("codegen");
+
+    BeginCodeGen();
     // 调用根节点的 CodeGen()，递归地调用抽象语法书各个节点的 CodeGen() 操作
     root->CodeGen(this);
-    // 删除临时的基本块
-    basicBlock->eraseFromParent();
-    // 删除临时的全局函数
-    globalFunc->eraseFromParent();
-    // 基本块出栈
+    EndCodeGen();
+}
+
+/**
+ * @brief 开始生成代码：创建优化报告的收集器和调试信息的生成器，并进入全局作用域
+ */
+void CodeGenContext::BeginCodeGen() {
+    TRACE(TraceLevel::Phase, "\033[31mGenerating code for the program...\033[0m");
+
+    // 结构体的布局、内存内置函数的字节数和对齐都取决于目标机器的数据布局，在生成代码之前设置
+    GetTargetMachine();
+
+    // 输出优化报告时，在优化之前开始收集
+    if (this->remarkOptions && this->remarkOptions->IsEnabled() && !this->remarks)
+        this->remarks = new RemarkCollector(Context, *this->remarkOptions, this->module->getSourceFileName());
+
+    // 开启 -g 时，代码生成的同时生成调试信息；只输出优化报告时，调试信息只用于给报告提供行列号
+    if (this->debugInfoEnabled || this->remarks)
+        this->debugInfo = new DebugInfo(this->module, this->optLevel > 0, !this->debugInfoEnabled);
+
+    // 全局作用域的变量表，全局变量不属于任何函数，因此对应的基本块为空
+    PushBasicBlock(nullptr);
+}
+
+/**
+ * @brief 流式编译时，语法分析器每归约出一个顶层单元就调用本函数为其生成代码，随后释放该单元
+ *
+ * 全局变量定义整体释放；函数只释放函数体，保留签名供之后的调用使用。
+ * 因此 AST 占用的内存只取决于最大的函数，而不是整个程序，但编译期求值不能调用已被释放的函数。
+ * @param unit 刚完成语法分析的函数定义、函数原型或全局变量定义
+ */
+void CodeGenContext::GenerateUnit(AST::Unit *unit) {
+    unit->CodeGen(this);
+    if (auto funcDef = dynamic_cast<AST::FuncDef *>(unit))
+        funcDef->ReleaseBody();
+    else
+        delete unit;
+}
+
+/**
+ * @brief 结束代码生成：离开全局作用域，完成调试信息，并进行依赖于整个 module 的处理
+ */
+void CodeGenContext::EndCodeGen() {
     PopBasicBlock();
 
-    std::cout << "\033[32mCode of the program has been generated\033[0m\n" << std::endl;
+    if (this->debugInfo) {
+        this->debugInfo->Finalize();
+        delete this->debugInfo;
+        this->debugInfo = nullptr;
+    }
 
-    // LLVM 提供了 PassManager 类，可以将生成的 LLVM IR 中的模块信息打印到标准输出流 llvm::outs() 中
-    // 可以直接在程序输出中看到生成的 LLVM IR 结果
-    llvm::legacy::PassManager passManager;
-    passManager.add(llvm::createPrintModulePass(llvm::outs()));
-    std::cout << "\033[31mLLVM IR of the program:\033[0m\n" << std::endl;
-    passManager.run(*(this->module));   // passManager执行，打印 LLVM IR
-    std::cout << std::endl;
+    // 增量编译时，命中缓存的函数没有生成函数体，无法确定全局变量是否被写入
+    if (!this->objectCache)
+        MarkReadOnlyGlobals();
+
+    TRACE(TraceLevel::Phase, "\033[32mCode of the program has been generated\033[0m");
+
+    // 跟踪级别为 IR 时，将生成的 LLVM IR 打印到标准错误，不影响程序自身的输出
+    if (CurrentTraceLevel >= TraceLevel::IR) {
+        TRACE(TraceLevel::IR, "\033[31mLLVM IR of the program:\033[0m");
+        std::clog.flush();
+        this->module->print(llvm::errs(), nullptr);
+    }
 }
 
-#if LLVM_VERSION_MAJOR >= 16
 /**
- * @brief 生成源代码的目标代码
- * @param fileName 目标代码文件的名称
+ * @brief 判断 ptr 所指向的内存是否可能被写入，地址被传递给函数或存入其他变量时也视为可能被写入
+ */
+static bool MayBeWritten(const llvm::Value *ptr) {
+    for (const llvm::User *user : ptr->users()) {
+        if (llvm::isa<llvm::LoadInst>(user))
+            continue;
+        if (llvm::isa<llvm::GEPOperator>(user) || llvm::isa<llvm::BitCastOperator>(user)) {
+            if (MayBeWritten(user))
+                return true;
+            continue;
+        }
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief 将从未被写入的全局变量标记为常量，使优化时能够将对其的读取替换为初始值
+ *
+ * 全局变量的链接方式为 ExternalLinkage，LLVM 的 GlobalOpt 不会自行推断其为常量。
  */
-void CodeGenContext::GenerateObject(const std::string &fileName) const {
-    std::cout << "\033[31mGenerating object code file for the program...\033[0m" << std::endl;
+void CodeGenContext::MarkReadOnlyGlobals() {
+    for (llvm::GlobalVariable &global : this->module->globals())
+        if (!global.isDeclaration() && !global.isConstant() && !MayBeWritten(&global)) {
+            TRACE(TraceLevel::Node, "Global variable " << global.getName().str() << " is never written, marked as constant");
+            global.setConstant(true);
+        }
+}
+
+/**
+ * @brief 获取 JIT 编译后可写的全局变量的地址和大小，供执行进程池在每次运行前恢复其初始值
+ */
+std::vector<std::pair<void *, size_t>> CodeGenContext::GetWritableGlobals() const {
+    std::vector<std::pair<void *, size_t>> globals;
+    if (!this->executionEngine)
+        return globals;
+    for (const llvm::GlobalVariable &global : this->module->globals())
+        if (!global.isConstant() && !global.hasLocalLinkage()) {
+            auto address = this->executionEngine->getGlobalValueAddress(global.getName().str());
+            size_t size = this->module->getDataLayout().getTypeAllocSize(global.getValueType());
+            if (address)
+                globals.emplace_back(reinterpret_cast<void *>(address), size);
+        }
+    return globals;
+}
+
+/**
+ * @brief 停止收集优化报告，关闭 YAML 记录文件，应在优化和输出文件之后、执行程序之前调用
+ */
+void CodeGenContext::FinishRemarks() {
+    delete this->remarks;
+    this->remarks = nullptr;
+}
+
+/**
+ * @brief 按照 optLevel 指定的优化级别，对 module 执行 LLVM 的标准优化流水线
+ */
+void CodeGenContext::Optimize() {
+#if LLVM_VERSION_MAJOR >= 14
+    // 优化时需要知道目标机器的数据布局等信息，例如向量化需要知道向量寄存器的宽度
+    llvm::TargetMachine *targetMachine = GetTargetMachine();
+#else
+    llvm::TargetMachine *targetMachine = nullptr;
+#endif
+
+    // O0 不做任何优化
+    if (this->optLevel == 0)
+        return;
+
+    PhaseTimer timer("optimize");
+
+    TRACE(TraceLevel::Phase, "\033[31mOptimizing code at -O" << this->optLevel << "...\033[0m");
+    OptimizeModule(*this->module, targetMachine);
+    TRACE(TraceLevel::Phase, "\033[32mOptimization finishes\033[0m");
+}
+
+/**
+ * @brief 按照 optLevel 指定的优化级别，对给定的 module 执行 LLVM 的标准优化流水线
+ * @param module 被优化的 module
+ * @param targetMachine 本机的目标机器，可以为空指针
+ */
+void CodeGenContext::OptimizeModule(llvm::Module &module, llvm::TargetMachine *targetMachine) const {
+    // 新的 PassManager 需要为循环、函数、调用图、模块四个层次分别创建分析管理器，并相互注册
+    llvm::LoopAnalysisManager loopAnalysisManager;
+    llvm::FunctionAnalysisManager funcAnalysisManager;
+    llvm::CGSCCAnalysisManager cgsccAnalysisManager;
+    llvm::ModuleAnalysisManager moduleAnalysisManager;
+
+    // 开启 -ftime-report 时，为每个 pass 计时，在优化结束时输出各 pass 的耗时表格
+    // 开启 Chrome trace 时，PassManager 会自动为每个 pass 记录事件
+    llvm::PassInstrumentationCallbacks passInstrumentation;
+    llvm::TimePassesHandler timePasses(TimeReportEnabled);
+    timePasses.registerCallbacks(passInstrumentation);
+
+    llvm::PassBuilder passBuilder(targetMachine, llvm::PipelineTuningOptions(), {}, &passInstrumentation);
+    passBuilder.registerModuleAnalyses(moduleAnalysisManager);
+    passBuilder.registerCGSCCAnalyses(cgsccAnalysisManager);
+    passBuilder.registerFunctionAnalyses(funcAnalysisManager);
+    passBuilder.registerLoopAnalyses(loopAnalysisManager);
+    passBuilder.crossRegisterProxies(loopAnalysisManager, funcAnalysisManager, cgsccAnalysisManager, moduleAnalysisManager);
+
+    // 根据优化级别选择与 clang -O1 ~ -O3 相同的默认优化流水线
+    llvm::OptimizationLevel level = this->optLevel == 1 ? llvm::OptimizationLevel::O1
+                                  : this->optLevel == 2 ? llvm::OptimizationLevel::O2
+                                                        : llvm::OptimizationLevel::O3;
+    llvm::ModulePassManager modulePassManager = passBuilder.buildPerModuleDefaultPipeline(level);
+    modulePassManager.run(module, moduleAnalysisManager);
+}
+
+#if LLVM_VERSION_MAJOR >= 14
+/**
+ * @brief 获取本机的 llvm::TargetMachine，第一次调用时创建，并设置 module 的数据布局和目标三元组
+ * @return 本机的 llvm::TargetMachine 指针
+ */
+llvm::TargetMachine *CodeGenContext::GetTargetMachine() {
+    if (this->targetMachine)
+        return this->targetMachine;
 
     // TargetTriplet (目标三元组) 用来指定体系架构、操作系统和环境
     // 通过 getDefaultTargetTriple 可以获取到当前系统环境下相应的目标三元组
@@ -78,59 +244,344 @@ void CodeGenContext::GenerateObject(const std::string &fileName) const {
         throw std::runtime_error(error);
 
     // 生成重定位模型，用来指定链接器在链接时如何处理符号地址 (重定位在 OS 课程中讲过，可以回去复习)
-    auto relocModel = std::optional<llvm::Reloc::Model>();
+    // 使用位置无关代码，使目标文件可以被链接为默认开启 PIE 的可执行文件
+    auto relocModel = llvm::Reloc::PIC_;
     // 创建 llvm::TargetMachine，它是将 LLVM IR 转化为目标机器代码的核心组建
-    llvm::TargetMachine *targetMachine =
+    this->targetMachine =
             target->createTargetMachine(targetTriplet, "generic", "", llvm::TargetOptions(), relocModel);
 
     // 设置 module 的数据布局，数据布局是 llvm::Module 的一个属性
     // llvm::DataLayout 描述了不同类型的数据在内存中的表示方式和布局方式
     // 数据布局与系统环境相关，因此需要通过 llvm::TargetMachine 的 createDataLayout() 来得到
-    this->module->setDataLayout(targetMachine->createDataLayout());
+    this->module->setDataLayout(this->targetMachine->createDataLayout());
     // 设置 module 的目标三元组
     this->module->setTargetTriple(targetTriplet);
 
+    return this->targetMachine;
+}
+
+/**
+ * @brief 生成源代码的目标代码
+ * @param fileName 目标代码文件的名称
+ */
+void CodeGenContext::GenerateObject(const std::string &fileName) {
+    PhaseTimer timer("emit.object", fileName);
+
+    TRACE(TraceLevel::Phase, "\033[31mGenerating object code file for the program...\033[0m");
+    // 将输出文件的类型设为目标文件
+    EmitMachineCode(*this->module, fileName, llvm::CGFT_ObjectFile);
+    TRACE(TraceLevel::Phase, "\033[32mObject code file has been generated: " << fileName << "\033[0m");
+}
+
+/**
+ * @brief 生成源代码的汇编代码
+ * @param fileName 汇编代码文件的名称
+ */
+void CodeGenContext::GenerateAssembly(const std::string &fileName) {
+    PhaseTimer timer("emit.asm", fileName);
+
+    TRACE(TraceLevel::Phase, "\033[31mGenerating assembly file for the program...\033[0m");
+    // 将输出文件的类型设为汇编文件
+    EmitMachineCode(*this->module, fileName, llvm::CGFT_AssemblyFile);
+    TRACE(TraceLevel::Phase, "\033[32mAssembly file has been generated: " << fileName << "\033[0m");
+}
+
+/**
+ * @brief 利用目标机器的后端，将 module 编译为目标代码或汇编代码并写入文件
+ * @param module 被编译的 module
+ * @param fileName 输出文件的名称
+ * @param fileType 输出文件的类型
+ */
+void CodeGenContext::EmitMachineCode(llvm::Module &module, const std::string &fileName, llvm::CodeGenFileType fileType) {
+    llvm::TargetMachine *targetMachine = GetTargetMachine();
+
     std::error_code errorCode;
     // 创建 llvm::raw_fd_ostream 类的输出文件流对象
-    llvm::raw_fd_ostream objectFile(fileName, errorCode);
-    // llvm::raw_fd_ostream objectFile(fileName, errorCode, llvm::sys::fs::OF_None);
+    llvm::raw_fd_ostream outputFile(fileName, errorCode,
+                                    fileType == llvm::CGFT_AssemblyFile ? llvm::sys::fs::OF_Text : llvm::sys::fs::OF_None);
     if (errorCode)
         throw std::runtime_error(errorCode.message());
 
-    // 将输出文件的类型设为目标文件
-    llvm::CodeGenFileType fileType = llvm::CGFT_ObjectFile;
-    // 创建 PassManager，用于将生成的内容输出到目标文件中
+    // 创建 PassManager，用于将生成的内容输出到文件中
     llvm::legacy::PassManager passManager;
     // 将 targetMachine 中的包含的优化和代码生成 pass 传入到 passManager 中
-    targetMachine->addPassesToEmitFile(passManager, objectFile, nullptr, fileType);
-    // passManager 执行，将目标代码输入到目标文件
-    passManager.run(*this->module);
+    if (targetMachine->addPassesToEmitFile(passManager, outputFile, nullptr, fileType))
+        throw std::runtime_error("The target machine cannot emit a file of this type");
+    // passManager 执行，将生成的代码输入到文件
+    passManager.run(module);
     // 刷新输出流
-    objectFile.flush();
+    outputFile.flush();
+}
+#endif
+
+#if LLVM_VERSION_MAJOR >= 14
+/**
+ * @brief 开启增量编译
+ * @param fingerprints 各编译单元的指纹
+ * @param objectCache 目标文件缓存
+ */
+void CodeGenContext::SetIncremental(const Fingerprints *fingerprints, const ObjectCache *objectCache) {
+    this->fingerprints = fingerprints;
+    this->objectCache = objectCache;
+}
+
+/**
+ * @brief 判断用户函数能否直接使用缓存中的目标文件，可以时代码生成只需创建函数声明
+ * @param funcName 函数名称
+ */
+bool CodeGenContext::IsFuncReused(const std::string &funcName) const {
+    if (!this->objectCache)
+        return false;
+    auto iter = this->fingerprints->funcs.find(funcName);
+    return iter != this->fingerprints->funcs.end() && this->objectCache->Contains(iter->second);
+}
+
+/**
+ * @brief 判断 value 是否被 unit 中的定义直接或经由常量表达式间接使用
+ */
+static bool IsUsedByUnit(const llvm::Value *value, const std::set<const llvm::GlobalValue *> &unit) {
+    for (const llvm::User *user : value->users()) {
+        if (auto inst = llvm::dyn_cast<llvm::Instruction>(user)) {
+            // parallel for 的循环体函数是内部函数，随使用它的函数进入同一单元
+            const llvm::Function *func = inst->getFunction();
+            if (unit.count(func) || (func->hasLocalLinkage() && IsUsedByUnit(func, unit)))
+                return true;
+        } else if (auto global = llvm::dyn_cast<llvm::GlobalValue>(user)) {
+            if (unit.count(global) || (global->hasLocalLinkage() && IsUsedByUnit(global, unit)))
+                return true;
+        } else if (IsUsedByUnit(user, unit))
+            return true;
+    }
+    return false;
+}
+
+/**
+ * @brief 增量编译：把 module 按编译单元拆分，未命中缓存的单元单独优化并生成目标文件写入缓存
+ *
+ * 每个用户函数是一个编译单元，内置函数、全局变量等其余定义组成公共单元。命中缓存的用户函数在代码生成时
+ * 只创建了声明，这里直接使用缓存中的目标文件。各单元分别优化，因此不会跨函数内联。
+ * 完成后 module 中的函数体被删除，module 只作为查找 main 等函数的符号表。
+ */
+void CodeGenContext::CompileIncremental() {
+    PhaseTimer timer("incremental");
+
+    TRACE(TraceLevel::Phase, "\033[31mCompiling code incrementally at -O" << this->optLevel << "...\033[0m");
+
+    // 克隆的 module 会继承数据布局和目标三元组
+    GetTargetMachine();
+
+    // 按指纹对 module 中的定义分组
+    std::map<std::string, std::set<const llvm::GlobalValue *>> units;
+    units[this->fingerprints->common];
+    for (const auto &funcFingerprint : this->fingerprints->funcs)
+        units[funcFingerprint.second];
+    for (const llvm::GlobalValue &global : this->module->global_values()) {
+        if (global.isDeclaration() || global.hasLocalLinkage())
+            continue;
+        auto iter = this->fingerprints->funcs.find(global.getName().str());
+        bool isUserFunc = llvm::isa<llvm::Function>(global) && iter != this->fingerprints->funcs.end();
+        units[isUserFunc ? iter->second : this->fingerprints->common].insert(&global);
+    }
+
+    unsigned reused = 0;
+    this->objectFiles.clear();
+    for (const auto &unit : units) {
+        if (this->objectCache->Contains(unit.first))
+            ++reused;
+        else
+            CompileUnit(unit.first, unit.second);
+        this->objectFiles.push_back(this->objectCache->GetPath(unit.first));
+    }
+
+    for (llvm::Function &func : *this->module)
+        if (!func.isDeclaration())
+            func.deleteBody();
+
+    TRACE(TraceLevel::Phase, "\033[32mIncremental compilation finishes, " << reused << " of " << units.size()
+                             << " units reused\033[0m");
+}
 
-    std::cout << "\033[32mObject code file has been generated: " << fileName << "\033[0m\n" << std::endl;
+/**
+ * @brief 将一个编译单元克隆为单独的 module，优化后生成目标文件并写入缓存
+ * @param fingerprint 编译单元的指纹
+ * @param unit 编译单元中的定义
+ */
+void CodeGenContext::CompileUnit(const std::string &fingerprint, const std::set<const llvm::GlobalValue *> &unit) {
+    // 除本单元的定义，以及本单元用到的内部全局变量（如字符串常量）外，其余定义都克隆为声明
+    llvm::ValueToValueMapTy valueMap;
+    std::unique_ptr<llvm::Module> unitModule =
+            llvm::CloneModule(*this->module, valueMap, [&unit](const llvm::GlobalValue *global) {
+                return unit.count(global) || (global->hasLocalLinkage() && IsUsedByUnit(global, unit));
+            });
+
+    if (this->optLevel > 0)
+        OptimizeModule(*unitModule, GetTargetMachine());
+
+    const std::string tempPath = this->objectCache->GetTempPath(fingerprint);
+    EmitMachineCode(*unitModule, tempPath, llvm::CGFT_ObjectFile);
+    this->objectCache->Commit(tempPath, fingerprint);
 }
 #endif
 
 /**
- * @brief 直接执行编译后的源代码
+ * @brief 创建 MCJIT 执行引擎，并将 module 编译为机器码
+ * @return 完成初始化的 llvm::ExecutionEngine 指针
  */
-void CodeGenContext::ExecuteCode() {
-    std::cout << "\033[31mExecuting code...\033[0m" << std::endl;
+llvm::ExecutionEngine *CodeGenContext::CreateExecutionEngine() {
+    PhaseTimer timer("jit");
+
+    // MCJIT 后端的优化级别与 IR 优化级别保持一致
+    llvm::CodeGenOpt::Level codeGenOptLevel = this->optLevel == 0 ? llvm::CodeGenOpt::None
+                                            : this->optLevel == 1 ? llvm::CodeGenOpt::Less
+                                            : this->optLevel == 2 ? llvm::CodeGenOpt::Default
+                                                                  : llvm::CodeGenOpt::Aggressive;
+
+    // 增量编译时 module 中只剩声明，JIT 使用一个空的 module，并直接加载各编译单元的目标文件
+    std::unique_ptr<llvm::Module> engineModule(this->objectFiles.empty() ? this->module
+                                                                         : new llvm::Module("incremental", Context));
 
     // llvm::ExecutionEngion 能够对 LLVM IR 进行解释并执行
-    llvm::ExecutionEngine *executionEngine =
-            llvm::EngineBuilder(std::unique_ptr<llvm::Module>(this->module)).create();
+    // 若已预先创建，则只需加入 module 并调整后端的优化级别
+    llvm::ExecutionEngine *executionEngine = this->preparedEngine;
+    if (executionEngine) {
+        executionEngine->getTargetMachine()->setOptLevel(codeGenOptLevel);
+        executionEngine->addModule(std::move(engineModule));
+    } else
+        executionEngine = llvm::EngineBuilder(std::move(engineModule)).setOptLevel(codeGenOptLevel).create();
+
+    // 注册 perf 相关的 JIT 事件监听器，必须在加载增量编译的目标文件和 finalizeObject() 生成机器码之前完成
+    if (this->perfSupport) {
+        // perf map 文件只包含函数名和地址范围，供 perf report 使用
+        if (!this->perfMapListener)
+            this->perfMapListener = new PerfMapListener();
+        executionEngine->RegisterJITEventListener(this->perfMapListener);
+        // jitdump 文件还包含机器码和调试信息，经 perf inject --jit 处理后可供 perf annotate 使用
+        // 只有 LLVM 在构建时开启了 LLVM_USE_PERF 才可用，否则返回空指针
+        if (llvm::JITEventListener *jitDumpListener = llvm::JITEventListener::createPerfJITEventListener())
+            executionEngine->RegisterJITEventListener(jitDumpListener);
+        else
+            std::cerr << "Warning: LLVM is built without perf support, jitdump is not available" << std::endl;
+    }
+    // 带有调试信息时向 GDB 注册 JIT 生成的目标文件，使调试器能够显示源代码位置
+    if (this->debugInfoEnabled)
+        executionEngine->RegisterJITEventListener(llvm::JITEventListener::createGDBRegistrationListener());
+    // 统计实际生成了机器码的函数，写入执行报告
+    if (!this->functionCounter)
+        this->functionCounter = new FunctionCountListener();
+    executionEngine->RegisterJITEventListener(this->functionCounter);
+
+    for (const auto &objectFile : this->objectFiles) {
+        auto object = llvm::object::ObjectFile::createObjectFile(objectFile);
+        if (!object)
+            throw std::runtime_error("Cannot load " + objectFile + ": " + llvm::toString(object.takeError()));
+        executionEngine->addObjectFile(std::move(*object));
+    }
+
+    // 生成的代码调用的运行时库函数链接在编译器中，须显式告知 JIT 其地址
+    llvm::sys::DynamicLibrary::AddSymbol("cp_parallel_for", reinterpret_cast<void *>(&cp_parallel_for));
+    llvm::sys::DynamicLibrary::AddSymbol("cp_bounds_check_failed", reinterpret_cast<void *>(&cp_bounds_check_failed));
+    llvm::sys::DynamicLibrary::AddSymbol("cp_loop_bounds_check_failed",
+                                         reinterpret_cast<void *>(&cp_loop_bounds_check_failed));
+    llvm::sys::DynamicLibrary::AddSymbol("cp_length_check_failed", reinterpret_cast<void *>(&cp_length_check_failed));
+
     // 完成 llvm::ExecutionEngine 实例的初始化
     executionEngine->finalizeObject();
 
-    // 创建一个空的参数列表
-    // TODO: 如果要允许用户输入参数，则需要进一步增加参数列表的内容
-    std::vector<llvm::GenericValue> emptyArg;
+    return executionEngine;
+}
+
+/**
+ * @brief 预先初始化目标机器，并创建一个不含用户代码的 ExecutionEngine，之后执行时直接向其中加入 module
+ *
+ * 服务模式在启动时调用，使每个请求都不必重复这部分初始化。
+ */
+void CodeGenContext::PrepareJIT() {
+#if LLVM_VERSION_MAJOR >= 14
+    GetTargetMachine();
+#endif
+    this->preparedEngine = llvm::EngineBuilder(std::make_unique<llvm::Module>("jit", Context)).create();
+}
+
+/**
+ * @brief 判断 main 函数是否接收命令行参数
+ * @return main 为 int main(int argc, char **argv) 时为 true，没有形参时为 false
+ */
+static bool HasMainArgs(llvm::Function *mainFunc) {
+    if (mainFunc->arg_empty())
+        return false;
+    llvm::FunctionType *funcType = mainFunc->getFunctionType();
+    if (!funcType->getReturnType()->isIntegerTy(32) || funcType->getNumParams() != 2
+        || !funcType->getParamType(0)->isIntegerTy(32) || !funcType->getParamType(1)->isPointerTy())
+        throw std::logic_error("main with parameters must be int main(int argc, char **argv)");
+    return true;
+}
+
+/**
+ * @brief 直接执行编译后的源代码
+ * @param args 传给 main 的 argv，第一项为程序名；main 没有形参时忽略
+ * @return main 函数的返回值，作为进程的退出码；main 的返回类型不是整数时为 0
+ */
+int CodeGenContext::ExecuteCode(const std::vector<std::string> &args) {
+    TRACE(TraceLevel::Phase, "\033[31mExecuting code...\033[0m");
+
+    if (!this->mainFunc)
+        throw std::logic_error("The program does not define main");
+    const bool hasArgs = HasMainArgs(this->mainFunc);
+
+    auto jitStart = std::chrono::steady_clock::now();
+    llvm::ExecutionEngine *executionEngine = CreateExecutionEngine();
+    auto runStart = std::chrono::steady_clock::now();
+    this->jitTime = std::chrono::duration<double>(runStart - jitStart).count();
+
+    PhaseTimer timer("execute");
+
+    // argv 按 C 的约定以空指针结尾，字符串在 main 返回之前都有效
+    std::vector<char *> argv;
+    for (const std::string &arg : args)
+        argv.push_back(const_cast<char *>(arg.c_str()));
+    argv.push_back(nullptr);
+    std::vector<llvm::GenericValue> mainArgs;
+    if (hasArgs) {
+        mainArgs.emplace_back();
+        mainArgs.back().IntVal = llvm::APInt(32, args.size());
+        mainArgs.push_back(llvm::PTOGV(argv.data()));
+    }
     // 利用 llvm::ExecutionEngion 的 runFunction()，直接运行 main 函数
-    executionEngine->runFunction(this->mainFunc, emptyArg);
+    llvm::GenericValue result = executionEngine->runFunction(this->mainFunc, mainArgs);
 
-    std::cout << "\033[32mExecution finishes\033[0m" << std::endl;
+    this->runTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - runStart).count();
+
+    TRACE(TraceLevel::Phase, "\033[32mExecution finishes\033[0m");
+
+    // 与 C 程序一致，返回值按有符号数解释（bool 为 0 或 1），由操作系统截取低 8 位作为退出状态
+    llvm::Type *returnType = this->mainFunc->getReturnType();
+    if (!returnType->isIntegerTy())
+        return 0;
+    return static_cast<int>(returnType->isIntegerTy(1) ? result.IntVal.getZExtValue() : result.IntVal.getSExtValue());
+}
+
+/**
+ * @brief 获取 JIT 生成了机器码的函数数量，尚未进行 JIT 编译时为 0
+ */
+size_t CodeGenContext::GetMaterializedFunctionCount() const {
+    return this->functionCounter ? this->functionCounter->GetFunctionCount() : 0;
+}
+
+/**
+ * @brief 对 module 进行 JIT 编译，返回 main 函数，供执行进程池多次直接调用
+ * @return main 函数的地址及其是否接收命令行参数
+ */
+MainFunction CodeGenContext::GetMainFunction() {
+    if (!this->mainFunc || !this->mainFunc->getReturnType()->isIntegerTy(32))
+        throw std::logic_error("The program must define int main(void) or int main(int argc, char **argv) to be run repeatedly");
+
+    MainFunction mainFunction;
+    mainFunction.hasArgs = HasMainArgs(this->mainFunc);
+    auto jitStart = std::chrono::steady_clock::now();
+    this->executionEngine = CreateExecutionEngine();
+    mainFunction.address = this->executionEngine->getPointerToFunction(this->mainFunc);
+    this->jitTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - jitStart).count();
+    return mainFunction;
 }
 
 /**
@@ -138,14 +589,34 @@ void CodeGenContext::ExecuteCode() {
  * @param fileName LLVM IR 输出的文件的名称
  */
 void CodeGenContext::DumpLLVMIR(const std::string &fileName) const {
+    PhaseTimer timer("emit.ir", fileName);
+
     std::error_code errorCode;
     // 创建 llvm::raw_fd_ostream 类的输出文件流对象
-    llvm::raw_fd_ostream llvmFile(fileName, errorCode);
+    llvm::raw_fd_ostream llvmFile(fileName, errorCode, llvm::sys::fs::OF_Text);
+    if (errorCode)
+        throw std::runtime_error(errorCode.message());
 
     // 调用 llvm::Module 的 print() 方法，可以直接将 LLVM IR 输出到指定文件流中
     this->module->print(llvmFile, nullptr);
 }
 
+/**
+ * @brief 将 LLVM IR 以 bitcode 格式输出到指定文件中，bitcode 比文本格式的 IR 更紧凑，写入和读取都更快
+ * @param fileName bitcode 输出的文件的名称
+ */
+void CodeGenContext::DumpBitcode(const std::string &fileName) const {
+    PhaseTimer timer("emit.bc", fileName);
+
+    std::error_code errorCode;
+    // 创建 llvm::raw_fd_ostream 类的输出文件流对象
+    llvm::raw_fd_ostream bitcodeFile(fileName, errorCode, llvm::sys::fs::OF_None);
+    if (errorCode)
+        throw std::runtime_error(errorCode.message());
+
+    llvm::WriteBitcodeToFile(*this->module, bitcodeFile);
+}
+
 /**
  * @brief 将一个基本块压入基本块构成的栈
  * @param basicBlock 需要压入的基本块的指针
@@ -185,6 +656,17 @@ llvm::Value *CodeGenContext::GetVar(const std::string &varName)  {
     return nullptr;
 }
 
+/**
+ * @brief 只在全局作用域中查找变量，找不到时返回空指针
+ */
+llvm::Value *CodeGenContext::GetGlobalVar(const std::string &varName) {
+    if (this->blocks.empty())
+        return nullptr;
+    VarTable &globalVars = this->blocks.front()->localVars;
+    auto iter = globalVars.find(varName);
+    return iter == globalVars.end() ? nullptr : iter->second;
+}
+
 bool CodeGenContext::IsVarDefined(const std::string &varName) {
     for (auto block = blocks.rbegin(); block != blocks.rend(); ++block)
         if ((*block)->localVars.find(varName) != (*block)->localVars.end())
@@ -192,12 +674,29 @@ bool CodeGenContext::IsVarDefined(const std::string &varName) {
     return false;
 }
 
+/**
+ * @brief 获取当前位置可见的全部变量，内层基本块中的变量遮蔽外层的同名变量
+ * @return 变量名到变量地址的映射
+ */
+VarTable CodeGenContext::GetVisibleVars() const {
+    VarTable visibleVars;
+    for (auto block = blocks.rbegin(); block != blocks.rend(); ++block)
+        for (const auto &var : (*block)->localVars)
+            if (var.second)
+                visibleVars.insert(var);    // 已存在的同名变量来自更内层，不会被覆盖
+    return visibleVars;
+}
+
 /* 以下是 AST 节点类型的方法实现（主要为 GenCode 方法） */
 
 namespace AST {
 
     llvm::Value *Param::CodeGen(CodeGenContext *context) {
-        std::cout << "Creating parameter " << this->paramName << "..." << std::endl;
+        TRACE(TraceLevel::Node, "Creating parameter " << this->paramName << "...");
+
+        // 数组不能按值传递，C 中的数组形参实际上是指针，此处要求直接写成指针
+        if (this->paramType->isArr)
+            throw std::logic_error("Parameter " + this->paramName + " cannot be an array, use a pointer instead");
 
         // 获取到该形参的 LLVM 类型
         llvm::Type *LLVMType = this->paramType->GetLLVMType(context);
@@ -205,6 +704,10 @@ namespace AST {
         // 创建 llvm::AllocaInst 指令，在函数栈中为形参分配内存空间
         llvm::IRBuilder<> tmpBuilder(context->GetCurrentBlock());
         llvm::AllocaInst *alloca = tmpBuilder.CreateAlloca(LLVMType, nullptr, this->paramName);
+        if (this->paramType->IsUnsigned())
+            context->SetUnsigned(alloca);
+        if (this->paramType->isPtr)
+            context->SetPtrType(alloca, static_cast<PtrType *>(this->paramType));
 
         // 在变量表中插入 (paramName, alloca) 对
         context->AddLocalVar(alloca, this->paramName);
@@ -222,14 +725,28 @@ namespace AST {
         if (LLVMBaseType->isVoidTy())
             throw std::logic_error("Cannot define variables of \"void\" type");
 
+        // 在函数之外定义的是全局变量
+        if (!context->GetCurrentFunc()) {
+            CodeGenGlobal(context, LLVMBaseType);
+            return nullptr;
+        }
+        if (this->isConst) {
+            CodeGenConstLocal(context, LLVMBaseType);
+            return nullptr;
+        }
+
         // 逐个创建 VarInitList 中的每个变量
         for (auto var : *this->varInitList) {
             if (var->complexType) {
-                std::cout << "Creating variable " << var->varName << " with type " << var->complexType->GetTypeName() << std::endl;
+                TRACE(TraceLevel::Node, "Creating variable " << var->varName << " with type " << var->complexType->GetTypeName());
 
                 llvm::IRBuilder<> tmpBuilder(context->GetCurrentBlock());
                 llvm::Type *LLVMComplexType = var->complexType->GetLLVMType(context);
                 llvm::AllocaInst *alloca = tmpBuilder.CreateAlloca(LLVMComplexType, nullptr, var->varName);
+                if (var->complexType->IsUnsigned())
+                    context->SetUnsigned(alloca);
+                if (var->complexType->isPtr)
+                    context->SetPtrType(alloca, static_cast<PtrType *>(var->complexType));
 
                 // 在变量表中插入 (varName, allocaInst) 对
                 // 如果添加变量失败，将 alloca 从基本块中移除;
@@ -237,12 +754,17 @@ namespace AST {
                     alloca->eraseFromParent();
                     throw std::logic_error("Refine variable " + var->varName);
                 }
+                if (DebugInfo *debugInfo = context->GetDebugInfo())
+                    debugInfo->DeclareLocalVar(alloca, var->varName, debugInfo->GetType(var->complexType, context),
+                                               var->location);
             }
             else {
-                std::cout << "Creating variable " << var->varName << " with type " << this->typeSpecifier->GetTypeName() << std::endl;
+                TRACE(TraceLevel::Node, "Creating variable " << var->varName << " with type " << this->typeSpecifier->GetTypeName());
 
                 llvm::IRBuilder<> tmpBuilder(context->GetCurrentBlock());
                 llvm::AllocaInst *alloca = tmpBuilder.CreateAlloca(LLVMBaseType, nullptr, var->varName);
+                if (this->typeSpecifier->IsUnsigned())
+                    context->SetUnsigned(alloca);
 
                 // 在变量表中插入 (varName, allocaInst) 对
                 // 如果添加变量失败，将 alloca 从基本块中移除;
@@ -250,68 +772,149 @@ namespace AST {
                     alloca->eraseFromParent();
                     throw std::logic_error("Refine variable " + var->varName);
                 }
+                if (DebugInfo *debugInfo = context->GetDebugInfo())
+                    debugInfo->DeclareLocalVar(alloca, var->varName, debugInfo->GetType(this->typeSpecifier, context),
+                                               var->location);
 
                 // 处理包含初始值的情况
                 if (var->initExpr) {
-                    /// TODO: 需要处理类型转换的问题
-                    Builder.CreateStore(var->initExpr->CodeGen(context), alloca);
+                    DebugLocationScope debugLocation(context, var);
+                    llvm::Value *initValue = var->initExpr->CodeGen(context);
+                    Builder.CreateStore(CastToType(initValue, var->initExpr->isUnsigned, LLVMBaseType,
+                                                   this->typeSpecifier->IsUnsigned()), alloca);
                 }
             }
 
-            std::cout << "Variable " << var->varName << " has been created" << std::endl;
+            TRACE(TraceLevel::Node, "Variable " << var->varName << " has been created");
         }
 
         // 该函数的返回值不会使用，故返回空指针
         return nullptr;
     }
 
-    VarInit::VarInit(std::string varName, TypeSpecifier *complexType, TypeSpecifier *baseType, Expr *initExpr)
-            : varName(std::move(varName)), initExpr(initExpr), complexType(complexType) {
-        TypeSpecifier *leafNode = ReverseComplexType();
-        if (leafNode->isArr)
-            static_cast<ArrType *>(leafNode)->elementType = baseType;
-        else if (leafNode->isPtr)
-            static_cast<PtrType *>(leafNode)->objectType = baseType;
+    /**
+     * @brief 在编译期对变量的初始值求值，并隐式转换为变量的类型
+     * @param context 代码生成上下文
+     * @param var 带有初始值的变量
+     * @param LLVMType 变量的类型
+     * @param isUnsigned 变量是否为无符号整型
+     * @param kind 变量的种类，用于错误信息
+     * @return 初始值
+     */
+    static llvm::Constant *EvaluateInitializer(CodeGenContext *context, VarInit *var, llvm::Type *LLVMType,
+                                               bool isUnsigned, const std::string &kind) {
+        const std::string what = "Initializer of " + kind + " " + var->varName;
+        llvm::Constant *initializer = EvaluateConstant(context, var->initExpr, what);
+        if (initializer->getType()->isIntegerTy() || initializer->getType()->isFloatingPointTy())
+            initializer = llvm::cast<llvm::Constant>(CastToType(initializer, var->initExpr->isUnsigned, LLVMType, isUnsigned));
+        if (initializer->getType() != LLVMType)
+            throw std::logic_error(what + " has a different type");
+        return initializer;
     }
 
+    /**
+     * @brief 将变量定义为 llvm::GlobalVariable，初始值在编译期求值，没有初始值时为零
+     *
+     * 初始值为零的全局变量位于 .bss 段，其余位于 .data 段，程序运行时不需要执行初始化代码；const 全局变量位于 .rodata 段。
+     * @param context 代码生成上下文
+     * @param LLVMBaseType 变量的基本类型
+     */
+    void VarDef::CodeGenGlobal(CodeGenContext *context, llvm::Type *LLVMBaseType) {
+        for (auto var : *this->varInitList) {
+            TypeSpecifier *varType = var->complexType ? var->complexType : this->typeSpecifier;
+            llvm::Type *LLVMType = var->complexType ? var->complexType->GetLLVMType(context) : LLVMBaseType;
+
+            TRACE(TraceLevel::Node, "Creating global variable " << var->varName << " with type "
+                                    << varType->GetTypeName());
+
+            // 全局变量与函数共用 module 的符号表，不能重名
+            if (context->module->getNamedValue(var->varName) || context->IsVarInLocal(var->varName))
+                throw std::logic_error("Refine variable " + var->varName);
+
+            if (this->isConst && !var->initExpr)
+                throw std::logic_error("Const variable " + var->varName + " should be initialized");
+            llvm::Constant *initializer = var->initExpr
+                    ? EvaluateInitializer(context, var, LLVMType, varType->IsUnsigned(),
+                                          this->isConst ? "const variable" : "global variable")
+                    : llvm::Constant::getNullValue(LLVMType);
+
+            // 全局变量使用 ExternalLinkage，增量编译时各编译单元共用公共单元中的同一份定义
+            auto global = new llvm::GlobalVariable(*context->module, LLVMType, this->isConst,
+                                                   llvm::GlobalValue::ExternalLinkage, initializer, var->varName);
+            if (varType->IsUnsigned())
+                context->SetUnsigned(global);
+            if (varType->isPtr)
+                context->SetPtrType(global, static_cast<PtrType *>(varType));
+            context->AddLocalVar(global, var->varName);
+            if (DebugInfo *debugInfo = context->GetDebugInfo())
+                debugInfo->DeclareGlobalVar(global, var->varName, debugInfo->GetType(varType, context), var->location);
+
+            TRACE(TraceLevel::Node, "Global variable " << var->varName << " has been created");
+        }
+    }
+
+    /**
+     * @brief 将函数中的 const 变量定义为私有的常量 llvm::GlobalVariable，初始值在编译期求值
+     *
+     * 对 const 变量的读取直接使用其初始值，不生成取数指令；作为数组长度等常量表达式的一部分时也由编译期求值器读取其初始值。
+     * @param context 代码生成上下文
+     * @param LLVMBaseType 变量的基本类型
+     */
+    void VarDef::CodeGenConstLocal(CodeGenContext *context, llvm::Type *LLVMBaseType) {
+        for (auto var : *this->varInitList) {
+            TypeSpecifier *varType = var->complexType ? var->complexType : this->typeSpecifier;
+            llvm::Type *LLVMType = var->complexType ? var->complexType->GetLLVMType(context) : LLVMBaseType;
+
+            TRACE(TraceLevel::Node, "Creating const variable " << var->varName << " with type "
+                                    << varType->GetTypeName());
+
+            if (!var->initExpr)
+                throw std::logic_error("Const variable " + var->varName + " should be initialized");
+            if (context->IsVarInLocal(var->varName))
+                throw std::logic_error("Refine variable " + var->varName);
+            llvm::Constant *initializer = EvaluateInitializer(context, var, LLVMType, varType->IsUnsigned(), "const variable");
+
+            auto global = new llvm::GlobalVariable(*context->module, LLVMType, true, llvm::GlobalValue::PrivateLinkage,
+                                                   initializer, context->GetCurrentFuncName() + "." + var->varName);
+            global->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
+            if (varType->IsUnsigned())
+                context->SetUnsigned(global);
+            context->AddLocalVar(global, var->varName);
+            if (DebugInfo *debugInfo = context->GetDebugInfo())
+                debugInfo->DeclareGlobalVar(global, var->varName, debugInfo->GetType(varType, context), var->location);
+
+            TRACE(TraceLevel::Node, "Const variable " << var->varName << " has been created");
+        }
+    }
+
+    VarDef::~VarDef() {
+        // 类型说明符由类型表共享，不随节点释放
+        for (auto var : *this->varInitList)
+            delete var;
+        delete this->varInitList;
+    }
+
+    VarInit::~VarInit() {
+        delete this->initExpr;
+    }
+
+    VarInit::VarInit(std::string varName, const Declarator &declarator, TypeSpecifier *baseType, Expr *initExpr)
+            : varName(std::move(varName)), initExpr(initExpr),
+              complexType(TypeTable::GetDeclaredType(baseType, declarator)) {}
+
     llvm::Value *VarInit::CodeGen(CodeGenContext *context) {
         // 变量初始化结点不需要 CodeGen() 操作，故直接返回空指针
         return nullptr;
     }
 
-    TypeSpecifier *VarInit::ReverseComplexType() {
-        TypeSpecifier *firstNode = this->complexType, *curNode = firstNode, *fatherNode;
+    llvm::Value *StructDef::CodeGen(CodeGenContext *context) {
+        TRACE(TraceLevel::Node, "Creating " << this->structType->GetTypeName() << "...");
 
-        ArrType *arrNode;
-        PtrType *ptrNode;
-        if (curNode->isArr) {
-            arrNode = static_cast<ArrType *>(curNode);
-            fatherNode = arrNode->_fatherType;
-        }
-        else if (curNode->isPtr) {
-            ptrNode = static_cast<PtrType *>(curNode);
-            fatherNode = ptrNode->_fatherType;
-        }
+        // 结构体定义不生成代码，此处求出成员的类型以便尽早报告其中的错误，成员的数组长度也在此时求值
+        this->structType->GetLLVMType(context);
 
-        while (fatherNode) {
-            if (fatherNode->isArr)
-                static_cast<ArrType *>(fatherNode)->elementType = curNode;
-            else if (fatherNode->isPtr)
-                static_cast<PtrType *>(fatherNode)->objectType = curNode;
-
-            curNode = fatherNode;
-            if (curNode->isArr) {
-                arrNode = static_cast<ArrType *>(curNode);
-                fatherNode = arrNode->_fatherType;
-            }
-            else if (curNode->isPtr) {
-                ptrNode = static_cast<PtrType *>(curNode);
-                fatherNode = ptrNode->_fatherType;
-            }
-        }
-
-        this->complexType = curNode;
-        return firstNode;
+        TRACE(TraceLevel::Node, this->structType->GetTypeName() << " has been created");
+        return nullptr;
     }
 
     llvm::Type *BuiltInType::GetLLVMType(CodeGenContext *context) {
@@ -325,8 +928,19 @@ namespace AST {
             case _BOOL: this->LLVMType = llvm::Type::getInt1Ty(Context);  break;
             case _CHAR: this->LLVMType = llvm::Type::getInt8Ty(Context);  break;
             case _INT:  this->LLVMType = llvm::Type::getInt32Ty(Context); break;
-            // case _FLOAT: this->LLVMType = LLVM::Type::getFloatTy(Context); break;
+            case _FLOAT: this->LLVMType = llvm::Type::getFloatTy(Context); break;
             case _DOUBLE: this->LLVMType = llvm::Type::getDoubleTy(Context); break;
+            case _SHORT: case _USHORT: this->LLVMType = llvm::Type::getInt16Ty(Context); break;
+            case _LONG: case _ULONG: this->LLVMType = llvm::Type::getInt64Ty(Context); break;
+            case _UCHAR: this->LLVMType = llvm::Type::getInt8Ty(Context); break;
+            case _UINT: this->LLVMType = llvm::Type::getInt32Ty(Context); break;
+            case _INT2: this->LLVMType = llvm::FixedVectorType::get(llvm::Type::getInt32Ty(Context), 2); break;
+            case _INT4: this->LLVMType = llvm::FixedVectorType::get(llvm::Type::getInt32Ty(Context), 4); break;
+            case _INT8: this->LLVMType = llvm::FixedVectorType::get(llvm::Type::getInt32Ty(Context), 8); break;
+            case _DOUBLE2: this->LLVMType = llvm::FixedVectorType::get(llvm::Type::getDoubleTy(Context), 2); break;
+            case _DOUBLE4: this->LLVMType = llvm::FixedVectorType::get(llvm::Type::getDoubleTy(Context), 4); break;
+            case _FLOAT4: this->LLVMType = llvm::FixedVectorType::get(llvm::Type::getFloatTy(Context), 4); break;
+            case _FLOAT8: this->LLVMType = llvm::FixedVectorType::get(llvm::Type::getFloatTy(Context), 8); break;
 
         }
 
@@ -337,16 +951,171 @@ namespace AST {
         if (this->LLVMType)
             return this->LLVMType;
 
+        // 数组长度在编译期求值，必须是正整数
+        auto size = llvm::dyn_cast<llvm::ConstantInt>(EvaluateConstant(context, this->sizeExpr, "Array size"));
+        if (!size)
+            throw std::logic_error("Array size is not an integer");
+        if (size->getValue().getActiveBits() > 32 || (!size->getType()->isIntegerTy(1) && size->isNegative())
+            || size->isZero())
+            throw std::logic_error("Array size " + std::to_string(size->getSExtValue()) + " is not positive");
+        this->size = size->getZExtValue();
+
         llvm::Type *LLVMElementType = this->elementType->GetLLVMType(context);
-        return llvm::ArrayType::get(LLVMElementType, size);
+        if (!IsSoA()) {
+            this->LLVMType = llvm::ArrayType::get(LLVMElementType, this->size);
+            return this->LLVMType;
+        }
+
+        this->LLVMType = TypeTable::GetSoALLVMType(this, context);
+        return this->LLVMType;
+    }
+
+    bool ArrType::IsSoA() const {
+        return this->elementType->isStruct && static_cast<StructType *>(this->elementType)->isSoA;
     }
 
     llvm::Type *PtrType::GetLLVMType(CodeGenContext *context) {
         if (this->LLVMType)
             return this->LLVMType;
 
-        llvm::Type *LLVMObjectType = this->objectType->GetLLVMType(context);
-        return llvm::PointerType::get(LLVMObjectType, 0);
+        // 指向结构体的指针只需要结构体的名称，结构体的成员可以包含指向自身的指针
+        llvm::Type *LLVMObjectType = this->objectType->isStruct
+                ? static_cast<StructType *>(this->objectType)->GetDeclaredLLVMType()
+                : this->objectType->GetLLVMType(context);
+        this->LLVMType = llvm::PointerType::get(LLVMObjectType, 0);
+        return this->LLVMType;
+    }
+
+    llvm::Type *StructType::GetLLVMType(CodeGenContext *context) {
+        if (this->LLVMType)
+            return this->LLVMType;
+
+        if (!this->isDefined)
+            throw std::logic_error("Incomplete type " + GetTypeName());
+        if (this->isLayingOut)
+            throw std::logic_error(GetTypeName() + " contains itself");
+
+        this->isLayingOut = true;
+        std::vector<llvm::Type *> memberTypes;
+        std::set<std::string> memberNames;
+        for (auto &member : this->members) {
+            if (!memberNames.insert(member.name).second)
+                throw std::logic_error("Duplicate member " + member.name + " in " + GetTypeName());
+            llvm::Type *memberType = member.type->GetLLVMType(context);
+            if (memberType->isVoidTy())
+                throw std::logic_error("Member " + member.name + " of " + GetTypeName() + " has \"void\" type");
+            memberTypes.push_back(memberType);
+        }
+        this->isLayingOut = false;
+
+        GetDeclaredLLVMType()->setBody(memberTypes);
+        this->LLVMType = this->declaredType;
+        return this->LLVMType;
+    }
+
+    llvm::StructType *StructType::GetDeclaredLLVMType() {
+        if (!this->declaredType) {
+            this->declaredType = llvm::StructType::create(Context, "struct." + this->name);
+            TypeTable::RegisterLLVMType(this->declaredType, this);
+        }
+        return this->declaredType;
+    }
+
+    unsigned StructType::GetMemberIndex(const std::string &memberName) const {
+        for (unsigned i = 0; i < this->members.size(); ++i)
+            if (this->members[i].name == memberName)
+                return i;
+        throw std::logic_error("No member named " + memberName + " in struct " + this->name);
+    }
+
+    BuiltInType *TypeTable::GetBuiltInType(BuiltInType::TypeID type) {
+        static std::map<BuiltInType::TypeID, BuiltInType *> builtInTypes;
+        BuiltInType *&builtInType = builtInTypes[type];
+        if (!builtInType)
+            builtInType = new BuiltInType(type);
+        return builtInType;
+    }
+
+    PtrType *TypeTable::GetPtrType(TypeSpecifier *objectType) {
+        static std::map<TypeSpecifier *, PtrType *> ptrTypes;
+        PtrType *&ptrType = ptrTypes[objectType];
+        if (!ptrType)
+            ptrType = new PtrType(objectType);
+        return ptrType;
+    }
+
+    ArrType *TypeTable::GetArrType(TypeSpecifier *elementType, Expr *sizeExpr) {
+        auto size = dynamic_cast<Integer *>(sizeExpr);
+        if (!size)
+            return new ArrType(elementType, sizeExpr);
+
+        static std::map<std::pair<TypeSpecifier *, long long>, ArrType *> arrTypes;
+        ArrType *&arrType = arrTypes[{ elementType, size->intVal }];
+        if (!arrType)
+            arrType = new ArrType(elementType, sizeExpr);
+        return arrType;
+    }
+
+    /**
+     * @brief 由基本类型和声明符得到变量的类型，声明符的各层从外向内依次作用于基本类型
+     * @param baseType 基本类型
+     * @param declarator 声明符，从变量名向外排列
+     * @return 唯一化后的类型
+     */
+    TypeSpecifier *TypeTable::GetDeclaredType(TypeSpecifier *baseType, const Declarator &declarator) {
+        TypeSpecifier *type = baseType;
+        for (auto iter = declarator.rbegin(); iter != declarator.rend(); ++iter)
+            type = *iter ? static_cast<TypeSpecifier *>(GetArrType(type, *iter)) : GetPtrType(type);
+        return type;
+    }
+
+    /**
+     * @brief 获取名为 name 的结构体类型，在结构体定义之前使用时先创建未定义的类型，由结构体定义设置其成员
+     */
+    StructType *TypeTable::GetStructType(const std::string &name) {
+        static std::map<std::string, StructType *> structTypes;
+        StructType *&structType = structTypes[name];
+        if (!structType)
+            structType = new StructType(name);
+        return structType;
+    }
+
+    /**
+     * @brief 获取 SoA 布局的数组的 LLVM 类型：每个成员各自为一个长度相同的数组，整个数组是由这些数组构成的结构体
+     *
+     * 长度不是字面量的数组类型没有被唯一化，同一结构体、同一长度的 SoA 数组仍须共用一个 LLVM 类型，才能互相赋值。
+     * @param arrType 已求得长度的数组类型
+     */
+    llvm::StructType *TypeTable::GetSoALLVMType(ArrType *arrType, CodeGenContext *context) {
+        static std::map<std::pair<StructType *, size_t>, llvm::StructType *> soaTypes;
+        auto structType = static_cast<StructType *>(arrType->elementType);
+        llvm::StructType *&soaType = soaTypes[{ structType, arrType->size }];
+        if (!soaType) {
+            std::vector<llvm::Type *> memberArrays;
+            for (auto &member : structType->members)
+                memberArrays.push_back(llvm::ArrayType::get(member.type->GetLLVMType(context), arrType->size));
+            soaType = llvm::StructType::create(Context, memberArrays,
+                                               "soa." + structType->name + "." + std::to_string(arrType->size));
+            RegisterLLVMType(soaType, arrType);
+        }
+        return soaType;
+    }
+
+    /* 结构体和 SoA 布局的数组对应的 LLVM 类型都是结构体，由 LLVM 类型找回类型说明符 */
+    static std::map<llvm::Type *, TypeSpecifier *> LLVMTypeOwners;
+
+    void TypeTable::RegisterLLVMType(llvm::Type *LLVMType, TypeSpecifier *type) {
+        LLVMTypeOwners[LLVMType] = type;
+    }
+
+    StructType *TypeTable::FindStructType(llvm::Type *LLVMType) {
+        auto iter = LLVMTypeOwners.find(LLVMType);
+        return iter != LLVMTypeOwners.end() && iter->second->isStruct ? static_cast<StructType *>(iter->second) : nullptr;
+    }
+
+    ArrType *TypeTable::FindSoAArrType(llvm::Type *LLVMType) {
+        auto iter = LLVMTypeOwners.find(LLVMType);
+        return iter != LLVMTypeOwners.end() && iter->second->isArr ? static_cast<ArrType *>(iter->second) : nullptr;
     }
 
     std::string BuiltInType::GetTypeName() {
@@ -356,16 +1125,43 @@ namespace AST {
             case _CHAR: return "char";
             case _INT:  return "int";
             case _DOUBLE: return "double";
-            // case _FLOAT : return "float"                                                     
+            case _FLOAT: return "float";
+            case _SHORT: return "short";
+            case _LONG: return "long";
+            case _UCHAR: return "unsigned char";
+            case _USHORT: return "unsigned short";
+            case _UINT: return "unsigned int";
+            case _ULONG: return "unsigned long";
+            case _INT2: return "int2";
+            case _INT4: return "int4";
+            case _INT8: return "int8";
+            case _DOUBLE2: return "double2";
+            case _DOUBLE4: return "double4";
+            case _FLOAT4: return "float4";
+            case _FLOAT8: return "float8";
         }
     }
 
+    FuncDef::~FuncDef() {
+        for (auto param : *this->params)
+            delete param;
+        delete this->params;
+        delete this->funcBody;
+    }
+
+    /**
+     * @brief 释放函数体，只保留签名，供之后的函数调用检查实参和确定返回值的符号
+     */
+    void FuncDef::ReleaseBody() {
+        delete this->funcBody;
+        this->funcBody = nullptr;
+    }
+
     llvm::Value *FuncDef::CodeGen(CodeGenContext *context) {
-        // 如果函数已经存在，将 func 从基本块中移除
-        if (context->module->getFunction(this->funcName))
-            throw std::logic_error("Function named " + this->funcName + " has already been defined");
+        PhaseTimer timer("codegen.function", this->funcName);
 
-        std::cout << "Creating definition of function " << this->funcName << "()..." << std::endl;
+        TRACE(TraceLevel::Node, "Creating " << (this->isPrototype ? "declaration" : "definition") << " of function "
+                                << this->funcName << "()...");
 
         // 定义 llvm::Type 类型的函数形参类型列表
         std::vector<llvm::Type *> paramTypes;
@@ -381,10 +1177,39 @@ namespace AST {
         llvm::FunctionType *funcType =
                 llvm::FunctionType::get(retType, llvm::ArrayRef(paramTypes), false);
 
-        // 创建 llvm::Function 类型的函数
-        // 链接方式默认使用 ExternalLinkage
-        llvm::Function *func =
-                llvm::Function::Create(funcType, llvm::GlobalValue::ExternalLinkage, this->funcName, context->module);
+        // 同名函数已经存在时，只允许先声明后定义或重复声明，且类型必须一致，定义沿用声明创建的 llvm::Function
+        llvm::Function *func = context->module->getFunction(this->funcName);
+        if (func) {
+            AST::FuncDef *previous = context->GetFuncDef(this->funcName);
+            if (!previous || (!previous->isPrototype && !this->isPrototype))
+                throw std::logic_error("Function named " + this->funcName + " has already been defined");
+            if (func->getFunctionType() != funcType)
+                throw std::logic_error("Conflicting types for function " + this->funcName);
+        } else {
+            // 创建 llvm::Function 类型的函数
+            // 链接方式默认使用 ExternalLinkage
+            func = llvm::Function::Create(funcType, llvm::GlobalValue::ExternalLinkage, this->funcName, context->module);
+            if (this->returnType->IsUnsigned())
+                context->SetUnsigned(func);
+        }
+
+        // 函数原型只声明函数，使之后的代码可以调用在后面定义或由 C 库提供的函数；已有定义时保留定义，供编译期求值使用
+        if (this->isPrototype) {
+            if (!context->GetFuncDef(this->funcName))
+                context->AddFuncDef(this);
+            TRACE(TraceLevel::Node, "Declaration of function " << this->funcName << "() has been created\n");
+            return func;
+        }
+        // 在生成函数体之前登记，使函数体中的常量表达式可以递归调用该函数
+        context->AddFuncDef(this);
+
+        // 增量编译时，命中缓存的函数只需要声明，供其他函数调用
+        if (context->IsFuncReused(this->funcName)) {
+            if (this->funcName == "main")
+                context->SetMainFunc(func);
+            TRACE(TraceLevel::Node, "Function " << this->funcName << "() is reused from the cache\n");
+            return func;
+        }
 
         // 创建基本块
         llvm::BasicBlock *basicBlock = llvm::BasicBlock::Create(Context, this->funcName + "_entry", func);
@@ -394,6 +1219,16 @@ namespace AST {
         context->EnterFunc(func);
         context->PushBasicBlock(basicBlock);
 
+        // 开启 -g 时为函数创建 DISubprogram，函数体中的指令都以其为作用域
+        DebugInfo *debugInfo = context->GetDebugInfo();
+        if (debugInfo) {
+            std::vector<llvm::Metadata *> paramDebugTypes;
+            for (auto param : *this->params)
+                paramDebugTypes.push_back(debugInfo->GetType(param->paramType, context));
+            debugInfo->BeginFunction(func, this->location, debugInfo->GetType(this->returnType, context),
+                                     paramDebugTypes, false, context);
+        }
+
         // 同时遍历 AST::Params 列表和 llvm::Function 的函数参数列表
         auto paramIter = this->params->begin();
         auto llvmParamIter = func->arg_begin();
@@ -402,7 +1237,12 @@ namespace AST {
             llvmParamIter->setName((*paramIter)->paramName);
             // 每个 AST::Param 节点执行 CodeGen() 操作
             // 并创建存储指令
-            Builder.CreateStore(llvmParamIter, (*paramIter)->CodeGen(context));
+            llvm::Value *alloca = (*paramIter)->CodeGen(context);
+            Builder.CreateStore(llvmParamIter, alloca);
+            if (debugInfo)
+                debugInfo->DeclareLocalVar(llvm::cast<llvm::AllocaInst>(alloca), (*paramIter)->paramName,
+                                           debugInfo->GetType((*paramIter)->paramType, context),
+                                           (*paramIter)->location, llvmParamIter->getArgNo() + 1);
         }
 
         // AST::Block 类型的函数体执行 CodeGen() 操作
@@ -412,16 +1252,22 @@ namespace AST {
         if (this->funcName == "main")
             context->SetMainFunc(func);
 
+        // 函数体中的下标访问都已生成，合并检查的记录不再需要
+        context->ClearBoundsCheckHoisted();
+
+        if (debugInfo)
+            debugInfo->EndFunction();
+
         // 将基本块出栈
         context->PopBasicBlock();
         context->LeaveFunc();
 
-        std::cout << "Definition of function " << this->funcName << "() has been created\n" << std::endl;
+        TRACE(TraceLevel::Node, "Definition of function " << this->funcName << "() has been created\n");
         return func;
     }
 
     llvm::Value *Block::CodeGen(CodeGenContext *context) {
-        std::cout << "Creating block..." << std::endl;
+        TRACE(TraceLevel::Node, "Creating block...");
 
         llvm::Function *currentFunc = context->GetCurrentFunc();
 
@@ -439,20 +1285,23 @@ namespace AST {
         context->PushBasicBlock(blockBB);
 
         for (auto stmt : *this->stmts)
-            if (stmt)
+            // 与函数体相同，到达基本块的终止指令（如 return）后不再为之后的语句生成代码
+            if (Builder.GetInsertBlock()->getTerminator())
+                break;
+            else if (stmt)
                 stmt->CodeGen(context); // 为 block 中的每个语句执行 CodeGen() 操作
 
         // 将 blockBB 基本块出栈
         context->PopBasicBlock();
 
-        std::cout << "Block has be created" << std::endl;
+        TRACE(TraceLevel::Node, "Block has be created");
 
         // 该函数的返回值不会被使用，故返回空指针
         return nullptr;
     }
 
     llvm::Value *FuncBody::CodeGen(CodeGenContext *context) {
-        std::cout << "Creating function body of function " << context->GetCurrentFuncName() << "()..." << std::endl;
+        TRACE(TraceLevel::Node, "Creating function body of function " << context->GetCurrentFuncName() << "()...");
 
         for (auto stmt : *this->stmts)
             // 如果到达基本块的终止指令（如 return），则停止生成代码
@@ -479,12 +1328,14 @@ namespace AST {
     }
 
     llvm::Value *ExprStmt::CodeGen(CodeGenContext *context) {
-        std::cout << "Creating expression statement..." << std::endl;
+        TRACE(TraceLevel::Node, "Creating expression statement...");
+        DebugLocationScope debugLocation(context, this);
         return this->expr->CodeGen(context);
     }
 
     llvm::Value *IfStmt::CodeGen(CodeGenContext *context) {
-        std::cout << "Creating if statement..." << std::endl;
+        TRACE(TraceLevel::Node, "Creating if statement...");
+        DebugLocationScope debugLocation(context, this);
 
         // 获取条件表达式的结果
         // 并将条件表达式转换为 1 比特整型（布尔类型）
@@ -511,7 +1362,9 @@ namespace AST {
             this->thenStmt->CodeGen(context);
             context->PopBasicBlock();
         }
-        Builder.CreateBr(mergeBB);
+        // 分支以 return 结束时已有终止指令，不再跳转到 mergeBB
+        if (!Builder.GetInsertBlock()->getTerminator())
+            Builder.CreateBr(mergeBB);
 
         // 在 else 基本块中添加指令
         InsertFuncBasicBlockList(currentFunc, elseBB);    // 在函数的基本块列表的末尾添加 elseBB
@@ -521,20 +1374,22 @@ namespace AST {
             this->elseStmt->CodeGen(context);
             context->PopBasicBlock();
         }
-        Builder.CreateBr(mergeBB);
+        if (!Builder.GetInsertBlock()->getTerminator())
+            Builder.CreateBr(mergeBB);
 
         // 在 merge 基本块中添加指令
         InsertFuncBasicBlockList(currentFunc, mergeBB);   // 在函数的基本块列表的末尾添加 mergeBB
         Builder.SetInsertPoint(mergeBB);    // 将插入指令的位置设为 mergeBB
 
-        std::cout << "If statement has been created" << std::endl;
+        TRACE(TraceLevel::Node, "If statement has been created");
 
         // 该函数的返回值不会使用，故返回空指针
         return nullptr;
     }
 
     llvm::Value *ForStmt::CodeGen(CodeGenContext *context) {
-        std::cout << "Creating for loop statement..." << std::endl;
+        TRACE(TraceLevel::Node, "Creating for loop statement...");
+        DebugLocationScope debugLocation(context, this);
 
         // 获取当前函数
         llvm::Function *currentFunc = context->GetCurrentFunc();
@@ -560,6 +1415,9 @@ namespace AST {
             // 在 init 语句可能定义新变量，因此需要把 loopBB 基本块入栈，以包含新的变量
             context->PushBasicBlock(loopBB);
             this->init->CodeGen(context);
+            // -fbounds-check 时，循环体中以循环变量为下标的访问合并为一次区间检查，在第一次条件判断之前执行
+            if (context->IsBoundsCheckEnabled())
+                HoistLoopBoundsChecks(this, context);
         }
         else
             delete loopBB;
@@ -584,7 +1442,9 @@ namespace AST {
         context->PushBasicBlock(bodyBB);     // 将 body 基本块入栈
         this->loopStmt->CodeGen(context);
         context->PopBasicBlock();   // 将 body 基本块出栈
-        Builder.CreateBr(incrementBB);  // 无条件跳转到 incrementBB
+        // 无条件跳转到 incrementBB，循环体以 return 结束时除外
+        if (!Builder.GetInsertBlock()->getTerminator())
+            Builder.CreateBr(incrementBB);
 
         // 处理 increment 表达式
         InsertFuncBasicBlockList(currentFunc, incrementBB); // 在函数的基本块列表的末尾添加 incrementBB
@@ -601,19 +1461,313 @@ namespace AST {
         if (this->init)
             context->PopBasicBlock();
 
-        std::cout << "For loop statement has been created" << std::endl;
+        TRACE(TraceLevel::Node, "For loop statement has been created");
+
+        // 该函数的返回值不会使用，故返回空指针
+        return nullptr;
+    }
+
+    /**
+     * @brief 检查循环是否具有 for (i = lo; i < hi; i = i + 1) 的形式
+     * @param lo 返回循环变量的初值表达式
+     * @param hi 返回循环变量的上界表达式
+     * @return 循环变量的名称
+     */
+    std::string ParallelForStmt::GetLoopVarName(Expr *&lo, Expr *&hi) const {
+        auto init = dynamic_cast<ExprStmt *>(this->init);
+        auto initExpr = init ? dynamic_cast<AssignExpr *>(init->expr) : nullptr;
+        auto loopVar = initExpr ? dynamic_cast<Variable *>(initExpr->lhs) : nullptr;
+        if (!loopVar)
+            throw std::logic_error("Parallel for loop should be initialized as \"i = lo\"");
+        const std::string &varName = loopVar->varName;
+
+        auto isLoopVar = [&varName](Expr *expr) {
+            auto var = dynamic_cast<Variable *>(expr);
+            return var && var->varName == varName;
+        };
+        auto isOne = [](Expr *expr) {
+            auto integer = dynamic_cast<Integer *>(expr);
+            return integer && integer->intVal == 1;
+        };
+
+        auto condition = dynamic_cast<LessExpr *>(this->condition);
+        if (!condition || !isLoopVar(condition->lhs))
+            throw std::logic_error("Parallel for loop condition should be \"" + varName + " < hi\"");
+
+        auto increment = dynamic_cast<AssignExpr *>(this->increment);
+        auto step = increment ? dynamic_cast<AddExpr *>(increment->rhs) : nullptr;
+        if (!step || !isLoopVar(increment->lhs)
+            || !((isLoopVar(step->lhs) && isOne(step->rhs)) || (isOne(step->lhs) && isLoopVar(step->rhs))))
+            throw std::logic_error("Parallel for loop increment should be \"" + varName + " = " + varName + " + 1\"");
+
+        lo = initExpr->rhs;
+        hi = condition->rhs;
+        return varName;
+    }
+
+    llvm::Value *ParallelForStmt::CodeGen(CodeGenContext *context) {
+        TRACE(TraceLevel::Node, "Creating parallel for loop statement...");
+        DebugLocationScope debugLocation(context, this);
+
+        Expr *loExpr, *hiExpr;
+        const std::string loopVarName = GetLoopVarName(loExpr, hiExpr);
+
+        llvm::Value *loopVar = context->GetVar(loopVarName);
+        if (!loopVar)
+            throw std::logic_error("Variable \"" + loopVarName + "\" is not a variable");
+        if (IsConstVar(loopVar))
+            throw std::logic_error("Loop variable of parallel for cannot be const");
+        // 循环变量为 32 位或 64 位的整型，有符号或无符号
+        llvm::Type *loopVarType = GetPtrElementType(loopVar);
+        const bool loopVarUnsigned = context->IsUnsigned(loopVar);
+        if (!loopVarType->isIntegerTy(32) && !loopVarType->isIntegerTy(64))
+            throw std::logic_error("Loop variable of parallel for should be an int or a long");
+
+        // 归约变量只能是 int、long、float 或 double 类型，且不能是循环变量，也不能重复归约
+        std::vector<llvm::Value *> reductionVars;
+        std::vector<int32_t> reductionOps;
+        std::set<std::string> reductionNames;
+        for (const auto &reduction : *this->reductions) {
+            llvm::Value *var = context->GetVar(reduction.varName);
+            if (!var)
+                throw std::logic_error("Variable \"" + reduction.varName + "\" is not a variable");
+            if (reduction.varName == loopVarName || IsConstVar(var) || !reductionNames.insert(reduction.varName).second)
+                throw std::logic_error("Variable \"" + reduction.varName + "\" cannot be reduced");
+            llvm::Type *varType = GetPtrElementType(var);
+            const bool isUnsigned = context->IsUnsigned(var);
+            ReductionKind kind;
+            if (varType->isIntegerTy(32))
+                kind = isUnsigned ? REDUCE_UINT : REDUCE_INT;
+            else if (varType->isIntegerTy(64))
+                kind = isUnsigned ? REDUCE_ULONG : REDUCE_LONG;
+            else if (varType->isDoubleTy())
+                kind = REDUCE_DOUBLE;
+            else if (varType->isFloatTy())
+                kind = REDUCE_FLOAT;
+            else
+                throw std::logic_error("Reduction variable \"" + reduction.varName + "\" should be an int, a long, a float or a double");
+            reductionVars.push_back(var);
+            reductionOps.push_back(reduction.op * ReductionKindCount + kind);
+        }
+
+        // 除循环变量和归约变量外，当前函数中可见的变量都以地址的形式传给循环体
+        std::vector<std::pair<std::string, llvm::Value *>> captures;
+        for (const auto &var : context->GetVisibleVars()) {
+            auto inst = llvm::dyn_cast<llvm::Instruction>(var.second);
+            if (inst && inst->getFunction() == context->GetCurrentFunc()
+                && var.first != loopVarName && !reductionNames.count(var.first))
+                captures.push_back(var);
+        }
+
+        // lo 和 hi 只在循环开始前求值一次，与顺序执行时的赋值一样转换为循环变量的类型
+        llvm::Value *lo = loExpr->CodeGen(context);
+        llvm::Value *hi = hiExpr->CodeGen(context);
+        if (!lo->getType()->isIntegerTy() || !hi->getType()->isIntegerTy())
+            throw std::logic_error("Bounds of parallel for loop should be integers");
+        lo = CastToType(lo, loExpr->isUnsigned, loopVarType, loopVarUnsigned);
+        hi = CastToType(hi, hiExpr->isUnsigned, loopVarType, loopVarUnsigned);
+        // -fbounds-check 时，循环体中以循环变量为下标的访问在调用运行时库之前统一检查；
+        // 统一检查按有符号数比较区间，无符号的循环变量仍逐次检查
+        if (context->IsBoundsCheckEnabled() && !loopVarUnsigned)
+            LoopBoundsCheck(this->loopStmt, loopVarName, context).CodeGen(lo, hi, this->location, context);
+
+        llvm::Function *bodyFunc = CodeGenBody(context, loopVarName, loopVarUnsigned, captures, reductionVars);
+
+        llvm::Type *int8PtrType = llvm::Type::getInt8PtrTy(Context);
+        llvm::Type *int64Type = Builder.getInt64Ty();
+
+        // 捕获数组和归约结果数组的大小在编译期已知，在函数入口处分配，避免在循环中反复分配栈空间
+        llvm::BasicBlock *entryBB = context->GetCurrentFuncEntryBlock();
+        llvm::IRBuilder<> entryBuilder(entryBB, entryBB->begin());
+        llvm::ArrayType *capturesType = llvm::ArrayType::get(int8PtrType, captures.size());
+        llvm::AllocaInst *capturesArray = entryBuilder.CreateAlloca(capturesType, nullptr, "captures");
+        llvm::ArrayType *resultsType = llvm::ArrayType::get(int64Type, reductionVars.size());
+        llvm::AllocaInst *resultsArray = entryBuilder.CreateAlloca(resultsType, nullptr, "reductions");
+
+        for (size_t i = 0; i < captures.size(); ++i)
+            Builder.CreateStore(Builder.CreateBitCast(captures[i].second, int8PtrType),
+                                Builder.CreateConstInBoundsGEP2_32(capturesType, capturesArray, 0, i));
+
+        // 每个归约变量占 8 字节，调用前存入变量当前的值，调用后取回归约结果
+        std::vector<llvm::Value *> resultSlots;
+        for (size_t i = 0; i < reductionVars.size(); ++i) {
+            llvm::Type *varType = GetPtrElementType(reductionVars[i]);
+            resultSlots.push_back(Builder.CreateBitCast(Builder.CreateConstInBoundsGEP2_32(resultsType, resultsArray, 0, i),
+                                                        varType->getPointerTo()));
+            Builder.CreateStore(Builder.CreateLoad(varType, reductionVars[i]), resultSlots.back());
+        }
+
+        llvm::Constant *opsInit = llvm::ConstantDataArray::get(Context, llvm::ArrayRef<int32_t>(reductionOps));
+        auto opsArray = new llvm::GlobalVariable(*context->module, opsInit->getType(), true,
+                                                 llvm::GlobalValue::PrivateLinkage, opsInit, "reduction.ops");
+
+        // 运行时库以 64 位的起点和迭代次数描述迭代区间，hi <= lo 时迭代次数为 0
+        llvm::Value *isNonEmpty = loopVarUnsigned ? Builder.CreateICmpULT(lo, hi) : Builder.CreateICmpSLT(lo, hi);
+        llvm::Value *lo64 = Builder.CreateIntCast(lo, int64Type, !loopVarUnsigned);
+        llvm::Value *iterations = Builder.CreateSelect(
+                isNonEmpty, Builder.CreateSub(Builder.CreateIntCast(hi, int64Type, !loopVarUnsigned), lo64), Builder.getInt64(0));
+
+        llvm::Type *int32Type = Builder.getInt32Ty();
+        llvm::FunctionCallee parallelFor = context->module->getOrInsertFunction(
+                "cp_parallel_for", Builder.getVoidTy(), int8PtrType, int8PtrType, int64Type, int64Type, int32Type,
+                int32Type->getPointerTo(), int8PtrType);
+        Builder.CreateCall(parallelFor, { Builder.CreateBitCast(bodyFunc, int8PtrType),
+                                          Builder.CreateBitCast(capturesArray, int8PtrType), lo64, iterations,
+                                          Builder.getInt32(reductionVars.size()),
+                                          Builder.CreateConstInBoundsGEP2_32(opsInit->getType(), opsArray, 0, 0),
+                                          Builder.CreateBitCast(resultsArray, int8PtrType) });
+
+        for (size_t i = 0; i < reductionVars.size(); ++i)
+            Builder.CreateStore(Builder.CreateLoad(GetPtrElementType(reductionVars[i]), resultSlots[i]), reductionVars[i]);
+
+        // 与顺序执行一致，循环结束后循环变量的值为 max(lo, hi)
+        Builder.CreateStore(Builder.CreateSelect(isNonEmpty, hi, lo), loopVar);
+
+        TRACE(TraceLevel::Node, "Parallel for loop statement has been created");
 
         // 该函数的返回值不会使用，故返回空指针
         return nullptr;
     }
 
+    /**
+     * @brief 将循环体提取为函数 void body(i8 *captures, i64 lo, i64 hi, i8 *partials)，执行 [lo, hi) 中的迭代
+     * @param context 代码生成上下文
+     * @param loopVarName 循环变量名，在循环体函数中是局部变量
+     * @param loopVarUnsigned 循环变量是否为无符号整数
+     * @param captures 以地址形式传入循环体函数的外部变量
+     * @param reductionVars 归约变量，在循环体函数中是以 partials 中的值为初值的局部变量，返回前写回 partials
+     * @return 循环体函数
+     */
+    llvm::Function *ParallelForStmt::CodeGenBody(CodeGenContext *context, const std::string &loopVarName, bool loopVarUnsigned,
+                                                 const std::vector<std::pair<std::string, llvm::Value *>> &captures,
+                                                 const std::vector<llvm::Value *> &reductionVars) {
+        llvm::Type *int8PtrType = llvm::Type::getInt8PtrTy(Context);
+        llvm::Type *int64Type = Builder.getInt64Ty();
+        llvm::Type *loopVarType = GetPtrElementType(context->GetVar(loopVarName));
+
+        llvm::FunctionType *bodyType =
+                llvm::FunctionType::get(Builder.getVoidTy(), { int8PtrType, int64Type, int64Type, int8PtrType }, false);
+        llvm::Function *bodyFunc = llvm::Function::Create(bodyType, llvm::GlobalValue::InternalLinkage,
+                                                          context->GetCurrentFuncName() + ".parallel", context->module);
+
+        // 为循环体生成代码前保存外层函数的状态，完成后恢复
+        llvm::Function *outerFunc = context->GetCurrentFunc();
+        llvm::IRBuilderBase::InsertPoint outerInsertPoint = Builder.saveIP();
+        bool outerInParallelBody = context->IsInParallelBody();
+
+        llvm::BasicBlock *entryBB = llvm::BasicBlock::Create(Context, "parallel_entry", bodyFunc);
+        Builder.SetInsertPoint(entryBB);
+        DebugInfo *debugInfo = context->GetDebugInfo();
+        if (debugInfo)
+            debugInfo->BeginFunction(bodyFunc, this->location, nullptr, {}, true, context);
+        context->EnterFunc(bodyFunc);
+        context->SetInParallelBody(true);
+        // 循环体函数中的变量放在新压入的基本块中，遮蔽外层函数中的同名变量
+        context->PushBasicBlock(entryBB);
+
+        auto arg = bodyFunc->arg_begin();
+        llvm::Argument *capturesArg = arg++, *loArg = arg++, *hiArg = arg++, *partialsArg = arg;
+        capturesArg->setName("captures");
+        loArg->setName("lo");
+        hiArg->setName("hi");
+        partialsArg->setName("partials");
+
+        // 外部变量的地址再经过一次 getelementptr，使 GetPtrElementType() 仍能得到变量的类型
+        llvm::Value *capturesPtr = Builder.CreateBitCast(capturesArg, int8PtrType->getPointerTo());
+        for (size_t i = 0; i < captures.size(); ++i) {
+            llvm::Type *varType = GetPtrElementType(captures[i].second);
+            llvm::Value *varAddress = Builder.CreateLoad(int8PtrType, Builder.CreateConstInBoundsGEP1_32(int8PtrType, capturesPtr, i));
+            llvm::Value *varPtr = Builder.CreateInBoundsGEP(varType, Builder.CreateBitCast(varAddress, varType->getPointerTo()),
+                                                            Builder.getInt32(0), captures[i].first);
+            if (context->IsUnsigned(captures[i].second))
+                context->SetUnsigned(varPtr);
+            if (PtrType *ptrType = context->GetPtrType(captures[i].second))
+                context->SetPtrType(varPtr, ptrType);
+            context->AddLocalVar(varPtr, captures[i].first);
+        }
+
+        // 循环变量和归约变量是循环体函数的局部变量
+        llvm::AllocaInst *loopVar = Builder.CreateAlloca(loopVarType, nullptr, loopVarName);
+        context->AddLocalVar(loopVar, loopVarName);
+        if (loopVarUnsigned)
+            context->SetUnsigned(loopVar);
+        if (debugInfo) {
+            BuiltInType::TypeID typeID = loopVarType->isIntegerTy(64) ? (loopVarUnsigned ? BuiltInType::_ULONG : BuiltInType::_LONG)
+                                                                      : (loopVarUnsigned ? BuiltInType::_UINT : BuiltInType::_INT);
+            debugInfo->DeclareLocalVar(loopVar, loopVarName, debugInfo->GetType(TypeTable::GetBuiltInType(typeID), context),
+                                       this->location);
+        }
+        // 块的起点和终点按循环变量的类型截断，在循环变量的类型中比较
+        llvm::Value *hi = Builder.CreateTrunc(hiArg, loopVarType);
+        Builder.CreateStore(Builder.CreateTrunc(loArg, loopVarType), loopVar);
+
+        llvm::Value *partials = Builder.CreateBitCast(partialsArg, int64Type->getPointerTo());
+        std::vector<std::pair<llvm::AllocaInst *, llvm::Value *>> accumulators;
+        for (size_t i = 0; i < reductionVars.size(); ++i) {
+            llvm::Type *varType = GetPtrElementType(reductionVars[i]);
+            const std::string &varName = (*this->reductions)[i].varName;
+            llvm::Value *slot = Builder.CreateBitCast(Builder.CreateConstInBoundsGEP1_32(int64Type, partials, i),
+                                                      varType->getPointerTo());
+            llvm::AllocaInst *accumulator = Builder.CreateAlloca(varType, nullptr, varName);
+            Builder.CreateStore(Builder.CreateLoad(varType, slot), accumulator);
+            context->AddLocalVar(accumulator, varName);
+            accumulators.emplace_back(accumulator, slot);
+        }
+
+        llvm::BasicBlock *conditionBB = llvm::BasicBlock::Create(Context, "condition");
+        llvm::BasicBlock *bodyBB = llvm::BasicBlock::Create(Context, "body");
+        llvm::BasicBlock *incrementBB = llvm::BasicBlock::Create(Context, "increment");
+        llvm::BasicBlock *endBB = llvm::BasicBlock::Create(Context, "end");
+
+        Builder.CreateBr(conditionBB);
+        InsertFuncBasicBlockList(bodyFunc, conditionBB);
+        Builder.SetInsertPoint(conditionBB);
+        llvm::Value *loopVarValue = Builder.CreateLoad(loopVarType, loopVar);
+        Builder.CreateCondBr(loopVarUnsigned ? Builder.CreateICmpULT(loopVarValue, hi) : Builder.CreateICmpSLT(loopVarValue, hi),
+                             bodyBB, endBB);
+
+        InsertFuncBasicBlockList(bodyFunc, bodyBB);
+        Builder.SetInsertPoint(bodyBB);
+        context->PushBasicBlock(bodyBB);
+        this->loopStmt->CodeGen(context);
+        context->PopBasicBlock();
+        Builder.CreateBr(incrementBB);
+
+        InsertFuncBasicBlockList(bodyFunc, incrementBB);
+        Builder.SetInsertPoint(incrementBB);
+        Builder.CreateStore(Builder.CreateAdd(Builder.CreateLoad(loopVarType, loopVar), llvm::ConstantInt::get(loopVarType, 1)),
+                            loopVar);
+        Builder.CreateBr(conditionBB);
+
+        // 循环结束后把本块的归约结果写回 partials
+        InsertFuncBasicBlockList(bodyFunc, endBB);
+        Builder.SetInsertPoint(endBB);
+        for (const auto &accumulator : accumulators)
+            Builder.CreateStore(Builder.CreateLoad(accumulator.first->getAllocatedType(), accumulator.first),
+                                accumulator.second);
+        Builder.CreateRetVoid();
+
+        if (debugInfo)
+            debugInfo->EndFunction();
+        context->PopBasicBlock();
+        context->SetInParallelBody(outerInParallelBody);
+        context->EnterFunc(outerFunc);
+        Builder.restoreIP(outerInsertPoint);
+
+        return bodyFunc;
+    }
+
     llvm::Value *ReturnStmt::CodeGen(CodeGenContext *context) {
         llvm::Function *func = context->GetCurrentFunc();   // 获取当前函数
         // 如果当前函数为 nullptr，即 return 被用在全局，则应抛出错误
         if (!func)
             throw std::logic_error("Return statement should be used in a function body");
+        // parallel for 的循环体已被提取为单独的函数，无法从中返回外层函数
+        if (context->IsInParallelBody())
+            throw std::logic_error("Return statement cannot be used in the body of parallel for");
 
-        std::cout << "Creating return statement for function " << context->GetCurrentFuncName() << "()..." << std::endl;
+        TRACE(TraceLevel::Node, "Creating return statement for function " << context->GetCurrentFuncName() << "()...");
+        DebugLocationScope debugLocation(context, this);
 
         // 如果 this->returnVal == nullptr，说明 return 之后没有跟表达式
         if (!this->returnVal)
@@ -622,8 +1776,9 @@ namespace AST {
             else
                 throw std::logic_error("Expect an expression after \"return\"");
         else {
-            // 对返回值表达式执行 CodeGen()
-            llvm::Value *retVal = this->returnVal->CodeGen(context);
+            // 对返回值表达式执行 CodeGen()，并转换为函数的返回类型
+            llvm::Value *retVal = CastToType(this->returnVal->CodeGen(context), this->returnVal->isUnsigned,
+                                             func->getReturnType(), context->IsUnsigned(func));
             // 利用 Builder 创建函数返回指令
             Builder.CreateRet(retVal);
             // 将当前函数的返回值设为 llvm::Value 类型的 retVal
@@ -635,56 +1790,77 @@ namespace AST {
     }
 
     llvm::Value *Boolean::CodeGen(CodeGenContext *context) {
-        std::cout << "Creating boolean " << (this->boolVal ? "true" : "false") << "..." << std::endl;
+        TRACE(TraceLevel::Node, "Creating boolean " << (this->boolVal ? "true" : "false") << "...");
         // 返回 llvm::ConstantInt 类型的 1 比特整型常量（即布尔类型），默认为无符号
         return llvm::ConstantInt::get(llvm::Type::getInt1Ty(Context), this->boolVal, false);
     }
 
     llvm::Value *Character::CodeGen(CodeGenContext *context) {
-        std::cout << "Creating character \'" << this->charVal << "\'..." << std::endl;
+        TRACE(TraceLevel::Node, "Creating character \'" << this->charVal << "\'...");
         // 返回 llvm::ConstantInt 类型的 8 比特整型常量（即字符类型），默认为无符号
         return llvm::ConstantInt::get(llvm::Type::getInt8Ty(Context), this->charVal, false);
     }
 
     llvm::Value *Integer::CodeGen(CodeGenContext *context) {
-        std::cout << "Creating integer " << this->intVal << "..." << std::endl;
-        // 返回 llvm::ConstantInt 类型的 32 比特整型常量，默认为有符号
-        return llvm::ConstantInt::get(llvm::Type::getInt32Ty(Context), this->intVal, true);
+        TRACE(TraceLevel::Node, "Creating integer " << this->intVal << "...");
+        // 返回 llvm::ConstantInt 类型的 32 或 64 比特整型常量
+        llvm::Type *type = this->isLong ? llvm::Type::getInt64Ty(Context) : llvm::Type::getInt32Ty(Context);
+        return llvm::ConstantInt::get(type, this->intVal, !this->isUnsigned);
     }
 
     llvm::Value *Real::CodeGen(CodeGenContext *context){
-        std::cout << "Creating real " << this->doubleVal << "..." << std::endl;
-        // 返回 llvm::ConstantFP 类型的 实数型常量，默认为有符号
-        return llvm::ConstantFP::get(llvm::Type::getDoubleTy(Context), this->doubleVal);
+        TRACE(TraceLevel::Node, "Creating real " << this->doubleVal << "...");
+        // 返回 llvm::ConstantFP 类型的 实数型常量，带有 F 后缀时为单精度
+        llvm::Type *type = this->isFloat ? llvm::Type::getFloatTy(Context) : llvm::Type::getDoubleTy(Context);
+        return llvm::ConstantFP::get(type, this->doubleVal);
     }
 
     llvm::Value *ConstString::CodeGen(CodeGenContext *context) {
-        std::cout << "Creating constant string \"" << this->strVal << "\"..." << std::endl;
+        TRACE(TraceLevel::Node, "Creating constant string \"" << this->strVal << "\"...");
         // 利用 IRBuilder 生成全局字符串常量，并返回字符串常量的指针
         // （在 C 语言中，字符串常量代表这一字符串第一个字符的内存指针）
         return Builder.CreateGlobalStringPtr(this->strVal);
     }
 
     llvm::Value *FuncCall::CodeGen(CodeGenContext *context) {
-        std::cout << "Creating call to function " << this->funcName << "()..." << std::endl;
+        TRACE(TraceLevel::Node, "Creating call to function " << this->funcName << "()...");
+        DebugLocationScope debugLocation(context, this);
 
         // 根据调用函数名称，通过上下文获取该函数
         llvm::Function *func = context->module->getFunction(this->funcName);
 
+        // 向量内置函数对各种向量类型通用，直接展开为向量指令；用户定义的同名函数优先
+        if (func == nullptr && IsVectorBuiltin(this->funcName))
+            return CodeGenVectorBuiltin(context, this->funcName, *this->args);
+        // 内存内置函数展开为 llvm.memcpy、llvm.memset，同样让位于用户定义的同名函数
+        if (func == nullptr && IsMemoryBuiltin(this->funcName))
+            return CodeGenMemoryBuiltin(context, this->funcName, *this->args, this->location);
+
         // 如果调用的函数没有被定义，则报错
         if (func == nullptr)
             throw std::logic_error(this->funcName + " is not a function");
 
+        if (this->args->size() != func->arg_size())
+            throw std::logic_error(this->funcName + "() expects " + std::to_string(func->arg_size()) + " arguments");
+
+        // 用户函数的形参是否为无符号整型，内置函数没有无符号整型的形参
+        AST::FuncDef *funcDef = context->GetFuncDef(this->funcName);
+
         // 定义 llvm::Value 类型的函数调用实参列表
         std::vector<llvm::Value *> argList;
-        // 把 AST::Expr 节点逐个转换为 llvm::Value
-        for (auto arg: *this->args)
-            argList.push_back(arg->CodeGen(context));
+        // 把 AST::Expr 节点逐个转换为 llvm::Value，并转换为形参的类型
+        for (size_t i = 0; i < this->args->size(); ++i) {
+            Expr *arg = (*this->args)[i];
+            llvm::Value *argValue = arg->CodeGen(context);
+            bool paramUnsigned = funcDef && (*funcDef->params)[i]->paramType->IsUnsigned();
+            argList.push_back(CastToType(argValue, arg->isUnsigned, func->getArg(i)->getType(), paramUnsigned));
+        }
+        this->isUnsigned = context->IsUnsigned(func);
 
         // 创建函数调用的指令
         llvm::CallInst *call = Builder.CreateCall(func, argList);
 
-        std::cout << "Call to function " << this->funcName << "() has been created" << std::endl;
+        TRACE(TraceLevel::Node, "Call to function " << this->funcName << "() has been created");
         return call;
     }
 
@@ -692,169 +1868,239 @@ namespace AST {
         throw std::logic_error("Function call cannot be used as left-value");
     }
 
-    llvm::Value *AddExpr::CodeGen(CodeGenContext *context) {
-        std::cout << "Creating addition expression..." << std::endl;
-
-        // 对左表达式执行 CodeGen() 操作
-        llvm::Value *LHS = this->lhs->CodeGen(context);
-        // 对右表达式执行 CodeGen() 操作
-        llvm::Value *RHS = this->rhs->CodeGen(context);
-
-        std::cout << "Addition expression has been created" << std::endl;
+    llvm::Value *SubscriptExpr::CodeGen(CodeGenContext *context) {
+        TRACE(TraceLevel::Node, "Creating subscript expression...");
 
-        // 创建加法表达式指令
-        // TODO: 只实现了整型的加法
-        return Builder.CreateAdd(LHS, RHS);
+        // 先获取数组元素的地址，再从该地址取数，CodeGenPtr() 设置元素是否为无符号整数
+        llvm::Value *elementPtr = this->CodeGenPtr(context);
+        return Builder.CreateLoad(GetPtrElementType(elementPtr), elementPtr);
     }
 
-    llvm::Value *AddExpr::CodeGenPtr(CodeGenContext *context) {
-        throw std::logic_error("Addition expression cannot be used as left-value");
+    llvm::Value *SubscriptExpr::CodeGenPtr(CodeGenContext *context) {
+        StructType *soaStruct;
+        return CodeGenElementPtr(context, nullptr, soaStruct);
     }
 
-    llvm::Value *MulExpr::CodeGen(CodeGenContext *context) {
-        std::cout << "Creating multiplication expression..." << std::endl;
+    llvm::Value *SubscriptExpr::CodeGenElementPtr(CodeGenContext *context, const std::string *memberName,
+                                                  StructType *&soaStruct) {
+        soaStruct = nullptr;
+        // 获取被访问的数组（或指针）变量的地址
+        llvm::Value *arrayPtr = this->array->CodeGenPtr(context);
+        llvm::Type *arrayType = GetPtrElementType(arrayPtr);
+        // 对下标表达式执行 CodeGen() 操作
+        llvm::Value *index = this->index->CodeGen(context);
+        if (!index->getType()->isIntegerTy())
+            throw std::logic_error("Array subscript is not an integer");
+        // getelementptr 将下标视为有符号整数，无符号的下标先零扩展；long 的下标不需要扩展
+        if (this->index->isUnsigned && index->getType()->getIntegerBitWidth() < 64)
+            index = Builder.CreateZExt(index, Builder.getInt64Ty());
+        this->isUnsigned = this->array->isUnsigned;
+
+        // SoA 布局的数组：元素的各成员分别位于各成员的数组中，只能访问元素的成员
+        if (ArrType *soaType = TypeTable::FindSoAArrType(arrayType)) {
+            auto structType = static_cast<StructType *>(soaType->elementType);
+            if (!memberName)
+                throw std::logic_error("Element of the SoA array of " + structType->GetTypeName()
+                                       + " cannot be used as a whole, access its members instead");
+            const unsigned memberIndex = structType->GetMemberIndex(*memberName);
+            if (context->IsBoundsCheckEnabled() && !context->IsBoundsCheckHoisted(this))
+                CreateBoundsCheck(context, index, soaType->size, this->location);
+
+            // 第二个下标选中成员的数组，第三个下标选中其中的元素
+            soaStruct = structType;
+            llvm::Value *indices[] = { Builder.getInt32(0), Builder.getInt32(memberIndex), index };
+            return Builder.CreateInBoundsGEP(arrayType, arrayPtr, indices);
+        }
 
-        // 对左表达式执行 CodeGen() 操作
-        llvm::Value *LHS = this->lhs->CodeGen(context);
-        // 对右表达式执行 CodeGen() 操作
-        llvm::Value *RHS = this->rhs->CodeGen(context);
+        // 指针的下标访问：取出指针的值，按上下文记录的所指向的类型偏移，长度未知，不检查越界
+        if (!arrayType->isArrayTy()) {
+            PtrType *ptrType = context->GetPtrType(arrayPtr);
+            if (!ptrType)
+                throw std::logic_error("Subscripted value is not an array or a pointer");
+            TypeSpecifier *objectType = ptrType->objectType;
+            if (objectType->GetLLVMType(context)->isVoidTy())
+                throw std::logic_error("Subscripted value is a pointer to void");
+            llvm::Value *ptr = Builder.CreateLoad(arrayType, arrayPtr);
+            llvm::Value *elementPtr = Builder.CreateInBoundsGEP(objectType->GetLLVMType(context), ptr, index);
+            this->isUnsigned = objectType->IsUnsigned();
+            // 多级指针（如 argv[i][j]）的元素仍是指针，记录其类型供外层的下标访问使用
+            if (objectType->isPtr)
+                context->SetPtrType(elementPtr, static_cast<PtrType *>(objectType));
+            return elementPtr;
+        }
 
-        std::cout << "Multiplication expression has been created" << std::endl;
+        // -fbounds-check 时检查下标是否在数组的长度之内，已合并到循环开始前检查的访问除外
+        if (context->IsBoundsCheckEnabled() && !context->IsBoundsCheckHoisted(this))
+            CreateBoundsCheck(context, index, arrayType->getArrayNumElements(), this->location);
 
-        // 创建加法表达式指令
-        // TODO: 只实现了整型的加法
-        return Builder.CreateMul(LHS, RHS);
+        // 第一个下标 0 穿过指向数组的指针，第二个下标选中数组元素
+        llvm::Value *indices[] = { Builder.getInt32(0), index };
+        return Builder.CreateInBoundsGEP(arrayType, arrayPtr, indices);
     }
 
-    llvm::Value *MulExpr::CodeGenPtr(CodeGenContext *context) {
-        throw std::logic_error("Multiplication expression cannot be used as left-value");
-    }
-    llvm::Value *SubExpr::CodeGen(CodeGenContext *context) {
-        std::cout << "Creating sub expression..." << std::endl;
+    llvm::Value *MemberExpr::CodeGen(CodeGenContext *context) {
+        TRACE(TraceLevel::Node, "Creating member access ." << this->memberName << "...");
+
+        // 函数返回的结构体没有地址，直接从返回值中取出成员
+        if (dynamic_cast<FuncCall *>(this->object)) {
+            llvm::Value *object = this->object->CodeGen(context);
+            StructType *structType = TypeTable::FindStructType(object->getType());
+            if (!structType)
+                throw std::logic_error("Member reference base is not a struct");
+            const unsigned memberIndex = structType->GetMemberIndex(this->memberName);
+            this->isUnsigned = structType->members[memberIndex].type->IsUnsigned();
+            return Builder.CreateExtractValue(object, memberIndex);
+        }
 
-        // 对左表达式执行 CodeGen() 操作
-        llvm::Value *LHS = this->lhs->CodeGen(context);
-        // 对右表达式执行 CodeGen() 操作
-        llvm::Value *RHS = this->rhs->CodeGen(context);
+        // 先获取成员的地址，再从该地址取数，CodeGenPtr() 设置成员是否为无符号整数
+        llvm::Value *memberPtr = this->CodeGenPtr(context);
+        return Builder.CreateLoad(GetPtrElementType(memberPtr), memberPtr);
+    }
 
-        std::cout << "sub expression has been created" << std::endl;
+    llvm::Value *MemberExpr::CodeGenPtr(CodeGenContext *context) {
+        // SoA 数组的元素没有自身的地址，由下标访问直接得到成员的地址
+        StructType *structType = nullptr;
+        llvm::Value *objectPtr;
+        if (auto subscript = dynamic_cast<SubscriptExpr *>(this->object))
+            objectPtr = subscript->CodeGenElementPtr(context, &this->memberName, structType);
+        else
+            objectPtr = this->object->CodeGenPtr(context);
+
+        llvm::Value *memberPtr = objectPtr;
+        if (!structType) {
+            llvm::Type *objectType = GetPtrElementType(objectPtr);
+            structType = TypeTable::FindStructType(objectType);
+            if (!structType)
+                throw std::logic_error("Member reference base is not a struct");
+            memberPtr = Builder.CreateStructGEP(objectType, objectPtr, structType->GetMemberIndex(this->memberName));
+        }
 
-        // 创建加法表达式指令
-        // TODO: 只实现了整型的加法
-        return Builder.CreateSub(LHS, RHS);
+        // 成员是指针时记录其类型，供之后的下标访问使用
+        TypeSpecifier *memberType = structType->members[structType->GetMemberIndex(this->memberName)].type;
+        this->isUnsigned = memberType->IsUnsigned();
+        if (memberType->isPtr)
+            context->SetPtrType(memberPtr, static_cast<PtrType *>(memberType));
+        return memberPtr;
     }
 
-    llvm::Value *SubExpr::CodeGenPtr(CodeGenContext *context) {
-        throw std::logic_error("Sub expression cannot be used as left-value");
+    BinaryExpr::~BinaryExpr() {
+        // 沿左操作数的链逐个释放，每个节点析构时左操作数已被摘下
+        std::vector<BinaryExpr *> chain;
+        delete GetLeftChain(this->lhs, chain);
+        for (auto binary : chain) {
+            binary->lhs = nullptr;
+            delete binary;
+        }
+        delete this->rhs;
     }
-    llvm::Value *DivExpr::CodeGen(CodeGenContext *context) {
-        std::cout << "Creating div expression..." << std::endl;
 
-        // 对左表达式执行 CodeGen() 操作
-        llvm::Value *LHS = this->lhs->CodeGen(context);
-        // 对右表达式执行 CodeGen() 操作
-        llvm::Value *RHS = this->rhs->CodeGen(context);
-
-        std::cout << "Div expression has been created" << std::endl;
-
-        // 创建加法表达式指令
-        // TODO: 只实现了整型的加法
-        return Builder.CreateSDiv(LHS, RHS);
+    Expr *BinaryExpr::GetLeftChain(Expr *expr, std::vector<BinaryExpr *> &chain) {
+        while (auto binary = dynamic_cast<BinaryExpr *>(expr)) {
+            chain.push_back(binary);
+            expr = binary->lhs;
+        }
+        return expr;
     }
 
-    llvm::Value *DivExpr::CodeGenPtr(CodeGenContext *context) {
-        throw std::logic_error("Div expression cannot be used as left-value");
+    /**
+     * @brief 二元运算在跟踪信息中的名称
+     */
+    static const char *GetBinaryOpName(BinaryOp op) {
+        switch (op) {
+            case BinaryOp::ADD: return "addition";
+            case BinaryOp::SUB: return "sub";
+            case BinaryOp::MUL: return "multiplication";
+            case BinaryOp::DIV: return "div";
+            case BinaryOp::MOD: return "mod";
+            case BinaryOp::EQ: return "logical equality";
+            case BinaryOp::NEQ: return "logical inequality";
+            case BinaryOp::GREAT: return "logical greater";
+            case BinaryOp::LESS: return "logical less";
+        }
+        return "binary";
     }
 
-    llvm::Value *EqExpr::CodeGen(CodeGenContext *context) {
-        std::cout << "Creating logical equality expression..." << std::endl;
+    llvm::Value *BinaryExpr::CodeGen(CodeGenContext *context) {
+        // 先沿左操作数收集整条链，再从最内层开始逐个生成：左操作数总在右操作数之前求值，与递归生成的顺序相同
+        std::vector<BinaryExpr *> chain;
+        llvm::Value *LHS = GetLeftChain(this, chain)->CodeGen(context);
+        for (auto iter = chain.rbegin(); iter != chain.rend(); ++iter) {
+            BinaryExpr *binary = *iter;
+            TRACE(TraceLevel::Node, "Creating " << GetBinaryOpName(binary->op) << " expression...");
 
-        // 对左表达式执行 CodeGen() 操作
-        llvm::Value *LHS = this->lhs->CodeGen(context);
-        // 对右表达式执行 CodeGen() 操作
-        llvm::Value *RHS = this->rhs->CodeGen(context);
+            // 对右表达式执行 CodeGen() 操作
+            llvm::Value *RHS = binary->rhs->CodeGen(context);
+
+            // 操作数先经过寻常算术转换，整型与浮点型、有符号与无符号整数使用不同的指令
+            LHS = CreateBinaryOp(binary->op, LHS, binary->lhs->isUnsigned, RHS, binary->rhs->isUnsigned, binary->isUnsigned);
 
-        std::cout << "Logical equality expression has been created" << std::endl;
+            TRACE(TraceLevel::Node, GetBinaryOpName(binary->op) << " expression has been created");
+        }
+        return LHS;
+    }
 
-        // 创建逻辑等于表达式指令
-        // TODO: 只实现了整型的逻辑等于
-        return Builder.CreateICmpEQ(LHS, RHS);
+    llvm::Value *AddExpr::CodeGenPtr(CodeGenContext *context) {
+        throw std::logic_error("Addition expression cannot be used as left-value");
     }
 
-    llvm::Value *EqExpr::CodeGenPtr(CodeGenContext *context) {
-        throw std::logic_error("Logical equality expression cannot be used as left-value");
+    llvm::Value *MulExpr::CodeGenPtr(CodeGenContext *context) {
+        throw std::logic_error("Multiplication expression cannot be used as left-value");
     }
 
-    llvm::Value *NeqExpr::CodeGen(CodeGenContext *context) {
-        std::cout << "Creating logical inequality expression..." << std::endl;
+    llvm::Value *SubExpr::CodeGenPtr(CodeGenContext *context) {
+        throw std::logic_error("Sub expression cannot be used as left-value");
+    }
 
-        // 对左表达式执行 CodeGen() 操作
-        llvm::Value *LHS = this->lhs->CodeGen(context);
-        // 对右表达式执行 CodeGen() 操作
-        llvm::Value *RHS = this->rhs->CodeGen(context);
+    llvm::Value *DivExpr::CodeGenPtr(CodeGenContext *context) {
+        throw std::logic_error("Div expression cannot be used as left-value");
+    }
 
-        std::cout << "Logical inequality expression has been created" << std::endl;
+    llvm::Value *ModExpr::CodeGenPtr(CodeGenContext *context) {
+        throw std::logic_error("Mod expression cannot be used as left-value");
+    }
 
-        // 创建逻辑等于表达式指令
-        // TODO: 只实现了整型的逻辑等于
-        return Builder.CreateICmpNE(LHS, RHS);
+    llvm::Value *EqExpr::CodeGenPtr(CodeGenContext *context) {
+        throw std::logic_error("Logical equality expression cannot be used as left-value");
     }
 
     llvm::Value *NeqExpr::CodeGenPtr(CodeGenContext *context) {
         throw std::logic_error("Logical inequality expression cannot be used as left-value");
     }
 
-    llvm::Value *GreatExpr::CodeGen(CodeGenContext *context) {
-        std::cout << "Creating logical greater expression..." << std::endl;
-
-        // 对左表达式执行 CodeGen() 操作
-        llvm::Value *LHS = this->lhs->CodeGen(context);
-        // 对右表达式执行 CodeGen() 操作
-        llvm::Value *RHS = this->rhs->CodeGen(context);
-
-        std::cout << "Logical Greter expression has been created" << std::endl;
-
-        // 创建逻辑等于表达式指令
-        // TODO: 只实现了整型的逻辑大于
-        return Builder.CreateICmpSGT(LHS, RHS);
-    }
-
     llvm::Value *GreatExpr::CodeGenPtr(CodeGenContext *context) {
         throw std::logic_error("Logical Greater expression cannot be used as left-value");
     }
 
-    llvm::Value *LessExpr::CodeGen(CodeGenContext *context) {
-        std::cout << "Creating logical less expression..." << std::endl;
-
-        // 对左表达式执行 CodeGen() 操作
-        llvm::Value *LHS = this->lhs->CodeGen(context);
-        // 对右表达式执行 CodeGen() 操作
-        llvm::Value *RHS = this->rhs->CodeGen(context);
-
-        std::cout << "Logical less expression has been created" << std::endl;
-
-        // 创建逻辑等于表达式指令
-        // TODO: 只实现了整型的逻辑小于
-        return Builder.CreateICmpSLT(LHS, RHS);
-    }
-
     llvm::Value *LessExpr::CodeGenPtr(CodeGenContext *context) {
         throw std::logic_error("Logical less expression cannot be used as left-value");
     }
 
     llvm::Value *AssignExpr::CodeGen(CodeGenContext *context) {
-        std::cout << "Creating assignment expression..." << std::endl;
+        TRACE(TraceLevel::Node, "Creating assignment expression...");
+        DebugLocationScope debugLocation(context, this);
 
         // 对左表达式获取指针
         llvm::Value *ptrLHS = this->lhs->CodeGenPtr(context);
+        if (IsConstVar(ptrLHS->stripInBoundsOffsets()))
+            throw std::logic_error("Cannot assign to a const variable");
+        llvm::Type *LHSType = GetPtrElementType(ptrLHS);
+
+        // 数组的整体赋值展开为 memcpy，不把整个数组作为一个值取数和存数；数组没有值，表达式的结果是左侧数组的地址
+        if (GetArrayLength(LHSType)) {
+            llvm::Value *ptrRHS = this->rhs->CodeGenPtr(context);
+            if (GetPtrElementType(ptrRHS) != LHSType)
+                throw std::logic_error("Cannot assign arrays of different types");
+            CreateObjectCopy(context, ptrLHS, ptrRHS, LHSType);
+            return ptrLHS;
+        }
+
         // 对右表达式执行 CodeGen() 操作
         llvm::Value *RHS = this->rhs->CodeGen(context);
 
-        // TODO: 缺少赋值时的类型转换
-        // 创建 Store 指令，把右表达式的值存入左表达式对应的地址
-        Builder.CreateStore(RHS, ptrLHS);
+        // 创建 Store 指令，把右表达式的值转换为左表达式的类型后存入左表达式对应的地址
+        this->isUnsigned = this->lhs->isUnsigned;
+        Builder.CreateStore(CastToType(RHS, this->rhs->isUnsigned, LHSType, this->isUnsigned), ptrLHS);
         // 创建 Load 指令，以左表达式的值作为返回值
-        llvm::Type *LHSType = GetPtrElementType(ptrLHS);
         return Builder.CreateLoad(LHSType, ptrLHS);
     }
 
@@ -862,27 +2108,59 @@ namespace AST {
         throw std::logic_error("Assignment expression cannot be used as left-value");
     }
 
+    llvm::Value *VectorExpr::CodeGen(CodeGenContext *context) {
+        TRACE(TraceLevel::Node, "Creating vector " << this->vectorType->GetTypeName() << "...");
+
+        auto LLVMType = llvm::cast<llvm::FixedVectorType>(this->vectorType->GetLLVMType(context));
+        llvm::Type *elementType = LLVMType->getElementType();
+        const unsigned lanes = LLVMType->getNumElements();
+
+        // 只有一个实参时，将其扩展到每个元素
+        if (this->args->size() == 1)
+            return Builder.CreateVectorSplat(lanes, CastToElementType((*this->args)[0]->CodeGen(context), elementType));
+        if (this->args->size() != lanes)
+            throw std::logic_error(this->vectorType->GetTypeName() + " expects 1 or " + std::to_string(lanes) + " elements");
+
+        // 从 undef 向量开始逐个插入元素，元素都是常量时 Builder 会将其折叠为向量常量
+        llvm::Value *vector = llvm::UndefValue::get(LLVMType);
+        for (unsigned i = 0; i < lanes; ++i)
+            vector = Builder.CreateInsertElement(vector, CastToElementType((*this->args)[i]->CodeGen(context), elementType),
+                                                 Builder.getInt32(i));
+        return vector;
+    }
+
+    llvm::Value *VectorExpr::CodeGenPtr(CodeGenContext *context) {
+        throw std::logic_error("Vector expression cannot be used as left-value");
+    }
+
     llvm::Value *Variable::CodeGen(CodeGenContext *context) {
-        std::cout << "Creating reference to variable " << this->varName << "..." << std::endl;
+        TRACE(TraceLevel::Node, "Creating reference to variable " << this->varName << "...");
 
         // 处理变量未定义的错误
         if (!context->IsVarDefined(this->varName))
             throw std::logic_error("Variable \"" + this-> varName+ "\" is not a variable");
 
-        // 创建一个取数指令
+        // const 变量的值在编译期已知，直接使用其初始值
         llvm::Value *varPtr = context->GetVar(this->varName);
+        this->isUnsigned = context->IsUnsigned(varPtr);
+        if (IsConstVar(varPtr))
+            return llvm::cast<llvm::GlobalVariable>(varPtr)->getInitializer();
+
+        // 创建一个取数指令
         llvm::Type *varType = GetPtrElementType(varPtr);
         return Builder.CreateLoad(varType, varPtr, this->varName);
     }
 
     llvm::Value *Variable::CodeGenPtr(CodeGenContext *context) {
-        std::cout << "Creating reference to variable " << this->varName << "..." << std::endl;
+        TRACE(TraceLevel::Node, "Creating reference to variable " << this->varName << "...");
 
         // 处理变量未定义的错误
         if (!context->IsVarDefined(this->varName))
             throw std::logic_error("Variable \"" + this-> varName+ "\" is not a variable");
 
-        return context->GetVar(this->varName);
+        llvm::Value *varPtr = context->GetVar(this->varName);
+        this->isUnsigned = context->IsUnsigned(varPtr);
+        return varPtr;
     }
 
     llvm::Value *Constant::CodeGenPtr(CodeGenContext *context) {
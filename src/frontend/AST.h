@@ -47,13 +47,16 @@
 #include <llvm/Target/TargetMachine.h>
 #include <llvm/Target/TargetOptions.h>
 
-#if LLVM_VERSION_MAJOR >= 16
+#if LLVM_VERSION_MAJOR >= 14
 #include <llvm/MC/TargetRegistry.h>
 #endif
 
 
 class CodeGenContext;
 
+/* 二元运算的种类 */
+enum class BinaryOp { ADD, SUB, MUL, DIV, MOD, EQ, NEQ, GREAT, LESS };
+
 /* AST 节点的类声明 */
 
 namespace AST {
@@ -73,11 +76,14 @@ namespace AST {
         class VarDef;
             class VarInit;
             using VarInitList = std::vector<VarInit *>;
+        class StructDef;
 
     class TypeSpecifier;
         class BuiltInType;
         class ArrType;
         class PtrType;
+        class StructType;
+        class TypeTable;
 
     class Stmt;
     using Stmts = std::vector<Stmt *>;
@@ -85,6 +91,9 @@ namespace AST {
         class ExprStmt;
         class IfStmt;
         class ForStmt;
+            class ParallelForStmt;
+            struct Reduction;
+            using Reductions = std::vector<Reduction>;
         class ReturnStmt;
         class EmptyStmt;
 
@@ -92,16 +101,20 @@ namespace AST {
         class FuncCall;
             using Args = std::vector<Expr *>;
         class SubscriptExpr;
-        class AddExpr;
-        class MulExpr;
-        class DivExpr;
-        class SubExpr;
-        class EqExpr;
-        class NeqExpr;
-        class GreatExpr;
-        class LessExpr;
+        class MemberExpr;
+        class BinaryExpr;
+            class AddExpr;
+            class MulExpr;
+            class DivExpr;
+            class ModExpr;
+            class SubExpr;
+            class EqExpr;
+            class NeqExpr;
+            class GreatExpr;
+            class LessExpr;
         class AssignExpr;
         class CommaExpr;
+        class VectorExpr;
         class Variable;
         class Constant;
             class Boolean;
@@ -109,14 +122,28 @@ namespace AST {
             class Integer;
             class ConstString;
             class Real;
+
+    // 声明符从变量名向外的各层，数组为长度的表达式，指针为空指针，如 *a[10] 为 { 10, nullptr }
+    using Declarator = std::vector<Expr *>;
 }
 
 /* AST 节点的类定义 */
 
 namespace AST {
 
+    /* 节点在源代码中的位置，行号和列号从 1 开始，为 0 时表示未知 */
+    struct SourceLocation {
+        int line = 0;
+        int column = 0;
+    };
+
+    // 语法分析器正在归约的产生式的起始位置，节点创建时以其作为自身的位置
+    extern SourceLocation CurrentLocation;
+
     class Node {
     public:
+        SourceLocation location = CurrentLocation;  // 节点在源代码中的起始位置，用于生成调试信息
+
         Node() = default;
 
         virtual ~Node() = default;
@@ -163,12 +190,27 @@ namespace AST {
         TypeSpecifier *returnType;  // 函数返回类型
         std::string funcName;       // 函数名称
         Params *params;             // 函数形参列表
-        Block *funcBody;            // 函数体
+        Block *funcBody;            // 函数体，函数原型没有函数体，流式编译时生成代码后被释放
+        bool isPrototype;           // 是否为函数原型（只有声明，没有函数体）
+        size_t sourceBegin = 0;     // 函数定义在源代码中的起始字节偏移
+        size_t signatureEnd = 0;    // 函数签名（返回类型、函数名和形参列表）的结束字节偏移
+        size_t sourceEnd = 0;       // 函数定义的结束字节偏移
+        std::vector<std::string> callees;   // 函数体中调用的函数名称，按名称排序且不重复
+        std::vector<std::string> constCallees;  // 其中在编译期求值的表达式（const 变量的初始值、数组长度）调用的函数名称
 
         FuncDef(TypeSpecifier *returnType, std::string funcName, Params *params, Block *funcBody) :
-            returnType(returnType), funcName(std::move(funcName)), params(params), funcBody(funcBody) {}
+            returnType(returnType), funcName(std::move(funcName)), params(params), funcBody(funcBody),
+            isPrototype(funcBody == nullptr) {}
+
+        ~FuncDef();
 
-        ~FuncDef() = default;
+        void ReleaseBody();
+
+        void SetSourceRange(size_t begin, size_t signatureEnd, size_t end) {
+            this->sourceBegin = begin;
+            this->signatureEnd = signatureEnd;
+            this->sourceEnd = end;
+        }
 
         llvm::Value *CodeGen(CodeGenContext *context);
     };
@@ -177,12 +219,18 @@ namespace AST {
     public:
         TypeSpecifier *typeSpecifier;   // 变量类型
         VarInitList *varInitList;       // 变量初始化列表
+        bool isConst = false;           // 是否为 const 变量，const 变量的初始值在编译期求值
 
         VarDef(TypeSpecifier *typeSpecifier, VarInitList *varInitList) : typeSpecifier(typeSpecifier), varInitList(varInitList) {}
 
-        ~VarDef() = default;
+        ~VarDef();
 
         llvm::Value *CodeGen(CodeGenContext *context);
+
+    private:
+        void CodeGenGlobal(CodeGenContext *context, llvm::Type *LLVMBaseType);
+
+        void CodeGenConstLocal(CodeGenContext *context, llvm::Type *LLVMBaseType);
     };
 
     class VarInit : public Node {
@@ -193,14 +241,24 @@ namespace AST {
 
         VarInit(std::string varName, Expr *initExpr = nullptr) : varName(std::move(varName)), initExpr(initExpr), complexType(nullptr) {}
 
-        VarInit(std::string varName, TypeSpecifier *complexType, TypeSpecifier *baseType, Expr *initExpr = nullptr);
+        VarInit(std::string varName, const Declarator &declarator, TypeSpecifier *baseType, Expr *initExpr = nullptr);
 
-        ~VarInit() = default;
+        ~VarInit();
 
         llvm::Value *CodeGen(CodeGenContext *context);
+    };
 
-    private:
-        TypeSpecifier *ReverseComplexType();
+    /* 结构体定义 struct Name { 成员 };，只能出现在函数之外，成员在解析时记录到类型表中的结构体类型 */
+    class StructDef : public Def {
+    public:
+        StructType *structType;     // 定义的结构体类型
+
+        StructDef(StructType *structType) : structType(structType) {}
+
+        // 结构体类型由类型表共享，不随节点释放
+        ~StructDef() = default;
+
+        llvm::Value *CodeGen(CodeGenContext *context);
     };
 
     class TypeSpecifier : public Node {
@@ -208,12 +266,16 @@ namespace AST {
         llvm::Type *LLVMType;       // 类型对应的 LLVM 类型
         bool isArr = false;
         bool isPtr = false;
+        bool isStruct = false;
 
         TypeSpecifier() : LLVMType(nullptr) {}
 
         virtual llvm::Type *GetLLVMType(CodeGenContext *context) = 0;
 
         virtual std::string GetTypeName() = 0;
+
+        // 是否为无符号整型，数组取其元素类型；LLVM 的整型不区分符号，符号由类型说明符决定
+        virtual bool IsUnsigned() const { return false; }
     };
 
     class BuiltInType : public TypeSpecifier {
@@ -223,7 +285,23 @@ namespace AST {
             _BOOL,
             _CHAR,
             _INT,
-            _DOUBLE
+            _DOUBLE,
+            _FLOAT,
+            _SHORT,
+            _LONG,
+            // 无符号整型，与对应的有符号整型使用相同的 LLVM 类型
+            _UCHAR,
+            _USHORT,
+            _UINT,
+            _ULONG,
+            // 定长向量类型，映射为 llvm::FixedVectorType
+            _INT2,
+            _INT4,
+            _INT8,
+            _DOUBLE2,
+            _DOUBLE4,
+            _FLOAT4,
+            _FLOAT8
         };
         TypeID type;    // 内置类型的编号
 
@@ -235,16 +313,18 @@ namespace AST {
 
         std::string GetTypeName();
 
+        bool IsUnsigned() const { return this->type >= _UCHAR && this->type <= _ULONG; }
+
         llvm::Value *CodeGen(CodeGenContext *context) { return nullptr; }
     };
 
     class ArrType : public TypeSpecifier {
     public:
         TypeSpecifier *elementType = nullptr;
-        size_t size;
-        TypeSpecifier *_fatherType;
+        Expr *sizeExpr;     // 数组长度的表达式，在编译期求值
+        size_t size = 0;    // 数组长度，首次获取 LLVM 类型时求得
 
-        ArrType(TypeSpecifier *_fatherType, const size_t size) : _fatherType(_fatherType), size(size) { this->isArr = true; }
+        ArrType(TypeSpecifier *elementType, Expr *sizeExpr) : elementType(elementType), sizeExpr(sizeExpr) { this->isArr = true; }
 
         ~ArrType() = default;
 
@@ -254,14 +334,18 @@ namespace AST {
         llvm::Type *GetLLVMType(CodeGenContext *context);
 
         std::string GetTypeName() { return "array"; }
+
+        bool IsUnsigned() const { return this->elementType->IsUnsigned(); }
+
+        // 元素是否为 soa struct，此时数组按 SoA 布局存放
+        bool IsSoA() const;
     };
 
     class PtrType : public TypeSpecifier {
     public:
         TypeSpecifier *objectType = nullptr;
-        TypeSpecifier *_fatherType;
 
-        PtrType(TypeSpecifier *_fatherType) : _fatherType(_fatherType) { this->isPtr = true; }
+        PtrType(TypeSpecifier *objectType) : objectType(objectType) { this->isPtr = true; }
 
         ~PtrType() = default;
 
@@ -273,13 +357,85 @@ namespace AST {
         std::string GetTypeName() { return "pointer"; }
     };
 
+    /*
+     * 结构体类型 struct Name，按名称唯一化，成员在解析到结构体定义时设置
+     *
+     * 以 soa struct 定义的结构体，其数组按 SoA（structure of arrays）布局存放：每个成员各自存放为一个连续的数组，
+     * a[i].x 访问成员 x 的数组的第 i 个元素，只访问少数成员的循环成为单位步长的访存，便于向量化。
+     * 单个结构体变量、结构体的成员以及指针所指的结构体仍按普通布局存放。
+     */
+    class StructType : public TypeSpecifier {
+    public:
+        struct Member {
+            TypeSpecifier *type;    // 成员类型
+            std::string name;       // 成员名称
+        };
+        using Members = std::vector<Member>;
+
+        std::string name;           // 结构体名
+        Members members;            // 成员列表
+        bool isDefined = false;     // 是否已经解析到结构体定义
+        bool isSoA = false;         // 数组是否按 SoA 布局存放
+
+        StructType(std::string name) : name(std::move(name)) { this->isStruct = true; }
+
+        ~StructType() = default;
+
+        llvm::Value *CodeGen(CodeGenContext *context) { return nullptr; }
+
+        llvm::Type *GetLLVMType(CodeGenContext *context);
+
+        // LLVM 的具名结构体类型，结构体尚未定义或成员尚未求得类型时为不透明类型，可以作为指针所指的类型
+        llvm::StructType *GetDeclaredLLVMType();
+
+        std::string GetTypeName() { return "struct " + this->name; }
+
+        // 成员的序号，没有该成员时抛出异常
+        unsigned GetMemberIndex(const std::string &memberName) const;
+
+    private:
+        llvm::StructType *declaredType = nullptr;   // 具名的 LLVM 结构体类型，GetLLVMType() 为其设置成员
+        bool isLayingOut = false;   // 是否正在求成员的类型，用于发现包含自身的结构体
+    };
+
+    /*
+     * 类型表：结构相同的类型只创建一个 TypeSpecifier 节点，由各 AST 节点共享，其 LLVM 类型也只求一次
+     *
+     * 数组长度为整数字面量时按 (元素类型, 长度) 唯一化；长度为其他常量表达式时要到代码生成时才能求值，每次创建新的节点。
+     */
+    class TypeTable {
+    public:
+        static BuiltInType *GetBuiltInType(BuiltInType::TypeID type);
+
+        static PtrType *GetPtrType(TypeSpecifier *objectType);
+
+        static ArrType *GetArrType(TypeSpecifier *elementType, Expr *sizeExpr);
+
+        static TypeSpecifier *GetDeclaredType(TypeSpecifier *baseType, const Declarator &declarator);
+
+        static StructType *GetStructType(const std::string &name);
+
+        static llvm::StructType *GetSoALLVMType(ArrType *arrType, CodeGenContext *context);
+
+        // 由 LLVM 类型找回结构体类型和 SoA 布局的数组类型，它们在首次创建 LLVM 类型时登记
+        static void RegisterLLVMType(llvm::Type *LLVMType, TypeSpecifier *type);
+
+        static StructType *FindStructType(llvm::Type *LLVMType);
+
+        static ArrType *FindSoAArrType(llvm::Type *LLVMType);
+    };
+
     class Block : public Stmt {
     public:
         Stmts* stmts;   // 代码块内的语句列表
 
         Block(Stmts *stmts) : stmts(stmts) {}
 
-        ~Block() = default;
+        ~Block() {
+            for (auto stmt : *this->stmts)
+                delete stmt;
+            delete this->stmts;
+        }
 
         virtual llvm::Value *CodeGen(CodeGenContext *context);
     };
@@ -295,6 +451,8 @@ namespace AST {
 
     class Expr : public Node {
     public:
+        bool isUnsigned = false;    // CodeGen() 得到的值是否为无符号整数，在 CodeGen() 中设置
+
         Expr() = default;
 
         virtual ~Expr() = default;
@@ -311,7 +469,7 @@ namespace AST {
 
         ExprStmt(Expr *expr) : expr(expr) {}
 
-        ~ExprStmt() = default;
+        ~ExprStmt() { delete this->expr; }
 
         llvm::Value *CodeGen(CodeGenContext *context);
     };
@@ -324,7 +482,11 @@ namespace AST {
 
         IfStmt(Expr *condition, Stmt *thenStmt, Stmt *elseStmt = nullptr) : condition(condition), thenStmt(thenStmt), elseStmt(elseStmt) {}
 
-        ~IfStmt() = default;
+        ~IfStmt() {
+            delete this->condition;
+            delete this->thenStmt;
+            delete this->elseStmt;
+        }
 
         llvm::Value *CodeGen(CodeGenContext *context);
     };
@@ -338,18 +500,56 @@ namespace AST {
 
         ForStmt(Stmt *init, Expr *condition, Expr *increment, Stmt *loopStmt) : init(init), condition(condition), increment(increment), loopStmt(loopStmt) {}
 
-        ~ForStmt() = default;
+        ~ForStmt() {
+            delete this->init;
+            delete this->condition;
+            delete this->increment;
+            delete this->loopStmt;
+        }
 
         llvm::Value *CodeGen(CodeGenContext *context);
     };
 
+    /* parallel for 的归约子句 reduction(op: varName) */
+    struct Reduction {
+        enum Op { ADD, MUL, MIN, MAX };
+
+        Op op;                  // 归约运算
+        std::string varName;    // 归约变量
+    };
+
+    /*
+     * parallel for 语句，循环必须具有 for (i = lo; i < hi; i = i + 1) 的形式，lo 和 hi 在循环开始前各求值一次
+     *
+     * 循环体被提取为单独的函数，由运行时库的线程池按迭代区间分块并行执行。循环体中对外部变量的访问都经过其地址，
+     * 除归约变量外，不同迭代写同一个变量属于数据竞争；归约变量在每个块中有独立的副本，循环结束后合并。
+     */
+    class ParallelForStmt : public ForStmt {
+    public:
+        Reductions *reductions; // 归约子句列表
+
+        ParallelForStmt(Stmt *init, Expr *condition, Expr *increment, Reductions *reductions, Stmt *loopStmt)
+                : ForStmt(init, condition, increment, loopStmt), reductions(reductions) {}
+
+        ~ParallelForStmt() { delete this->reductions; }
+
+        llvm::Value *CodeGen(CodeGenContext *context);
+
+    private:
+        std::string GetLoopVarName(Expr *&lo, Expr *&hi) const;
+
+        llvm::Function *CodeGenBody(CodeGenContext *context, const std::string &loopVarName, bool loopVarUnsigned,
+                                    const std::vector<std::pair<std::string, llvm::Value *>> &captures,
+                                    const std::vector<llvm::Value *> &reductionVars);
+    };
+
     class ReturnStmt : public Stmt {
     public:
         Expr *returnVal;    // 返回表达式
 
         ReturnStmt(Expr *returnVal = nullptr) : returnVal(returnVal) {}
 
-        ~ReturnStmt() = default;
+        ~ReturnStmt() { delete this->returnVal; }
 
         llvm::Value *CodeGen(CodeGenContext *context);
     };
@@ -370,145 +570,167 @@ namespace AST {
 
         FuncCall(std::string funcName, Args *args) : funcName(std::move(funcName)), args(args) {}
 
-        ~FuncCall() = default;
+        ~FuncCall() {
+            for (auto arg : *this->args)
+                delete arg;
+            delete this->args;
+        }
 
         llvm::Value *CodeGen(CodeGenContext *context);
 
         llvm::Value *CodeGenPtr(CodeGenContext *context);
     };
 
-//    class SubscriptExpr : public Expr {
-//    public:
-//        Expr *array;
-//        Expr *index;
-//
-//        SubscriptExpr(Expr *array, Expr *index) : array(array), index(index) {}
-//
-//        ~SubscriptExpr() = default;
-//
-//
-//    };
-
-    class AddExpr : public Expr {
+    class SubscriptExpr : public Expr {
     public:
-        Expr *lhs;  // 加法表达式的左侧表达式
-        Expr *rhs;  // 加法表达式的右侧表达式
+        Expr *array;    // 被下标访问的数组或指针表达式
+        Expr *index;    // 下标表达式
 
-        AddExpr(Expr *lhs, Expr *rhs) : lhs(lhs), rhs(rhs) {}
+        SubscriptExpr(Expr *array, Expr *index) : array(array), index(index) {}
 
-        ~AddExpr() = default;
+        ~SubscriptExpr() { delete this->array; delete this->index; }
 
         llvm::Value *CodeGen(CodeGenContext *context);
 
         llvm::Value *CodeGenPtr(CodeGenContext *context);
+
+        /**
+         * @brief 获取数组元素的地址；SoA 布局的数组元素不是连续存放的，此时直接获取元素中 memberName 成员的地址
+         * @param memberName 之后访问的成员名，为空指针时需要整个元素
+         * @param soaStruct 选中了 SoA 数组元素的成员时返回元素的结构体类型，否则为空指针
+         */
+        llvm::Value *CodeGenElementPtr(CodeGenContext *context, const std::string *memberName, StructType *&soaStruct);
     };
 
-    class MulExpr : public Expr {
+    /* 成员访问表达式 object.memberName */
+    class MemberExpr : public Expr {
     public:
-        Expr *lhs;  // 乘法表达式的左侧表达式
-        Expr *rhs;  // 乘法表达式的右侧表达式
+        Expr *object;           // 结构体表达式
+        std::string memberName; // 成员名称
 
-        MulExpr(Expr *lhs, Expr *rhs) : lhs(lhs), rhs(rhs) {}
+        MemberExpr(Expr *object, std::string memberName) : object(object), memberName(std::move(memberName)) {}
 
-        ~MulExpr() = default;
+        ~MemberExpr() { delete this->object; }
 
         llvm::Value *CodeGen(CodeGenContext *context);
 
         llvm::Value *CodeGenPtr(CodeGenContext *context);
     };
 
-    class DivExpr : public Expr {
+    /*
+     * 二元运算表达式，lhs 和 rhs 为左右操作数
+     *
+     * 左结合的运算使 a + b + c + ... 成为沿左操作数不断加深的链，生成的表达式可以有数十万项。
+     * 代码生成和析构都沿左操作数的链迭代进行，栈的深度只取决于右操作数的嵌套层数，与链的长度无关。
+     */
+    class BinaryExpr : public Expr {
     public:
-        Expr *lhs;  // 除法表达式的左侧表达式
-        Expr *rhs;  // 除法表达式的右侧表达式
+        const BinaryOp op;  // 运算的种类
+        Expr *lhs;          // 左操作数
+        Expr *rhs;          // 右操作数
 
-        DivExpr(Expr *lhs, Expr *rhs) : lhs(lhs), rhs(rhs) {}
+        BinaryExpr(BinaryOp op, Expr *lhs, Expr *rhs) : op(op), lhs(lhs), rhs(rhs) {}
 
-        ~DivExpr() = default;
+        ~BinaryExpr();
 
         llvm::Value *CodeGen(CodeGenContext *context);
 
-        llvm::Value *CodeGenPtr(CodeGenContext *context);
+        /**
+         * @brief 从 expr 开始沿左操作数收集二元表达式，chain 的末尾为最内层，返回链最左端不是二元表达式的操作数
+         */
+        static Expr *GetLeftChain(Expr *expr, std::vector<BinaryExpr *> &chain);
     };
 
-    class SubExpr : public Expr {
+    class AddExpr : public BinaryExpr {
     public:
-        Expr *lhs;  // 减法表达式的左侧表达式
-        Expr *rhs;  // 减法表达式的右侧表达式
+        AddExpr(Expr *lhs, Expr *rhs) : BinaryExpr(BinaryOp::ADD, lhs, rhs) {}
 
-        SubExpr(Expr *lhs, Expr *rhs) : lhs(lhs), rhs(rhs) {}
-
-        ~SubExpr() = default;
+        llvm::Value *CodeGenPtr(CodeGenContext *context);
+    };
 
-        llvm::Value *CodeGen(CodeGenContext *context);
+    class MulExpr : public BinaryExpr {
+    public:
+        MulExpr(Expr *lhs, Expr *rhs) : BinaryExpr(BinaryOp::MUL, lhs, rhs) {}
 
         llvm::Value *CodeGenPtr(CodeGenContext *context);
     };
 
-    class EqExpr : public Expr {
+    class DivExpr : public BinaryExpr {
     public:
-        Expr *lhs;
-        Expr *rhs;
-
-        EqExpr(Expr *lhs, Expr *rhs) : lhs(lhs), rhs(rhs) {}
+        DivExpr(Expr *lhs, Expr *rhs) : BinaryExpr(BinaryOp::DIV, lhs, rhs) {}
 
-        ~EqExpr() = default;
+        llvm::Value *CodeGenPtr(CodeGenContext *context);
+    };
 
-        llvm::Value *CodeGen(CodeGenContext *context);
+    class ModExpr : public BinaryExpr {
+    public:
+        ModExpr(Expr *lhs, Expr *rhs) : BinaryExpr(BinaryOp::MOD, lhs, rhs) {}
 
         llvm::Value *CodeGenPtr(CodeGenContext *context);
     };
 
-    class NeqExpr : public Expr {
+    class SubExpr : public BinaryExpr {
     public:
-        Expr *lhs;
-        Expr *rhs;
+        SubExpr(Expr *lhs, Expr *rhs) : BinaryExpr(BinaryOp::SUB, lhs, rhs) {}
 
-        NeqExpr(Expr *lhs, Expr *rhs) : lhs(lhs), rhs(rhs) {}
-
-        ~NeqExpr() = default;
+        llvm::Value *CodeGenPtr(CodeGenContext *context);
+    };
 
-        llvm::Value *CodeGen(CodeGenContext *context);
+    class EqExpr : public BinaryExpr {
+    public:
+        EqExpr(Expr *lhs, Expr *rhs) : BinaryExpr(BinaryOp::EQ, lhs, rhs) {}
 
         llvm::Value *CodeGenPtr(CodeGenContext *context);
     };
 
-    class GreatExpr : public Expr {
+    class NeqExpr : public BinaryExpr {
     public:
-        Expr *lhs;
-        Expr *rhs;
+        NeqExpr(Expr *lhs, Expr *rhs) : BinaryExpr(BinaryOp::NEQ, lhs, rhs) {}
 
-        GreatExpr(Expr *lhs, Expr *rhs) : lhs(lhs), rhs(rhs) {}
+        llvm::Value *CodeGenPtr(CodeGenContext *context);
+    };
 
-        ~GreatExpr() = default;
+    class GreatExpr : public BinaryExpr {
+    public:
+        GreatExpr(Expr *lhs, Expr *rhs) : BinaryExpr(BinaryOp::GREAT, lhs, rhs) {}
 
-        llvm::Value *CodeGen(CodeGenContext *context);
+        llvm::Value *CodeGenPtr(CodeGenContext *context);
+    };
+
+    class LessExpr : public BinaryExpr {
+    public:
+        LessExpr(Expr *lhs, Expr *rhs) : BinaryExpr(BinaryOp::LESS, lhs, rhs) {}
 
         llvm::Value *CodeGenPtr(CodeGenContext *context);
     };
 
-    class LessExpr : public Expr {
+    class AssignExpr : public Expr {
     public:
-        Expr *lhs;
-        Expr *rhs;
+        Expr *lhs;  // 赋值符号左侧表达式
+        Expr *rhs;  // 赋值符号右侧表达式
 
-        LessExpr(Expr *lhs, Expr *rhs) : lhs(lhs), rhs(rhs) {}
+        AssignExpr(Expr *lhs, Expr *rhs) : lhs(lhs), rhs(rhs) {}
 
-        ~LessExpr() = default;
+        ~AssignExpr() { delete this->lhs; delete this->rhs; }
 
         llvm::Value *CodeGen(CodeGenContext *context);
 
         llvm::Value *CodeGenPtr(CodeGenContext *context);
     };
 
-    class AssignExpr : public Expr {
+    /* 向量构造表达式 int4(x) 或 int4(x0, x1, x2, x3)，只有一个实参时各元素都取该值 */
+    class VectorExpr : public Expr {
     public:
-        Expr *lhs;  // 赋值符号左侧表达式
-        Expr *rhs;  // 赋值符号右侧表达式
+        BuiltInType *vectorType;    // 向量类型
+        Args *args;                 // 元素的值
 
-        AssignExpr(Expr *lhs, Expr *rhs) : lhs(lhs), rhs(rhs) {}
+        VectorExpr(BuiltInType *vectorType, Args *args) : vectorType(vectorType), args(args) {}
 
-        ~AssignExpr() = default;
+        ~VectorExpr() {
+            for (auto arg : *this->args)
+                delete arg;
+            delete this->args;
+        }
 
         llvm::Value *CodeGen(CodeGenContext *context);
 
@@ -563,9 +785,13 @@ namespace AST {
 
     class Integer : public Constant {
     public:
-        int intVal; // 整型类型的整型值
+        long long intVal;   // 整型类型的整型值
+        bool isLong;        // 是否为 long 类型，带有 L 后缀或超出 int 的范围时为 long
 
-        Integer(int intVal) : intVal(intVal) {}
+        // 带有 U 后缀的整数为无符号整数
+        Integer(long long intVal, bool isLong = false, bool isUnsigned = false) : intVal(intVal), isLong(isLong) {
+            this->isUnsigned = isUnsigned;
+        }
 
         ~Integer() = default;
 
@@ -574,9 +800,10 @@ namespace AST {
 
     class Real : public Constant {
     public:
-        double doubleVal; // 整型类型的整型值
+        double doubleVal; // 实数型常量的值
+        bool isFloat;     // 是否为 float 类型，带有 F 后缀时为 float
 
-        Real(double doubleVal) : doubleVal(doubleVal) {}
+        Real(double doubleVal, bool isFloat = false) : doubleVal(doubleVal), isFloat(isFloat) {}
 
         ~Real() = default;
 
@@ -597,10 +824,15 @@ namespace AST {
     class Prog : public Node {
     public:
         Units *units;   // 程序中的基本单元组成的列表
+        std::vector<std::string> constCallees;  // 全局变量的初始值在编译期求值时调用的函数名称
 
         Prog(Units *units) : units(units) {}
 
-        ~Prog() = default;
+        ~Prog() {
+            for (auto unit : *this->units)
+                delete unit;
+            delete this->units;
+        }
 
         llvm::Value *CodeGen(CodeGenContext *context);
     };
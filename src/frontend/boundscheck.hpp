@@ -0,0 +1,394 @@
+//
+// Created by Pei Yuhang on 2023/6/11.
+//
+
+#ifndef CP_PROJECT_BOUNDSCHECK_HPP
+#define CP_PROJECT_BOUNDSCHECK_HPP
+
+#include <algorithm>
+#include <limits>
+#include <set>
+
+#include "AST.h"
+#include "codegen.h"
+#include "consteval.hpp"
+#include "type.hpp"
+#include "util.hpp"
+
+/*
+ * -fbounds-check：数组的每次下标访问都与数组的长度比较，越界时调用运行时库输出源代码位置并终止程序
+ *
+ * 对于 for (i = lo; i < hi; i = i + 1) 形式的循环，循环体每次迭代都会执行的、下标为 i、i + c 或 i - c（c 为整数字面量）
+ * 的数组访问合并为循环开始前的一次区间检查，循环中不再逐次检查；lo 和 hi 为常量时检查在编译期完成，不生成任何代码。
+ * 合并后的检查在循环开始前失败，因此越界之前的迭代不会执行。指针的下标访问不知道长度，不做检查。
+ */
+
+bool IsMemoryBuiltin(const std::string &funcName);
+
+/**
+ * @brief 获取源代码位置的字符串，形如 file.c:12:5，作为运行时库函数的参数
+ */
+llvm::Value *CreateLocationString(CodeGenContext *context, AST::SourceLocation location) {
+    const std::string &fileName = context->module->getSourceFileName();
+    return Builder.CreateGlobalStringPtr((fileName == "-" ? "<stdin>" : fileName) + ":" + std::to_string(location.line)
+                                       + ":" + std::to_string(location.column), "bounds.location");
+}
+
+/**
+ * @brief 获取运行时库中不会返回的越界处理函数
+ */
+llvm::FunctionCallee GetBoundsFailureFunc(CodeGenContext *context, const std::string &funcName,
+                                          llvm::ArrayRef<llvm::Type *> paramTypes) {
+    llvm::FunctionCallee callee = context->module->getOrInsertFunction(
+            funcName, llvm::FunctionType::get(Builder.getVoidTy(), paramTypes, false));
+    if (auto func = llvm::dyn_cast<llvm::Function>(callee.getCallee())) {
+        func->setDoesNotReturn();
+        func->setDoesNotThrow();
+        func->addFnAttr(llvm::Attribute::Cold);
+    }
+    return callee;
+}
+
+/**
+ * @brief 条件为假时进入调用越界处理函数的基本块，之后在条件为真的基本块中继续生成代码；条件为常量真时不生成任何代码
+ * @param inBounds 检查通过的条件
+ * @param reportFailure 在越界的基本块中生成对越界处理函数的调用
+ */
+template<typename ReportFailure>
+void CreateBoundsCheckBranch(CodeGenContext *context, llvm::Value *inBounds, ReportFailure reportFailure) {
+    auto constant = llvm::dyn_cast<llvm::ConstantInt>(inBounds);
+    if (constant && constant->isOne())
+        return;
+
+    llvm::Function *currentFunc = context->GetCurrentFunc();
+    llvm::BasicBlock *failBB = llvm::BasicBlock::Create(Context, "bounds.fail");
+    llvm::BasicBlock *okBB = llvm::BasicBlock::Create(Context, "bounds.ok");
+    Builder.CreateCondBr(inBounds, okBB, failBB);
+
+    InsertFuncBasicBlockList(currentFunc, failBB);
+    Builder.SetInsertPoint(failBB);
+    reportFailure();
+    Builder.CreateUnreachable();
+
+    InsertFuncBasicBlockList(currentFunc, okBB);
+    Builder.SetInsertPoint(okBB);
+}
+
+/**
+ * @brief 检查下标是否在 [0, size) 中
+ * @param index 下标的值，与 getelementptr 一样视为有符号整数，无符号的下标须已经零扩展
+ * @param size 数组的长度
+ * @param location 下标表达式的位置
+ */
+void CreateBoundsCheck(CodeGenContext *context, llvm::Value *index, uint64_t size, AST::SourceLocation location) {
+    llvm::Value *index64 = Builder.CreateSExtOrTrunc(index, Builder.getInt64Ty());
+    // 无符号比较同时排除了负数下标
+    llvm::Value *inBounds = Builder.CreateICmpULT(index64, Builder.getInt64(size));
+    CreateBoundsCheckBranch(context, inBounds, [&]() {
+        llvm::FunctionCallee failure = GetBoundsFailureFunc(
+                context, "cp_bounds_check_failed",
+                { llvm::Type::getInt8PtrTy(Context), Builder.getInt64Ty(), Builder.getInt64Ty() });
+        Builder.CreateCall(failure, { CreateLocationString(context, location), index64, Builder.getInt64(size) });
+    });
+}
+
+/* 合并到循环开始前的区间检查 */
+class LoopBoundsCheck {
+public:
+    /**
+     * @brief 找出循环体中可以合并检查的数组访问，循环体中有 return、对循环变量赋值或重新定义循环变量时没有
+     * @param loopStmt 循环体
+     * @param loopVarName 循环变量名
+     */
+    LoopBoundsCheck(AST::Stmt *loopStmt, const std::string &loopVarName, CodeGenContext *context)
+            : loopVarName(loopVarName) {
+        ScanStmt(loopStmt, true);
+        if (this->hasReturn || this->assignedVars.count(loopVarName) || this->declaredVars.count(loopVarName))
+            return;
+
+        for (auto subscript : this->candidates) {
+            int64_t offset;
+            std::string rootName;
+            uint64_t size = GetArraySize(subscript->array, rootName, context);
+            if (size == 0 || this->declaredVars.count(rootName) || !MatchIndex(subscript->index, offset))
+                continue;
+            this->validLo = std::max(this->validLo, -offset);
+            this->validHi = std::min(this->validHi, static_cast<int64_t>(size) - offset);
+            this->accesses.push_back(subscript);
+        }
+    }
+
+    /**
+     * @brief 变量是否在循环体中被赋值
+     */
+    bool IsAssigned(const std::string &varName) const { return this->assignedVars.count(varName) > 0; }
+
+    /**
+     * @brief 在当前插入点生成检查：lo < hi 时 [lo, hi) 须在 [validLo, validHi) 之内，并将合并的访问标记为已检查
+     * @param lo 循环变量的初值，有符号整数
+     * @param hi 循环变量的上界（不含），有符号整数
+     * @param location 循环语句的位置
+     */
+    void CodeGen(llvm::Value *lo, llvm::Value *hi, AST::SourceLocation location, CodeGenContext *context) const {
+        if (this->accesses.empty())
+            return;
+
+        llvm::Type *int64Type = Builder.getInt64Ty();
+        llvm::Value *lo64 = Builder.CreateSExtOrTrunc(lo, int64Type);
+        llvm::Value *hi64 = Builder.CreateSExtOrTrunc(hi, int64Type);
+        llvm::Value *inBounds = Builder.CreateOr(
+                Builder.CreateICmpSGE(lo64, hi64),
+                Builder.CreateAnd(Builder.CreateICmpSGE(lo64, Builder.getInt64(this->validLo)),
+                                  Builder.CreateICmpSLE(hi64, Builder.getInt64(this->validHi))));
+        CreateBoundsCheckBranch(context, inBounds, [&]() {
+            llvm::Type *int8PtrType = llvm::Type::getInt8PtrTy(Context);
+            llvm::FunctionCallee failure = GetBoundsFailureFunc(
+                    context, "cp_loop_bounds_check_failed",
+                    { int8PtrType, int8PtrType, int64Type, int64Type, int64Type, int64Type });
+            Builder.CreateCall(failure, { CreateLocationString(context, location),
+                                          Builder.CreateGlobalStringPtr(this->loopVarName, "bounds.loopvar"),
+                                          lo64, hi64, Builder.getInt64(this->validLo), Builder.getInt64(this->validHi) });
+        });
+
+        for (auto subscript : this->accesses)
+            context->SetBoundsCheckHoisted(subscript);
+    }
+
+private:
+    /**
+     * @brief 扫描语句，unconditional 表示该语句是否在每次迭代中都会执行
+     */
+    void ScanStmt(AST::Stmt *stmt, bool unconditional) {
+        if (auto block = dynamic_cast<AST::Block *>(stmt)) {
+            for (auto s : *block->stmts)
+                ScanStmt(s, unconditional);
+        }
+        else if (auto varDef = dynamic_cast<AST::VarDef *>(stmt)) {
+            for (auto var : *varDef->varInitList) {
+                this->declaredVars.insert(var->varName);
+                if (var->initExpr)
+                    ScanExpr(var->initExpr, unconditional);
+            }
+        }
+        else if (auto exprStmt = dynamic_cast<AST::ExprStmt *>(stmt))
+            ScanExpr(exprStmt->expr, unconditional);
+        else if (auto ifStmt = dynamic_cast<AST::IfStmt *>(stmt)) {
+            ScanExpr(ifStmt->condition, unconditional);
+            if (ifStmt->thenStmt)
+                ScanStmt(ifStmt->thenStmt, false);
+            if (ifStmt->elseStmt)
+                ScanStmt(ifStmt->elseStmt, false);
+        }
+        else if (auto forStmt = dynamic_cast<AST::ForStmt *>(stmt)) {
+            // 内层循环的初始化总会执行，条件、增量和循环体的执行次数未知
+            if (forStmt->init)
+                ScanStmt(forStmt->init, unconditional);
+            if (forStmt->condition)
+                ScanExpr(forStmt->condition, false);
+            if (forStmt->increment)
+                ScanExpr(forStmt->increment, false);
+            ScanStmt(forStmt->loopStmt, false);
+            if (auto parallelFor = dynamic_cast<AST::ParallelForStmt *>(stmt))
+                for (const auto &reduction : *parallelFor->reductions)
+                    this->assignedVars.insert(reduction.varName);
+        }
+        else if (auto returnStmt = dynamic_cast<AST::ReturnStmt *>(stmt)) {
+            this->hasReturn = true;
+            if (returnStmt->returnVal)
+                ScanExpr(returnStmt->returnVal, false);
+        }
+    }
+
+    /**
+     * @brief 扫描表达式，表达式的各个子表达式总会被求值
+     */
+    void ScanExpr(AST::Expr *expr, bool unconditional) {
+        if (auto subscript = dynamic_cast<AST::SubscriptExpr *>(expr)) {
+            if (unconditional)
+                this->candidates.push_back(subscript);
+            ScanExpr(subscript->array, unconditional);
+            ScanExpr(subscript->index, unconditional);
+        }
+        else if (auto assign = dynamic_cast<AST::AssignExpr *>(expr)) {
+            if (auto var = dynamic_cast<AST::Variable *>(assign->lhs))
+                this->assignedVars.insert(var->varName);
+            ScanExpr(assign->lhs, unconditional);
+            ScanExpr(assign->rhs, unconditional);
+        }
+        else if (auto member = dynamic_cast<AST::MemberExpr *>(expr))
+            ScanExpr(member->object, unconditional);
+        else if (auto call = dynamic_cast<AST::FuncCall *>(expr)) {
+            // 内存内置函数写入第一个实参，该实参所属的变量视为被赋值
+            if (IsMemoryBuiltin(call->funcName) && !call->args->empty())
+                if (auto var = GetRootVariable(call->args->front()))
+                    this->assignedVars.insert(var->varName);
+            for (auto arg : *call->args)
+                ScanExpr(arg, unconditional);
+        }
+        else if (auto vector = dynamic_cast<AST::VectorExpr *>(expr)) {
+            for (auto arg : *vector->args)
+                ScanExpr(arg, unconditional);
+        }
+        else if (auto binary = dynamic_cast<AST::BinaryExpr *>(expr)) {
+            // 沿左操作数的链迭代扫描，按源代码的顺序记录下标访问
+            std::vector<AST::BinaryExpr *> chain;
+            ScanExpr(AST::BinaryExpr::GetLeftChain(binary, chain), unconditional);
+            for (auto iter = chain.rbegin(); iter != chain.rend(); ++iter)
+                ScanExpr((*iter)->rhs, unconditional);
+        }
+    }
+
+    /**
+     * @brief 下标是否为 i、i + c、c + i 或 i - c，c 为整数字面量，offset 返回 c 或 -c
+     */
+    bool MatchIndex(AST::Expr *index, int64_t &offset) const {
+        auto isLoopVar = [this](AST::Expr *expr) {
+            auto var = dynamic_cast<AST::Variable *>(expr);
+            return var && var->varName == this->loopVarName;
+        };
+        // 字面量限制在 int 的范围内，i + c 不会溢出 64 位的检查区间
+        auto getLiteral = [](AST::Expr *expr, int64_t &value) {
+            auto integer = dynamic_cast<AST::Integer *>(expr);
+            if (!integer || integer->intVal > std::numeric_limits<int32_t>::max())
+                return false;
+            value = integer->intVal;
+            return true;
+        };
+
+        offset = 0;
+        if (isLoopVar(index))
+            return true;
+        if (auto add = dynamic_cast<AST::AddExpr *>(index))
+            return (isLoopVar(add->lhs) && getLiteral(add->rhs, offset)) || (isLoopVar(add->rhs) && getLiteral(add->lhs, offset));
+        if (auto sub = dynamic_cast<AST::SubExpr *>(index)) {
+            if (!isLoopVar(sub->lhs) || !getLiteral(sub->rhs, offset))
+                return false;
+            offset = -offset;
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * @brief 获取数组元素或结构体成员所属的变量，不属于某个变量时为 nullptr
+     */
+    static AST::Variable *GetRootVariable(AST::Expr *expr) {
+        for (;;) {
+            if (auto subscript = dynamic_cast<AST::SubscriptExpr *>(expr))
+                expr = subscript->array;
+            else if (auto member = dynamic_cast<AST::MemberExpr *>(expr))
+                expr = member->object;
+            else
+                return dynamic_cast<AST::Variable *>(expr);
+        }
+    }
+
+    /**
+     * @brief 获取被下标访问的数组的长度，不是数组或长度未知时为 0
+     * @param array 数组变量，或多维数组的下标访问
+     * @param rootName 返回数组变量名
+     */
+    static uint64_t GetArraySize(AST::Expr *array, std::string &rootName, CodeGenContext *context) {
+        llvm::Type *arrayType = GetArrayType(array, rootName, context);
+        if (!arrayType)
+            return 0;
+        if (AST::ArrType *soaType = AST::TypeTable::FindSoAArrType(arrayType))
+            return soaType->size;
+        return arrayType->isArrayTy() ? arrayType->getArrayNumElements() : 0;
+    }
+
+    static llvm::Type *GetArrayType(AST::Expr *array, std::string &rootName, CodeGenContext *context) {
+        if (auto var = dynamic_cast<AST::Variable *>(array)) {
+            llvm::Value *varPtr = context->GetVar(var->varName);
+            if (!varPtr || !varPtr->getType()->isPointerTy())
+                return nullptr;
+            rootName = var->varName;
+            return GetPtrElementType(varPtr);
+        }
+        if (auto subscript = dynamic_cast<AST::SubscriptExpr *>(array)) {
+            llvm::Type *outerType = GetArrayType(subscript->array, rootName, context);
+            return outerType && outerType->isArrayTy() ? outerType->getArrayElementType() : nullptr;
+        }
+        // 结构体的数组成员；SoA 数组元素的成员取该成员的数组的元素类型
+        if (auto member = dynamic_cast<AST::MemberExpr *>(array)) {
+            if (auto subscript = dynamic_cast<AST::SubscriptExpr *>(member->object)) {
+                llvm::Type *outerType = GetArrayType(subscript->array, rootName, context);
+                if (AST::ArrType *soaType = outerType ? AST::TypeTable::FindSoAArrType(outerType) : nullptr) {
+                    auto structType = static_cast<AST::StructType *>(soaType->elementType);
+                    return outerType->getStructElementType(structType->GetMemberIndex(member->memberName))
+                            ->getArrayElementType();
+                }
+            }
+            llvm::Type *objectType = GetArrayType(member->object, rootName, context);
+            AST::StructType *structType = objectType ? AST::TypeTable::FindStructType(objectType) : nullptr;
+            return structType ? objectType->getStructElementType(structType->GetMemberIndex(member->memberName)) : nullptr;
+        }
+        return nullptr;
+    }
+
+    std::string loopVarName;
+    std::vector<AST::SubscriptExpr *> candidates;   // 每次迭代都会执行的下标访问
+    std::vector<AST::SubscriptExpr *> accesses;     // 其中下标为循环变量加常量、合并检查的访问
+    std::set<std::string> assignedVars;     // 循环体中被赋值的变量
+    std::set<std::string> declaredVars;     // 循环体中定义的变量，可能遮蔽外层的同名变量
+    bool hasReturn = false;
+    int64_t validLo = std::numeric_limits<int64_t>::min();  // 循环变量允许的区间 [validLo, validHi)
+    int64_t validHi = std::numeric_limits<int64_t>::max();
+};
+
+/**
+ * @brief 为 for (i = lo; i < hi; i = i + 1) 形式的循环在初始化之后、第一次条件判断之前生成合并的区间检查
+ *
+ * 循环变量须为有符号整型的局部变量；hi 须为整数字面量、const 变量或循环体中没有被赋值的有符号整型局部变量，
+ * 局部变量不能被取地址，因此在循环中保持不变。其他形式的循环不合并，循环体中的访问仍逐次检查。
+ */
+void HoistLoopBoundsChecks(AST::ForStmt *loop, CodeGenContext *context) {
+    auto init = dynamic_cast<AST::ExprStmt *>(loop->init);
+    auto initExpr = init ? dynamic_cast<AST::AssignExpr *>(init->expr) : nullptr;
+    auto loopVar = initExpr ? dynamic_cast<AST::Variable *>(initExpr->lhs) : nullptr;
+    if (!loopVar)
+        return;
+    const std::string &varName = loopVar->varName;
+    auto isLoopVar = [&varName](AST::Expr *expr) {
+        auto var = dynamic_cast<AST::Variable *>(expr);
+        return var && var->varName == varName;
+    };
+    auto isOne = [](AST::Expr *expr) {
+        auto integer = dynamic_cast<AST::Integer *>(expr);
+        return integer && integer->intVal == 1;
+    };
+
+    auto condition = dynamic_cast<AST::LessExpr *>(loop->condition);
+    auto increment = dynamic_cast<AST::AssignExpr *>(loop->increment);
+    auto step = increment ? dynamic_cast<AST::AddExpr *>(increment->rhs) : nullptr;
+    if (!condition || !isLoopVar(condition->lhs) || !step || !isLoopVar(increment->lhs)
+        || !((isLoopVar(step->lhs) && isOne(step->rhs)) || (isOne(step->lhs) && isLoopVar(step->rhs))))
+        return;
+
+    auto isSignedLocal = [context](llvm::Value *var) {
+        return var && llvm::isa<llvm::AllocaInst>(var) && !context->IsUnsigned(var)
+               && (GetPtrElementType(var)->isIntegerTy(32) || GetPtrElementType(var)->isIntegerTy(64));
+    };
+    llvm::Value *loopVarPtr = context->GetVar(varName);
+    if (!isSignedLocal(loopVarPtr))
+        return;
+
+    LoopBoundsCheck boundsCheck(loop->loopStmt, varName, context);
+    if (auto integer = dynamic_cast<AST::Integer *>(condition->rhs)) {
+        if (integer->isUnsigned)
+            return;
+    }
+    else if (auto hiVar = dynamic_cast<AST::Variable *>(condition->rhs)) {
+        llvm::Value *hiPtr = context->GetVar(hiVar->varName);
+        if (!hiPtr || !(IsConstVar(hiPtr) ? !context->IsUnsigned(hiPtr) && GetPtrElementType(hiPtr)->isIntegerTy()
+                                           : isSignedLocal(hiPtr) && !boundsCheck.IsAssigned(hiVar->varName)))
+            return;
+    }
+    else
+        return;
+
+    llvm::Value *lo = Builder.CreateLoad(GetPtrElementType(loopVarPtr), loopVarPtr, varName);
+    boundsCheck.CodeGen(lo, condition->rhs->CodeGen(context), loop->location, context);
+}
+
+#endif //CP_PROJECT_BOUNDSCHECK_HPP
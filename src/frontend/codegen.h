@@ -6,6 +6,7 @@
 #define CP_PROJECT_CODEGEN_H
 
 #include <map>
+#include <set>
 #include <stack>
 #include <string>
 
@@ -19,12 +20,24 @@
 #include <llvm/Support/TargetSelect.h>
 #include <llvm/Target/TargetMachine.h>
 #include <llvm/Target/TargetOptions.h>
+#include <llvm/ExecutionEngine/ExecutionEngine.h>
 
 #include "AST.h"
 
-static llvm::LLVMContext Context;
+struct Fingerprints;
+class ObjectCache;
+class DebugInfo;
+class RemarkCollector;
+class FunctionCountListener;
+class PerfMapListener;
+struct MainFunction;
+struct RemarkOptions;
 
-static llvm::IRBuilder<> Builder(Context);
+// 所有翻译单元共用同一个 LLVMContext：module 中的类型、常量和元数据必须属于同一个 LLVMContext，
+// 优化报告等诊断信息也只经由它的诊断信息处理器输出
+inline llvm::LLVMContext Context;
+
+inline llvm::IRBuilder<> Builder(Context);
 
 using VarTable = std::map<std::string, llvm::Value *>;
 
@@ -46,14 +59,90 @@ public:
 
     void GenerateCode(AST::Prog *root);
 
-#if LLVM_VERSION_MAJOR >= 16
-    void GenerateObject(const std::string &fileName) const;
+    void BeginCodeGen();
+
+    void GenerateUnit(AST::Unit *unit);
+
+    void EndCodeGen();
+
+    void Optimize();
+
+#if LLVM_VERSION_MAJOR >= 14
+    void GenerateObject(const std::string &fileName);
+
+    void GenerateAssembly(const std::string &fileName);
 #endif
 
-    void ExecuteCode();
+    int ExecuteCode(const std::vector<std::string> &args);
+
+    MainFunction GetMainFunction();
+
+    std::vector<std::pair<void *, size_t>> GetWritableGlobals() const;
 
     void DumpLLVMIR(const std::string &fileName) const;
 
+    void DumpBitcode(const std::string &fileName) const;
+
+    /* 增量编译 */
+
+#if LLVM_VERSION_MAJOR >= 14
+    void SetIncremental(const Fingerprints *fingerprints, const ObjectCache *objectCache);
+
+    bool IsFuncReused(const std::string &funcName) const;
+
+    void CompileIncremental();
+#else
+    bool IsFuncReused(const std::string &funcName) const { return false; }
+#endif
+
+    const std::vector<std::string> &GetObjectFiles() const { return this->objectFiles; }
+
+    /* 服务模式 */
+
+    void PrepareJIT();
+
+    /* 性能分析支持 */
+
+    void SetPerfSupport(bool perfSupport) { this->perfSupport = perfSupport; }
+
+    PerfMapListener *GetPerfMapListener() const { return this->perfMapListener; }
+
+    /* 调试信息 */
+
+    void SetDebugInfoEnabled(bool debugInfoEnabled) { this->debugInfoEnabled = debugInfoEnabled; }
+
+    DebugInfo *GetDebugInfo() const { return this->debugInfo; }
+
+    /* 优化报告 */
+
+    void SetRemarkOptions(const RemarkOptions *remarkOptions) { this->remarkOptions = remarkOptions; }
+
+    void FinishRemarks();
+
+    /* 数组越界检查 */
+
+    void SetBoundsCheckEnabled(bool boundsCheckEnabled) { this->boundsCheckEnabled = boundsCheckEnabled; }
+
+    bool IsBoundsCheckEnabled() const { return this->boundsCheckEnabled; }
+
+    void SetBoundsCheckHoisted(const AST::SubscriptExpr *subscript) { this->hoistedBoundsChecks.insert(subscript); }
+
+    bool IsBoundsCheckHoisted(const AST::SubscriptExpr *subscript) const { return this->hoistedBoundsChecks.count(subscript) > 0; }
+
+    void ClearBoundsCheckHoisted() { this->hoistedBoundsChecks.clear(); }
+
+    /* 优化级别与执行统计 */
+
+    void SetOptLevel(unsigned optLevel) { this->optLevel = optLevel; }
+
+    unsigned GetOptLevel() const { return this->optLevel; }
+
+    double GetJITTime() const { return this->jitTime; }
+
+    double GetRunTime() const { return this->runTime; }
+
+    size_t GetMaterializedFunctionCount() const;
+
     /* 基本块操作 */
 
     void PushBasicBlock(llvm::BasicBlock *basicBlock);
@@ -80,14 +169,46 @@ public:
 
     llvm::Value *GetVar(const std::string &varName);
 
+    llvm::Value *GetGlobalVar(const std::string &varName);
+
     bool IsVarDefined(const std::string &varName);
 
+    VarTable GetVisibleVars() const;
+
+    /* 无符号整型的变量和函数，LLVM 的整型不区分符号，由上下文记录变量的地址和返回无符号整数的函数 */
+
+    void SetUnsigned(const llvm::Value *value) { this->unsignedValues.insert(value); }
+
+    bool IsUnsigned(const llvm::Value *value) const { return this->unsignedValues.count(value) > 0; }
+
+    /* 指针变量所指向的类型，LLVM 16 的指针不带有所指向的类型，由上下文记录指针变量的地址和它的类型 */
+
+    void SetPtrType(const llvm::Value *value, AST::PtrType *type) { this->ptrTypes[value] = type; }
+
+    AST::PtrType *GetPtrType(const llvm::Value *value) const {
+        auto iter = this->ptrTypes.find(value);
+        return iter == this->ptrTypes.end() ? nullptr : iter->second;
+    }
+
+    /* parallel for 循环体操作 */
+
+    void SetInParallelBody(bool inParallelBody) { this->inParallelBody = inParallelBody; }
+
+    bool IsInParallelBody() const { return this->inParallelBody; }
+
     /* 函数操作 */
 
     void SetMainFunc(llvm::Function *mainFunc) { this->mainFunc = mainFunc; }
 
     bool IsFuncExist(const std::string &funcName) { return !(this->module->getFunction(funcName)); }
 
+    void AddFuncDef(AST::FuncDef *funcDef) { this->funcDefs[funcDef->funcName] = funcDef; }
+
+    AST::FuncDef *GetFuncDef(const std::string &funcName) const {
+        auto iter = this->funcDefs.find(funcName);
+        return iter == this->funcDefs.end() ? nullptr : iter->second;
+    }
+
     /* 当前函数操作 */
 
     void EnterFunc(llvm::Function *func) { this->currentFunc = func; }
@@ -103,9 +224,45 @@ public:
     llvm::Type *GetCurrentReturnType() const { return this->currentFunc->getReturnType(); }
 
 private:
+    llvm::ExecutionEngine *CreateExecutionEngine();
+
+    void OptimizeModule(llvm::Module &module, llvm::TargetMachine *targetMachine) const;
+
+    void MarkReadOnlyGlobals();
+
+#if LLVM_VERSION_MAJOR >= 14
+    llvm::TargetMachine *GetTargetMachine();
+
+    void EmitMachineCode(llvm::Module &module, const std::string &fileName, llvm::CodeGenFileType fileType);
+
+    void CompileUnit(const std::string &fingerprint, const std::set<const llvm::GlobalValue *> &unit);
+#endif
+
     std::vector<CodeGenBlock *> blocks;
+    std::map<std::string, AST::FuncDef *> funcDefs;     // 已定义的用户函数，供编译期求值时解释执行
+    std::set<const llvm::Value *> unsignedValues;       // 无符号整型的变量的地址和返回无符号整数的函数
+    std::map<const llvm::Value *, AST::PtrType *> ptrTypes;    // 指针变量的地址及其类型
     llvm::Function *mainFunc;
     llvm::Function *currentFunc = nullptr;
+    bool inParallelBody = false;    // 是否正在为 parallel for 的循环体生成代码
+    bool perfSupport = false;   // 是否为 JIT 生成的代码注册 perf 相关的监听器
+    PerfMapListener *perfMapListener = nullptr;     // 写出 perf map 文件的监听器，开启 perf 支持后首次 JIT 时创建
+    bool debugInfoEnabled = false;  // 是否生成调试信息 (-g)
+    DebugInfo *debugInfo = nullptr; // 调试信息的生成器，只在 BeginCodeGen() 到 EndCodeGen() 之间存在
+    const RemarkOptions *remarkOptions = nullptr;   // 优化报告的选项，为空指针时不收集
+    RemarkCollector *remarks = nullptr;     // 从代码生成开始到 FinishRemarks() 收集优化报告
+    bool boundsCheckEnabled = false;    // 是否检查数组下标越界 (-fbounds-check)
+    std::set<const AST::SubscriptExpr *> hoistedBoundsChecks;   // 已合并到循环开始前的区间检查中的下标访问
+    unsigned optLevel = 0;      // 优化级别，取值为 0 ~ 3
+    llvm::TargetMachine *targetMachine = nullptr;   // 本机的目标机器，首次使用时创建
+    double jitTime = 0;         // JIT 编译耗时（秒）
+    double runTime = 0;         // main 函数执行耗时（秒）
+    FunctionCountListener *functionCounter = nullptr;   // 统计 JIT 生成机器码的函数数量，首次 JIT 时创建
+    const Fingerprints *fingerprints = nullptr;     // 增量编译中各编译单元的指纹
+    const ObjectCache *objectCache = nullptr;       // 增量编译的目标文件缓存，为空指针时不使用增量编译
+    std::vector<std::string> objectFiles;           // 增量编译得到的各编译单元的目标文件
+    llvm::ExecutionEngine *preparedEngine = nullptr;    // 预先创建的 ExecutionEngine，为空指针时在执行时创建
+    llvm::ExecutionEngine *executionEngine = nullptr;   // GetMainFunction() 使用的 ExecutionEngine
 };
 
 #endif //CP_PROJECT_CODEGEN_H
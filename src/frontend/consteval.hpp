@@ -0,0 +1,353 @@
+//
+// Created by Pei Yuhang on 2023/6/10.
+//
+
+#ifndef CP_PROJECT_CONSTEVAL_HPP
+#define CP_PROJECT_CONSTEVAL_HPP
+
+#include <map>
+
+#include "AST.h"
+#include "codegen.h"
+#include "trace.h"
+#include "type.hpp"
+
+/*
+ * 编译期求值器，用于 const 变量和全局变量的初始值以及数组的长度
+ *
+ * 可求值的表达式由字面量、const 变量、算术运算、比较运算、向量构造和对纯函数的调用组成。
+ * 纯函数是只读写自己的形参和局部变量、只读取 const 变量、只调用其他纯函数的用户函数，
+ * 调用时逐条解释执行其函数体，函数体中可以使用局部变量定义、赋值、if、for 和 return。
+ * 运算与运行时一样由 Builder 完成，操作数都是常量时 Builder 直接将其折叠为常量，因此编译期与运行时的结果一致。
+ * 无法求值时抛出 std::logic_error，并说明原因。
+ */
+
+/**
+ * @brief 判断变量是否为 const 变量，const 变量是带有初始值的常量 llvm::GlobalVariable
+ * @param var 变量的地址
+ */
+bool IsConstVar(const llvm::Value *var) {
+    auto global = llvm::dyn_cast<llvm::GlobalVariable>(var);
+    return global && global->isConstant() && global->hasInitializer();
+}
+
+class ConstEvaluator {
+public:
+    explicit ConstEvaluator(CodeGenContext *context) : context(context) {}
+
+    llvm::Constant *Evaluate(AST::Expr *expr);
+
+private:
+    /* 被解释执行的函数中的局部变量，值为空指针表示尚未赋值 */
+    struct LocalVar {
+        llvm::Type *type;
+        bool isUnsigned;
+        llvm::Constant *value;
+    };
+
+    using Scope = std::map<std::string, LocalVar>;
+
+    static const size_t MaxSteps = 1000000;     // 一次求值最多执行的语句和循环迭代次数
+    static const size_t MaxCallDepth = 256;     // 函数调用的最大嵌套深度
+
+    llvm::Constant *EvaluateBinary(AST::Expr *expr);
+
+    llvm::Constant *Call(AST::FuncDef *funcDef, AST::Args *args);
+
+    void Execute(AST::Stmt *stmt);
+
+    LocalVar *FindLocal(const std::string &varName);
+
+    void DefineLocal(const std::string &varName, llvm::Type *type, bool isUnsigned, llvm::Constant *value);
+
+    llvm::Constant *Convert(AST::Expr *expr, llvm::Type *type, bool toUnsigned);
+
+    bool EvaluateCondition(AST::Expr *condition);
+
+    void Step();
+
+    CodeGenContext *context;
+    std::vector<std::vector<Scope>> frames;     // 调用栈，每一帧是被调用函数的作用域栈
+    std::vector<AST::FuncDef *> callStack;      // 调用栈中每一帧对应的函数定义
+    llvm::Constant *returnValue = nullptr;      // 当前函数 return 的值，不为空时跳过剩余的语句
+    size_t steps = 0;
+};
+
+/**
+ * @brief 对表达式求值
+ * @param expr 表达式
+ * @return 表达式的值
+ */
+llvm::Constant *ConstEvaluator::Evaluate(AST::Expr *expr) {
+    if (dynamic_cast<AST::Boolean *>(expr) || dynamic_cast<AST::Character *>(expr)
+        || dynamic_cast<AST::Integer *>(expr) || dynamic_cast<AST::Real *>(expr))
+        return llvm::cast<llvm::Constant>(expr->CodeGen(this->context));
+
+    if (auto str = dynamic_cast<AST::ConstString *>(expr)) {
+        // 字符串常量的地址也是常量，字符串直接创建为全局常量，不需要插入点
+        llvm::Constant *data = llvm::ConstantDataArray::getString(Context, str->strVal);
+        auto global = new llvm::GlobalVariable(*this->context->module, data->getType(), true,
+                                               llvm::GlobalValue::PrivateLinkage, data, ".str");
+        global->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
+        return llvm::ConstantExpr::getPointerCast(global, Builder.getInt8PtrTy());
+    }
+
+    if (auto var = dynamic_cast<AST::Variable *>(expr)) {
+        if (LocalVar *local = FindLocal(var->varName)) {
+            var->isUnsigned = local->isUnsigned;
+            if (!local->value)
+                throw std::logic_error("variable " + var->varName + " is used before being assigned");
+            return local->value;
+        }
+        // 被调用的函数中只能看到全局作用域，不能看到调用处的局部变量
+        llvm::Value *varPtr = this->frames.empty() ? this->context->GetVar(var->varName)
+                                                   : this->context->GetGlobalVar(var->varName);
+        if (!varPtr)
+            throw std::logic_error(var->varName + " is not a variable");
+        if (!IsConstVar(varPtr))
+            throw std::logic_error("variable " + var->varName + " is not const");
+        var->isUnsigned = this->context->IsUnsigned(varPtr);
+        return llvm::cast<llvm::GlobalVariable>(varPtr)->getInitializer();
+    }
+
+    if (auto assign = dynamic_cast<AST::AssignExpr *>(expr)) {
+        // 只能给被调用函数自己的局部变量赋值，其他赋值都是副作用
+        auto var = dynamic_cast<AST::Variable *>(assign->lhs);
+        LocalVar *local = var ? FindLocal(var->varName) : nullptr;
+        if (!local)
+            throw std::logic_error("assignment to anything other than a local variable has side effects");
+        local->value = Convert(assign->rhs, local->type, local->isUnsigned);
+        assign->isUnsigned = local->isUnsigned;
+        return local->value;
+    }
+
+    if (auto call = dynamic_cast<AST::FuncCall *>(expr)) {
+        AST::FuncDef *funcDef = this->context->GetFuncDef(call->funcName);
+        if (!funcDef)
+            throw std::logic_error(call->funcName + "() is not a user function");
+        call->isUnsigned = funcDef->returnType->IsUnsigned();
+        return Call(funcDef, call->args);
+    }
+
+    if (auto vector = dynamic_cast<AST::VectorExpr *>(expr)) {
+        auto vectorType = llvm::cast<llvm::FixedVectorType>(vector->vectorType->GetLLVMType(this->context));
+        const unsigned lanes = vectorType->getNumElements();
+        std::vector<llvm::Constant *> elements;
+        for (auto arg : *vector->args)
+            elements.push_back(Convert(arg, vectorType->getElementType(), false));
+        if (elements.size() == 1)
+            return llvm::ConstantVector::getSplat(llvm::ElementCount::getFixed(lanes), elements[0]);
+        if (elements.size() != lanes)
+            throw std::logic_error(vector->vectorType->GetTypeName() + " expects 1 or " + std::to_string(lanes) + " elements");
+        return llvm::ConstantVector::get(elements);
+    }
+
+    if (dynamic_cast<AST::SubscriptExpr *>(expr))
+        throw std::logic_error("arrays cannot be used in compile-time evaluation");
+    if (dynamic_cast<AST::MemberExpr *>(expr))
+        throw std::logic_error("structs cannot be used in compile-time evaluation");
+
+    return EvaluateBinary(expr);
+}
+
+/**
+ * @brief 对二元运算表达式求值，与各表达式的 CodeGen() 一样由 CreateBinaryOp() 选择运算指令，沿左操作数的链迭代求值
+ */
+llvm::Constant *ConstEvaluator::EvaluateBinary(AST::Expr *expr) {
+    std::vector<AST::BinaryExpr *> chain;
+    AST::Expr *leftmost = AST::BinaryExpr::GetLeftChain(expr, chain);
+    if (chain.empty())
+        throw std::logic_error("the expression cannot be evaluated at compile time");
+
+    llvm::Constant *LHS = Evaluate(leftmost);
+    for (auto iter = chain.rbegin(); iter != chain.rend(); ++iter) {
+        AST::BinaryExpr *binary = *iter;
+        llvm::Constant *RHS = Evaluate(binary->rhs);
+        llvm::Value *result = CreateBinaryOp(binary->op, LHS, binary->lhs->isUnsigned, RHS, binary->rhs->isUnsigned,
+                                             binary->isUnsigned);
+
+        // 整数除以零和 INT_MIN / -1 被折叠为 poison
+        auto constant = llvm::dyn_cast<llvm::Constant>(result);
+        if (!constant)
+            throw std::logic_error("the expression cannot be folded");
+        if (llvm::isa<llvm::UndefValue>(constant) || constant->containsUndefOrPoisonElement())
+            throw std::logic_error("division by zero or signed overflow in division");
+        LHS = constant;
+    }
+    return LHS;
+}
+
+/**
+ * @brief 以常量实参调用纯函数，逐条解释执行函数体
+ * @param funcDef 被调用的函数定义
+ * @param args 实参表达式，在调用者的作用域中求值
+ * @return 函数的返回值
+ */
+llvm::Constant *ConstEvaluator::Call(AST::FuncDef *funcDef, AST::Args *args) {
+    const std::string &funcName = funcDef->funcName;
+    llvm::Type *retType = funcDef->returnType->GetLLVMType(this->context);
+    if (retType->isVoidTy())
+        throw std::logic_error(funcName + "() returns void");
+    // 只有原型的函数，以及流式编译时函数体已被释放的函数，都无法在编译期执行
+    if (!funcDef->funcBody)
+        throw std::logic_error(funcName + "() has no body available at compile time");
+    if (args->size() != funcDef->params->size())
+        throw std::logic_error(funcName + "() expects " + std::to_string(funcDef->params->size()) + " arguments");
+    if (this->frames.size() >= MaxCallDepth)
+        throw std::logic_error("calls are nested more than " + std::to_string(MaxCallDepth) + " levels deep");
+
+    TRACE(TraceLevel::Node, "Evaluating call to function " << funcName << "() at compile time...");
+
+    Scope params;
+    for (size_t i = 0; i < args->size(); ++i) {
+        AST::Param *param = (*funcDef->params)[i];
+        llvm::Type *paramType = param->paramType->GetLLVMType(this->context);
+        bool paramUnsigned = param->paramType->IsUnsigned();
+        params[param->paramName] = { paramType, paramUnsigned, Convert((*args)[i], paramType, paramUnsigned) };
+    }
+
+    this->frames.push_back({ params });
+    this->callStack.push_back(funcDef);
+    Execute(funcDef->funcBody);
+    this->callStack.pop_back();
+    this->frames.pop_back();
+
+    llvm::Constant *value = this->returnValue;
+    this->returnValue = nullptr;
+    if (!value)
+        throw std::logic_error(funcName + "() does not return a value");
+    return value;
+}
+
+/**
+ * @brief 解释执行一条语句，执行到 return 时记录返回值
+ */
+void ConstEvaluator::Execute(AST::Stmt *stmt) {
+    if (!stmt || this->returnValue)
+        return;
+    Step();
+
+    if (auto block = dynamic_cast<AST::Block *>(stmt)) {
+        this->frames.back().emplace_back();
+        for (auto s : *block->stmts)
+            Execute(s);
+        this->frames.back().pop_back();
+    }
+    else if (auto varDef = dynamic_cast<AST::VarDef *>(stmt)) {
+        if (varDef->typeSpecifier->isStruct)
+            throw std::logic_error("structs cannot be used in compile-time evaluation");
+        llvm::Type *type = varDef->typeSpecifier->GetLLVMType(this->context);
+        bool isUnsigned = varDef->typeSpecifier->IsUnsigned();
+        for (auto var : *varDef->varInitList) {
+            if (var->complexType)
+                throw std::logic_error("arrays and pointers cannot be used in compile-time evaluation");
+            DefineLocal(var->varName, type, isUnsigned, var->initExpr ? Convert(var->initExpr, type, isUnsigned) : nullptr);
+        }
+    }
+    else if (auto exprStmt = dynamic_cast<AST::ExprStmt *>(stmt))
+        Evaluate(exprStmt->expr);
+    else if (auto ifStmt = dynamic_cast<AST::IfStmt *>(stmt)) {
+        bool condition = EvaluateCondition(ifStmt->condition);
+        this->frames.back().emplace_back();
+        Execute(condition ? ifStmt->thenStmt : ifStmt->elseStmt);
+        this->frames.back().pop_back();
+    }
+    else if (dynamic_cast<AST::ParallelForStmt *>(stmt))
+        throw std::logic_error("parallel for cannot be evaluated at compile time");
+    else if (auto forStmt = dynamic_cast<AST::ForStmt *>(stmt)) {
+        this->frames.back().emplace_back();
+        Execute(forStmt->init);
+        while (!this->returnValue) {
+            Step();
+            if (forStmt->condition && !EvaluateCondition(forStmt->condition))
+                break;
+            Execute(forStmt->loopStmt);
+            if (!this->returnValue && forStmt->increment)
+                Evaluate(forStmt->increment);
+        }
+        this->frames.back().pop_back();
+    }
+    else if (auto returnStmt = dynamic_cast<AST::ReturnStmt *>(stmt)) {
+        if (!returnStmt->returnVal)
+            throw std::logic_error("return without a value");
+        AST::FuncDef *funcDef = this->callStack.back();
+        this->returnValue = Convert(returnStmt->returnVal, funcDef->returnType->GetLLVMType(this->context),
+                                    funcDef->returnType->IsUnsigned());
+    }
+    else if (!dynamic_cast<AST::EmptyStmt *>(stmt))
+        throw std::logic_error("the statement cannot be evaluated at compile time");
+}
+
+/**
+ * @brief 在当前函数的作用域栈中由内向外查找局部变量，不在被调用的函数中时返回空指针
+ */
+ConstEvaluator::LocalVar *ConstEvaluator::FindLocal(const std::string &varName) {
+    if (this->frames.empty())
+        return nullptr;
+    std::vector<Scope> &scopes = this->frames.back();
+    for (auto scope = scopes.rbegin(); scope != scopes.rend(); ++scope) {
+        auto iter = scope->find(varName);
+        if (iter != scope->end())
+            return &iter->second;
+    }
+    return nullptr;
+}
+
+void ConstEvaluator::DefineLocal(const std::string &varName, llvm::Type *type, bool isUnsigned, llvm::Constant *value) {
+    if (!this->frames.back().back().emplace(varName, LocalVar{ type, isUnsigned, value }).second)
+        throw std::logic_error("Refine variable " + varName);
+}
+
+/**
+ * @brief 对表达式求值，并与赋值、传参和返回一样隐式转换为目标类型
+ * @param expr 表达式
+ * @param type 目标类型
+ * @param toUnsigned 目标类型是否为无符号整型
+ */
+llvm::Constant *ConstEvaluator::Convert(AST::Expr *expr, llvm::Type *type, bool toUnsigned) {
+    llvm::Constant *value = Evaluate(expr);
+    if (value->getType() == type)
+        return value;
+    if (type->isVectorTy() || value->getType()->isVectorTy())
+        throw std::logic_error("cannot convert between a vector and another type");
+    return llvm::cast<llvm::Constant>(CastToType(value, expr->isUnsigned, type, toUnsigned));
+}
+
+/**
+ * @brief 对 if 和 for 的条件求值，与 CastToBool() 一样接受整型和浮点型的条件，
+ *        浮点数按 fcmp une 与零比较，即非零或 NaN 时为真
+ */
+bool ConstEvaluator::EvaluateCondition(AST::Expr *condition) {
+    llvm::Constant *value = Evaluate(condition);
+    if (auto integer = llvm::dyn_cast<llvm::ConstantInt>(value))
+        return !integer->isZero();
+    if (auto real = llvm::dyn_cast<llvm::ConstantFP>(value))
+        return !real->isZero();
+    throw std::logic_error("the condition is not an integer or a floating-point number");
+}
+
+/**
+ * @brief 记录执行的步数，超出上限时停止求值，避免编译器陷入死循环
+ */
+void ConstEvaluator::Step() {
+    if (++this->steps > MaxSteps)
+        throw std::logic_error("evaluation takes more than " + std::to_string(MaxSteps) + " steps");
+}
+
+/**
+ * @brief 在编译期对表达式求值，无法求值时报错
+ * @param context 代码生成上下文
+ * @param expr 表达式
+ * @param what 被求值的对象，用于错误信息，例如 "Initializer of const variable x"
+ * @return 表达式的值
+ */
+llvm::Constant *EvaluateConstant(CodeGenContext *context, AST::Expr *expr, const std::string &what) {
+    try {
+        return ConstEvaluator(context).Evaluate(expr);
+    }
+    catch (const std::logic_error &error) {
+        throw std::logic_error(what + " is not a compile-time constant: " + error.what());
+    }
+}
+
+#endif //CP_PROJECT_CONSTEVAL_HPP
@@ -0,0 +1,282 @@
+//
+// Created by Pei Yuhang on 2023/6/10.
+//
+
+#ifndef CP_PROJECT_DEBUGINFO_HPP
+#define CP_PROJECT_DEBUGINFO_HPP
+
+#include <map>
+
+#include <llvm/ADT/SmallString.h>
+#include <llvm/BinaryFormat/Dwarf.h>
+#include <llvm/IR/DebugInfo.h>
+#include <llvm/IR/DIBuilder.h>
+#include <llvm/Support/Path.h>
+
+#include "AST.h"
+#include "codegen.h"
+
+/*
+ * -g 生成的 DWARF 调试信息：行号表、函数，以及形参、局部变量和全局变量
+ *
+ * 每个语句、函数调用和赋值在生成代码时把 Builder 的调试位置设为节点的位置，子节点生成完毕后恢复，
+ * 因此指令的位置是包含它的最内层语句或表达式的位置。调试信息只描述一个作用域（函数），不区分函数中的块。
+ */
+class DebugInfo {
+public:
+    /**
+     * @brief 创建编译单元，源文件为 module 的源文件名，从标准输入读取时为 <stdin>
+     * @param module 生成代码的 module
+     * @param isOptimized 是否开启了优化
+     * @param locationsOnly 只为优化报告记录指令的源代码位置，不描述变量，也不写入目标文件
+     */
+    DebugInfo(llvm::Module *module, bool isOptimized, bool locationsOnly = false)
+            : module(module), builder(*module), locationsOnly(locationsOnly) {
+        std::string fileName = module->getSourceFileName() == "-" ? "<stdin>" : module->getSourceFileName();
+        llvm::SmallString<128> path(fileName);
+        llvm::sys::fs::make_absolute(path);
+        this->file = this->builder.createFile(llvm::sys::path::filename(path), llvm::sys::path::parent_path(path));
+        this->compileUnit = this->builder.createCompileUnit(llvm::dwarf::DW_LANG_C99, this->file, "CP_Project",
+                                                            isOptimized, "", 0, "",
+                                                            locationsOnly ? llvm::DICompileUnit::NoDebug
+                                                                          : llvm::DICompileUnit::FullDebug);
+
+        module->addModuleFlag(llvm::Module::Warning, "Dwarf Version", 4);
+        module->addModuleFlag(llvm::Module::Warning, "Debug Info Version", llvm::DEBUG_METADATA_VERSION);
+    }
+
+    /**
+     * @brief 获取类型说明符对应的调试信息类型，void 为空指针
+     */
+    llvm::DIType *GetType(AST::TypeSpecifier *type, CodeGenContext *context) {
+        if (type->isStruct)
+            return GetStructType(static_cast<AST::StructType *>(type), context);
+        llvm::Type *LLVMType = type->GetLLVMType(context);
+        if (LLVMType->isVoidTy())
+            return nullptr;
+        const uint64_t sizeInBits = this->module->getDataLayout().getTypeAllocSizeInBits(LLVMType);
+
+        if (type->isArr) {
+            auto arrType = static_cast<AST::ArrType *>(type);
+            if (arrType->IsSoA())
+                return GetSoAArrType(arrType, context);
+            return this->builder.createArrayType(sizeInBits, 0, GetType(arrType->elementType, context),
+                                                 this->builder.getOrCreateArray(
+                                                         { this->builder.getOrCreateSubrange(0, arrType->size) }));
+        }
+        if (type->isPtr) {
+            auto ptrType = static_cast<AST::PtrType *>(type);
+            return this->builder.createPointerType(GetType(ptrType->objectType, context), sizeInBits);
+        }
+
+        // 内置类型按名称缓存，向量类型的元素类型取同名的标量类型
+        const std::string typeName = type->GetTypeName();
+        auto iter = this->basicTypes.find(typeName);
+        if (iter != this->basicTypes.end())
+            return iter->second;
+
+        llvm::DIType *diType;
+        if (auto vectorType = llvm::dyn_cast<llvm::FixedVectorType>(LLVMType)) {
+            AST::BuiltInType *elementType = AST::TypeTable::GetBuiltInType(
+                    vectorType->getElementType()->isFloatTy() ? AST::BuiltInType::_FLOAT
+                    : vectorType->getElementType()->isDoubleTy() ? AST::BuiltInType::_DOUBLE : AST::BuiltInType::_INT);
+            diType = this->builder.createVectorType(sizeInBits, 0, GetType(elementType, context),
+                                                    this->builder.getOrCreateArray(
+                                                            { this->builder.getOrCreateSubrange(0, vectorType->getNumElements()) }));
+        } else {
+            unsigned encoding;
+            if (LLVMType->isIntegerTy(1))
+                encoding = llvm::dwarf::DW_ATE_boolean;
+            else if (LLVMType->isFloatingPointTy())
+                encoding = llvm::dwarf::DW_ATE_float;
+            else if (LLVMType->isIntegerTy(8))
+                encoding = type->IsUnsigned() ? llvm::dwarf::DW_ATE_unsigned_char : llvm::dwarf::DW_ATE_signed_char;
+            else
+                encoding = type->IsUnsigned() ? llvm::dwarf::DW_ATE_unsigned : llvm::dwarf::DW_ATE_signed;
+            diType = this->builder.createBasicType(typeName, sizeInBits, encoding);
+        }
+        this->basicTypes[typeName] = diType;
+        return diType;
+    }
+
+    /**
+     * @brief 获取结构体的调试信息类型，先缓存再描述成员，使成员可以是指向自身的指针；未定义的结构体只声明名称
+     */
+    llvm::DIType *GetStructType(AST::StructType *type, CodeGenContext *context) {
+        auto iter = this->structTypes.find(type);
+        if (iter != this->structTypes.end())
+            return iter->second;
+
+        if (!type->isDefined) {
+            llvm::DICompositeType *diType = this->builder.createForwardDecl(llvm::dwarf::DW_TAG_structure_type, type->name,
+                                                                            this->compileUnit, this->file, 0);
+            this->structTypes[type] = diType;
+            return diType;
+        }
+
+        auto LLVMType = llvm::cast<llvm::StructType>(type->GetLLVMType(context));
+        const llvm::DataLayout &dataLayout = this->module->getDataLayout();
+        llvm::DICompositeType *diType = this->builder.createStructType(
+                this->compileUnit, type->name, this->file, 0, dataLayout.getTypeAllocSizeInBits(LLVMType), 0,
+                llvm::DINode::FlagZero, nullptr, llvm::DINodeArray());
+        this->structTypes[type] = diType;
+
+        const llvm::StructLayout *layout = dataLayout.getStructLayout(LLVMType);
+        std::vector<llvm::Metadata *> members;
+        for (unsigned i = 0; i < type->members.size(); ++i)
+            members.push_back(this->builder.createMemberType(
+                    diType, type->members[i].name, this->file, 0,
+                    dataLayout.getTypeAllocSizeInBits(LLVMType->getElementType(i)), 0, layout->getElementOffsetInBits(i),
+                    llvm::DINode::FlagZero, GetType(type->members[i].type, context)));
+        this->builder.replaceArrays(diType, this->builder.getOrCreateArray(members));
+        return diType;
+    }
+
+    /**
+     * @brief SoA 布局的数组描述为与其 LLVM 类型一致的结构体，每个成员是对应成员的数组，调试器中以 a.x[i] 查看元素的成员
+     */
+    llvm::DIType *GetSoAArrType(AST::ArrType *type, CodeGenContext *context) {
+        auto LLVMType = llvm::cast<llvm::StructType>(type->GetLLVMType(context));
+        auto structType = static_cast<AST::StructType *>(type->elementType);
+        const llvm::DataLayout &dataLayout = this->module->getDataLayout();
+        const llvm::StructLayout *layout = dataLayout.getStructLayout(LLVMType);
+
+        llvm::DICompositeType *diType = this->builder.createStructType(
+                this->compileUnit, LLVMType->getName(), this->file, 0, dataLayout.getTypeAllocSizeInBits(LLVMType), 0,
+                llvm::DINode::FlagZero, nullptr, llvm::DINodeArray());
+        std::vector<llvm::Metadata *> members;
+        for (unsigned i = 0; i < structType->members.size(); ++i) {
+            const uint64_t sizeInBits = dataLayout.getTypeAllocSizeInBits(LLVMType->getElementType(i));
+            llvm::DIType *memberArray = this->builder.createArrayType(
+                    sizeInBits, 0, GetType(structType->members[i].type, context),
+                    this->builder.getOrCreateArray({ this->builder.getOrCreateSubrange(0, type->size) }));
+            members.push_back(this->builder.createMemberType(diType, structType->members[i].name, this->file, 0,
+                                                             sizeInBits, 0, layout->getElementOffsetInBits(i),
+                                                             llvm::DINode::FlagZero, memberArray));
+        }
+        this->builder.replaceArrays(diType, this->builder.getOrCreateArray(members));
+        return diType;
+    }
+
+    /**
+     * @brief 为函数创建 DISubprogram 并进入其作用域，Builder 的调试位置设为函数的位置
+     * @param func 函数
+     * @param location 函数定义的位置
+     * @param returnType 返回类型，为空指针时表示 void
+     * @param paramTypes 形参的类型
+     * @param isArtificial 是否为编译器生成的函数（如 parallel for 的循环体）
+     */
+    void BeginFunction(llvm::Function *func, AST::SourceLocation location, llvm::DIType *returnType,
+                       const std::vector<llvm::Metadata *> &paramTypes, bool isArtificial, CodeGenContext *context) {
+        std::vector<llvm::Metadata *> types({ returnType });
+        types.insert(types.end(), paramTypes.begin(), paramTypes.end());
+        llvm::DISubroutineType *funcType = this->builder.createSubroutineType(this->builder.getOrCreateTypeArray(types));
+
+        auto spFlags = llvm::DISubprogram::SPFlagDefinition;
+        if (context->GetOptLevel() > 0)
+            spFlags |= llvm::DISubprogram::SPFlagOptimized;
+        if (func->hasLocalLinkage())
+            spFlags |= llvm::DISubprogram::SPFlagLocalToUnit;
+        llvm::DISubprogram *subprogram = this->builder.createFunction(
+                this->file, func->getName(), func->getName(), this->file, location.line, funcType, location.line,
+                isArtificial ? llvm::DINode::FlagArtificial : llvm::DINode::FlagPrototyped, spFlags);
+        func->setSubprogram(subprogram);
+
+        this->scopes.emplace_back(subprogram, Builder.getCurrentDebugLocation());
+        SetLocation(location);
+    }
+
+    /**
+     * @brief 离开当前函数的作用域，恢复进入函数前 Builder 的调试位置
+     */
+    void EndFunction() {
+        this->builder.finalizeSubprogram(this->scopes.back().first);
+        Builder.SetCurrentDebugLocation(this->scopes.back().second);
+        this->scopes.pop_back();
+    }
+
+    /**
+     * @brief 将 Builder 的调试位置设为当前函数中的 location，不在函数中或位置未知时不改变
+     */
+    void SetLocation(AST::SourceLocation location) {
+        if (this->scopes.empty() || location.line == 0)
+            return;
+        llvm::DISubprogram *scope = this->scopes.back().first;
+        Builder.SetCurrentDebugLocation(llvm::DILocation::get(scope->getContext(), location.line, location.column, scope));
+    }
+
+    /**
+     * @brief 描述存储在 storage 中的形参或局部变量
+     * @param storage 变量的 alloca
+     * @param name 变量名
+     * @param type 变量的调试信息类型
+     * @param location 变量定义的位置
+     * @param argNo 形参的序号（从 1 开始），局部变量为 0
+     */
+    void DeclareLocalVar(llvm::AllocaInst *storage, const std::string &name, llvm::DIType *type,
+                         AST::SourceLocation location, unsigned argNo = 0) {
+        if (this->scopes.empty() || this->locationsOnly)
+            return;
+        llvm::DISubprogram *scope = this->scopes.back().first;
+        llvm::DILocalVariable *var = argNo
+                ? this->builder.createParameterVariable(scope, name, argNo, this->file, location.line, type, true)
+                : this->builder.createAutoVariable(scope, name, this->file, location.line, type, true);
+        this->builder.insertDeclare(storage, var, this->builder.createExpression(),
+                                    llvm::DILocation::get(scope->getContext(), location.line, location.column, scope),
+                                    storage->getParent());
+    }
+
+    /**
+     * @brief 描述全局变量，在函数中定义的 const 变量以函数为作用域
+     */
+    void DeclareGlobalVar(llvm::GlobalVariable *global, const std::string &name, llvm::DIType *type,
+                          AST::SourceLocation location) {
+        if (this->locationsOnly)
+            return;
+        llvm::DIScope *scope = this->scopes.empty() ? static_cast<llvm::DIScope *>(this->compileUnit)
+                                                    : this->scopes.back().first;
+        global->addDebugInfo(this->builder.createGlobalVariableExpression(scope, name, global->getName(), this->file,
+                                                                          location.line, type,
+                                                                          global->hasLocalLinkage()));
+    }
+
+    /**
+     * @brief 完成调试信息的生成，须在代码生成结束后、优化和输出之前调用
+     */
+    void Finalize() { this->builder.finalize(); }
+
+private:
+    llvm::Module *module;
+    llvm::DIBuilder builder;
+    llvm::DIFile *file;
+    llvm::DICompileUnit *compileUnit;
+    bool locationsOnly;     // 是否只记录源代码位置
+    std::map<std::string, llvm::DIType *> basicTypes;   // 内置类型的调试信息类型，键为类型名
+    std::map<AST::StructType *, llvm::DIType *> structTypes;    // 结构体的调试信息类型
+    // 函数作用域的栈：parallel for 的循环体函数在外层函数的代码生成过程中生成，第二项为进入函数前 Builder 的调试位置
+    std::vector<std::pair<llvm::DISubprogram *, llvm::DebugLoc>> scopes;
+};
+
+/**
+ * @brief 在作用域内将 Builder 的调试位置设为节点的位置，离开作用域时恢复，未开启 -g 时不做任何事
+ */
+class DebugLocationScope {
+public:
+    DebugLocationScope(CodeGenContext *context, AST::Node *node) : debugInfo(context->GetDebugInfo()) {
+        if (this->debugInfo) {
+            this->outerLocation = Builder.getCurrentDebugLocation();
+            this->debugInfo->SetLocation(node->location);
+        }
+    }
+
+    ~DebugLocationScope() {
+        if (this->debugInfo)
+            Builder.SetCurrentDebugLocation(this->outerLocation);
+    }
+
+private:
+    DebugInfo *debugInfo;
+    llvm::DebugLoc outerLocation;
+};
+
+#endif //CP_PROJECT_DEBUGINFO_HPP
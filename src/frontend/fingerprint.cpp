@@ -0,0 +1,132 @@
+//
+// Created by Pei Yuhang on 2023/6/6.
+//
+
+#include <algorithm>
+#include <set>
+
+#include <llvm/Support/MD5.h>
+
+#include "fingerprint.h"
+
+/**
+ * @brief 计算若干段文本的 MD5 摘要，各段之间以 '\0' 分隔，避免不同的切分得到相同的摘要
+ */
+static std::string Digest(std::initializer_list<llvm::StringRef> parts) {
+    llvm::MD5 hash;
+    for (llvm::StringRef part : parts) {
+        hash.update(part);
+        hash.update(llvm::StringRef("", 1));
+    }
+    llvm::MD5::MD5Result result;
+    hash.final(result);
+    return result.digest().str().str();
+}
+
+/**
+ * @brief 拼接在编译期求值时可能被执行的函数的源代码，即 roots 以及它们直接或间接调用的所有函数
+ * @param roots 在编译期求值的表达式直接调用的函数名称
+ * @param funcDefs 函数名到函数定义的映射
+ */
+static std::string EvaluatedFuncText(const std::vector<std::string> &roots,
+                                     const std::map<std::string, AST::FuncDef *> &funcDefs) {
+    std::set<std::string> visited;
+    std::vector<std::string> pending(roots.begin(), roots.end());
+    while (!pending.empty()) {
+        std::string funcName = pending.back();
+        pending.pop_back();
+        auto iter = funcDefs.find(funcName);
+        if (iter == funcDefs.end() || !visited.insert(funcName).second)
+            continue;
+        pending.insert(pending.end(), iter->second->callees.begin(), iter->second->callees.end());
+    }
+
+    std::string text;
+    for (const auto &funcName : visited) {
+        AST::FuncDef *funcDef = funcDefs.at(funcName);
+        text += funcName + ":" + SourceText.substr(funcDef->sourceBegin, funcDef->sourceEnd - funcDef->sourceBegin) + ";";
+    }
+    return text;
+}
+
+/**
+ * @brief 将源代码中的字节偏移转换为行号，lineStarts 为各行起始位置的偏移
+ */
+static size_t LineAt(const std::vector<size_t> &lineStarts, size_t offset) {
+    return std::upper_bound(lineStarts.begin(), lineStarts.end(), offset) - lineStarts.begin();
+}
+
+/**
+ * @brief 为增量编译计算每个用户函数和公共单元的指纹
+ *
+ * 函数的指纹由函数定义的源代码、它调用的每个函数的签名、全局定义的源代码以及 salt 共同决定，
+ * 因此只修改某个函数的函数体时，只有它自己的指纹改变；修改函数签名时，调用它的函数也会重新编译。
+ * 全局定义（函数定义以外的源代码）改变时，所有单元都会重新编译。
+ * const 变量的初始值和数组长度在编译期求值，其结果取决于被调用函数的函数体，因此这些函数的源代码也计入指纹。
+ * 生成调试信息时目标文件中记录了行号，因此函数的起止行号计入其指纹，各函数的行范围（决定全局定义所在的行）计入公共单元的指纹。
+ *
+ * @param root 抽象语法树的根节点
+ * @param salt 影响生成代码的编译选项和编译器版本，不同的 salt 不会共用缓存
+ * @param withLineNumbers 指纹是否包含行号
+ * @return 各编译单元的指纹
+ */
+Fingerprints ComputeFingerprints(AST::Prog *root, const std::string &salt, bool withLineNumbers) {
+    std::vector<AST::FuncDef *> funcDefs;
+    std::map<std::string, AST::FuncDef *> funcDefsByName;
+    for (auto unit : *root->units)
+        // 函数原型属于全局定义，其改变会使所有单元重新编译
+        if (auto funcDef = dynamic_cast<AST::FuncDef *>(unit); funcDef && !funcDef->isPrototype) {
+            funcDefs.push_back(funcDef);
+            funcDefsByName[funcDef->funcName] = funcDef;
+        }
+
+    // 全局定义的源代码：去掉所有函数定义后剩余的部分
+    std::string globalText;
+    size_t offset = 0;
+    for (auto funcDef : funcDefs) {
+        globalText.append(SourceText, offset, funcDef->sourceBegin - offset);
+        offset = funcDef->sourceEnd;
+    }
+    globalText.append(SourceText, offset, std::string::npos);
+
+    // 每个用户函数的签名
+    std::map<std::string, llvm::StringRef> signatures;
+    for (auto funcDef : funcDefs)
+        signatures[funcDef->funcName] =
+                llvm::StringRef(SourceText).slice(funcDef->sourceBegin, funcDef->signatureEnd);
+
+    // 每个用户函数的起止行号
+    std::map<std::string, std::string> funcLines;
+    std::string allFuncLines;
+    if (withLineNumbers) {
+        std::vector<size_t> lineStarts({ 0 });
+        for (size_t i = 0; i < SourceText.size(); ++i)
+            if (SourceText[i] == '\n')
+                lineStarts.push_back(i + 1);
+        for (auto funcDef : funcDefs) {
+            std::string &lines = funcLines[funcDef->funcName];
+            lines = std::to_string(LineAt(lineStarts, funcDef->sourceBegin)) + "-"
+                    + std::to_string(LineAt(lineStarts, funcDef->sourceEnd));
+            allFuncLines += funcDef->funcName + ":" + lines + ";";
+        }
+    }
+
+    Fingerprints fingerprints;
+    const std::string globalDigest = Digest({ salt, globalText, EvaluatedFuncText(root->constCallees, funcDefsByName) });
+    fingerprints.common = Digest({ "common", globalDigest, allFuncLines });
+
+    for (auto funcDef : funcDefs) {
+        // 被调用函数的签名依次拼接；内置函数没有源代码，其变化由 salt 中的编译器版本体现
+        std::string calleeSignatures;
+        for (const auto &callee : funcDef->callees) {
+            auto iter = signatures.find(callee);
+            calleeSignatures += callee + ":" + (iter == signatures.end() ? "builtin" : iter->second.str()) + ";";
+        }
+        llvm::StringRef funcText = llvm::StringRef(SourceText).slice(funcDef->sourceBegin, funcDef->sourceEnd);
+        fingerprints.funcs[funcDef->funcName] =
+                Digest({ "func", globalDigest, funcDef->funcName, funcText, calleeSignatures,
+                         EvaluatedFuncText(funcDef->constCallees, funcDefsByName), funcLines[funcDef->funcName] });
+    }
+
+    return fingerprints;
+}
@@ -0,0 +1,24 @@
+//
+// Created by Pei Yuhang on 2023/6/6.
+//
+
+#ifndef CP_PROJECT_FINGERPRINT_H
+#define CP_PROJECT_FINGERPRINT_H
+
+#include <map>
+#include <string>
+
+#include "AST.h"
+
+// 词法分析器读入的全部源代码，FuncDef 中记录的字节偏移都相对于它
+extern std::string SourceText;
+
+/* 增量编译中各编译单元的指纹 */
+struct Fingerprints {
+    std::string common;                         // 公共单元（内置函数和全局定义）的指纹
+    std::map<std::string, std::string> funcs;   // 每个用户函数的指纹，键为函数名
+};
+
+Fingerprints ComputeFingerprints(AST::Prog *root, const std::string &salt, bool withLineNumbers = false);
+
+#endif //CP_PROJECT_FINGERPRINT_H
@@ -5,6 +5,7 @@
 #include <iostream>
 #include "codegen.h"
 #include "AST.h"
+#include "timer.h"
 
 /**
  * @brief 创建一个在 LLVM IR 中可以调用的 printf 函数，用于定义其他基本输出函数
@@ -227,6 +228,70 @@ void CreatePrintIntFunc(CodeGenContext *context, llvm::Function *printfFunc) {
     context->PopBasicBlock();
 }
 
+/**
+ * @brief 创建一个打印 long、unsigned int 或 unsigned long 类型的函数，与 printInt() 一样在末尾换行
+ * @param context 上下文
+ * @param printfFunc 可调用的 printf 函数
+ * @param funcName 函数名称
+ * @param argType 形参的类型
+ * @param format printf() 的输出格式
+ */
+void CreatePrintIntegerFunc(CodeGenContext *context, llvm::Function *printfFunc, const std::string &funcName,
+                            llvm::Type *argType, const std::string &format) {
+    llvm::FunctionType *funcType = llvm::FunctionType::get(llvm::Type::getVoidTy(Context), { argType }, false);
+    llvm::Function *func =
+            llvm::Function::Create(funcType, llvm::Function::ExternalLinkage, llvm::Twine(funcName), context->module);
+
+    llvm::BasicBlock *basicBlock = llvm::BasicBlock::Create(Context, funcName + "_entry", func, 0);
+    context->PushBasicBlock(basicBlock);
+
+    // 输出格式参数存储在私有的全局常量中
+    llvm::Constant *formatStr = llvm::ConstantDataArray::getString(Context, format);
+    llvm::GlobalVariable *formatVar = new llvm::GlobalVariable(*context->module, formatStr->getType(), true,
+                                                               llvm::GlobalValue::PrivateLinkage, formatStr,
+                                                               "." + funcName + "FormatStr");
+
+    llvm::Value *valueToPrint = func->arg_begin();
+    valueToPrint->setName("valueToPrint");
+
+    std::vector<llvm::Value *> printfArgs({ formatVar, valueToPrint });
+    llvm::CallInst::Create(printfFunc, llvm::ArrayRef(printfArgs), "", basicBlock);
+    llvm::ReturnInst::Create(Context, basicBlock);
+
+    context->PopBasicBlock();
+}
+
+/**
+ * @brief 创建一个打印 float 类型的函数，printf() 的可变参数只接受 double，因此先扩展为 double 再输出
+ * @param context 上下文
+ * @param printfFunc 可调用的 printf 函数
+ */
+void CreatePrintFloatFunc(CodeGenContext *context, llvm::Function *printfFunc) {
+    llvm::FunctionType *funcType =
+            llvm::FunctionType::get(llvm::Type::getVoidTy(Context), { llvm::Type::getFloatTy(Context) }, false);
+    llvm::Function *func =
+            llvm::Function::Create(funcType, llvm::Function::ExternalLinkage, llvm::Twine("printFloat"), context->module);
+
+    llvm::BasicBlock *basicBlock = llvm::BasicBlock::Create(Context, "printFloat_entry", func, 0);
+    context->PushBasicBlock(basicBlock);
+
+    // 与 printDouble() 使用相同的输出格式
+    llvm::Constant *formatStr = llvm::ConstantDataArray::getString(Context, "%lf\n");
+    llvm::GlobalVariable *formatVar = new llvm::GlobalVariable(*context->module, formatStr->getType(), true,
+                                                               llvm::GlobalValue::PrivateLinkage, formatStr,
+                                                               ".printFloatFormatStr");
+
+    llvm::Value *floatToPrint = func->arg_begin();
+    floatToPrint->setName("floatToPrint");
+    llvm::Value *doubleToPrint = new llvm::FPExtInst(floatToPrint, llvm::Type::getDoubleTy(Context), "", basicBlock);
+
+    std::vector<llvm::Value *> printfArgs({ formatVar, doubleToPrint });
+    llvm::CallInst::Create(printfFunc, llvm::ArrayRef(printfArgs), "", basicBlock);
+    llvm::ReturnInst::Create(Context, basicBlock);
+
+    context->PopBasicBlock();
+}
+
 /**
  * @brief 创建一个打印字符串常量类型的函数
  * @param context 上下文
@@ -282,10 +347,16 @@ void CreatePrintConstStringFunc(CodeGenContext *context, llvm::Function *printfF
  * @param context 上下文
  */
 void CreateIOFunc(CodeGenContext *context) {
+    PhaseTimer timer("builtins");
+
     llvm::Function *printfFunc = CreatePrintfFunc(context);
     CreatePrintDoubleFunc(context, printfFunc);
+    CreatePrintFloatFunc(context, printfFunc);
     CreatePrintBoolFunc(context, printfFunc);
     CreatePrintCharFunc(context, printfFunc);
     CreatePrintIntFunc(context, printfFunc);
+    CreatePrintIntegerFunc(context, printfFunc, "printLong", llvm::Type::getInt64Ty(Context), "%ld\n");
+    CreatePrintIntegerFunc(context, printfFunc, "printUnsigned", llvm::Type::getInt32Ty(Context), "%u\n");
+    CreatePrintIntegerFunc(context, printfFunc, "printUnsignedLong", llvm::Type::getInt64Ty(Context), "%lu\n");
     CreatePrintConstStringFunc(context, printfFunc);
 }
\ No newline at end of file
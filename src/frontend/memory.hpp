@@ -0,0 +1,250 @@
+//
+// Created by Pei Yuhang on 2023/6/12.
+//
+
+#ifndef CP_PROJECT_MEMORY_HPP
+#define CP_PROJECT_MEMORY_HPP
+
+#include <set>
+
+#include <llvm/Analysis/ValueTracking.h>
+
+#include "AST.h"
+#include "boundscheck.hpp"
+#include "codegen.h"
+#include "consteval.hpp"
+#include "type.hpp"
+#include "util.hpp"
+
+/*
+ * 内存内置函数：整体复制、清零或填充数组，展开为 LLVM 的 memcpy、memset 内置函数，
+ * 字节数和对齐由数组的类型决定，后端据此选择 rep movsb 或宽向量存储，而不是逐个元素取数和存数
+ *
+ * 实参须是变量、数组元素或结构体成员等有地址的表达式；可选的元素个数 n 按第一维计数，为常量时在编译期检查不超过数组的长度，
+ * 否则在 -fbounds-check 时于运行时检查。SoA 布局的数组各成员的数组分别处理。数组的整体赋值 a = b 同样展开为 memcpy。
+ */
+
+/**
+ * @brief 判断 funcName 是否为内存内置函数
+ */
+bool IsMemoryBuiltin(const std::string &funcName) {
+    static const std::set<std::string> builtins = { "memcpy", "memset", "fill" };
+    return builtins.count(funcName) > 0;
+}
+
+/**
+ * @brief 获取数组的长度，SoA 布局的数组取其元素个数，不是数组时为 0
+ */
+uint64_t GetArrayLength(llvm::Type *type) {
+    if (AST::ArrType *soaType = AST::TypeTable::FindSoAArrType(type))
+        return soaType->size;
+    return type->isArrayTy() ? type->getArrayNumElements() : 0;
+}
+
+/**
+ * @brief 将数组拆分为连续存放的部分：普通数组只有一部分，SoA 布局的数组每个成员的数组为一部分
+ * @param ptr 数组的地址
+ * @param type 数组的 LLVM 类型
+ * @return 各部分的地址与类型
+ */
+std::vector<std::pair<llvm::Value *, llvm::ArrayType *>> GetArrayParts(llvm::Value *ptr, llvm::Type *type) {
+    std::vector<std::pair<llvm::Value *, llvm::ArrayType *>> parts;
+    if (AST::TypeTable::FindSoAArrType(type)) {
+        for (unsigned i = 0; i < type->getStructNumElements(); ++i)
+            parts.emplace_back(Builder.CreateStructGEP(type, ptr, i),
+                               llvm::cast<llvm::ArrayType>(type->getStructElementType(i)));
+    } else
+        parts.emplace_back(ptr, llvm::cast<llvm::ArrayType>(type));
+    return parts;
+}
+
+/**
+ * @brief 把类型为 type 的对象从 src 整体复制到 dst
+ */
+llvm::CallInst *CreateObjectCopy(CodeGenContext *context, llvm::Value *dst, llvm::Value *src, llvm::Type *type) {
+    const llvm::DataLayout &dataLayout = context->module->getDataLayout();
+    const llvm::Align align = dataLayout.getABITypeAlign(type);
+    return Builder.CreateMemCpy(dst, align, src, align, dataLayout.getTypeAllocSize(type));
+}
+
+/**
+ * @brief 获取内置函数实参的地址，LLVM 类型由 type 返回
+ * @param isWritten 是否写入该实参，const 变量不能写入
+ */
+llvm::Value *CodeGenObjectPtr(CodeGenContext *context, AST::Expr *arg, bool isWritten, llvm::Type *&type,
+                              const std::string &funcName) {
+    llvm::Value *ptr = arg->CodeGenPtr(context);
+    if (isWritten && IsConstVar(ptr->stripInBoundsOffsets()))
+        throw std::logic_error("Cannot write to a const variable with " + funcName + "()");
+    type = GetPtrElementType(ptr);
+    return ptr;
+}
+
+/**
+ * @brief 对元素个数求值并扩展为 64 位，检查其在 [0, size] 之内
+ * @param size 数组的长度
+ * @param location 内置函数调用的位置
+ */
+llvm::Value *CodeGenCount(CodeGenContext *context, AST::Expr *countExpr, uint64_t size, const std::string &funcName,
+                          AST::SourceLocation location) {
+    llvm::Value *count = countExpr->CodeGen(context);
+    if (!count->getType()->isIntegerTy())
+        throw std::logic_error("Element count of " + funcName + "() is not an integer");
+    count = countExpr->isUnsigned || count->getType()->isIntegerTy(1)
+            ? Builder.CreateZExtOrTrunc(count, Builder.getInt64Ty())
+            : Builder.CreateSExtOrTrunc(count, Builder.getInt64Ty());
+
+    if (auto constCount = llvm::dyn_cast<llvm::ConstantInt>(count)) {
+        if (constCount->isNegative() || constCount->getZExtValue() > size)
+            throw std::logic_error(funcName + "() count " + std::to_string(constCount->getSExtValue())
+                                   + " is out of range for an array of " + std::to_string(size) + " elements");
+        return count;
+    }
+
+    // 无符号比较同时排除了负数
+    if (context->IsBoundsCheckEnabled())
+        CreateBoundsCheckBranch(context, Builder.CreateICmpULE(count, Builder.getInt64(size)), [&]() {
+            llvm::Type *int8PtrType = llvm::Type::getInt8PtrTy(Context);
+            llvm::FunctionCallee failure = GetBoundsFailureFunc(
+                    context, "cp_length_check_failed",
+                    { int8PtrType, int8PtrType, Builder.getInt64Ty(), Builder.getInt64Ty() });
+            Builder.CreateCall(failure, { CreateLocationString(context, location),
+                                          Builder.CreateGlobalStringPtr(funcName, "bounds.func"),
+                                          count, Builder.getInt64(size) });
+        });
+    return count;
+}
+
+/**
+ * @brief 生成把 value 依次存入 base 开始的 total 个元素的循环，total 为 0 时不进入循环；-O2 时循环被向量化为宽向量存储
+ * @return 循环中的存储指令
+ */
+llvm::Value *CreateFillLoop(CodeGenContext *context, llvm::Value *base, llvm::Type *elementType, llvm::Value *value,
+                            llvm::Value *total) {
+    llvm::Function *currentFunc = context->GetCurrentFunc();
+    llvm::BasicBlock *entryBB = Builder.GetInsertBlock();
+    llvm::BasicBlock *loopBB = llvm::BasicBlock::Create(Context, "fill.loop");
+    llvm::BasicBlock *endBB = llvm::BasicBlock::Create(Context, "fill.end");
+    Builder.CreateCondBr(Builder.CreateICmpEQ(total, Builder.getInt64(0)), endBB, loopBB);
+
+    InsertFuncBasicBlockList(currentFunc, loopBB);
+    Builder.SetInsertPoint(loopBB);
+    llvm::PHINode *index = Builder.CreatePHI(Builder.getInt64Ty(), 2, "fill.index");
+    index->addIncoming(Builder.getInt64(0), entryBB);
+    llvm::Value *store = Builder.CreateStore(value, Builder.CreateInBoundsGEP(elementType, base, index));
+    llvm::Value *next = Builder.CreateNUWAdd(index, Builder.getInt64(1));
+    index->addIncoming(next, loopBB);
+    Builder.CreateCondBr(Builder.CreateICmpULT(next, total), loopBB, endBB);
+
+    InsertFuncBasicBlockList(currentFunc, endBB);
+    Builder.SetInsertPoint(endBB);
+    return store;
+}
+
+/**
+ * @brief 为内存内置函数生成代码
+ *
+ *  - memcpy(dst, src)：把 src 整体复制到 dst，两者的类型必须相同
+ *  - memcpy(dst, src, n)：dst、src 为元素类型相同的数组，只复制前 n 个元素
+ *  - memset(a, c) / memset(a, c, n)：把 a（或数组的前 n 个元素）的每个字节设为 c 的低 8 位
+ *  - fill(a, x) / fill(a, x, n)：把数组（或前 n 个元素）中的每个元素设为 x，多维数组为最内层的每个元素；
+ *    x 的各字节都相同时（如 0、-1）展开为 memset，否则生成存储循环
+ *
+ * @param context 代码生成上下文
+ * @param funcName 内置函数名称
+ * @param args 实参表达式
+ * @param location 内置函数调用的位置
+ * @return 最后生成的 memcpy、memset 调用或存储指令，与 void 函数的调用一样没有值
+ */
+llvm::Value *CodeGenMemoryBuiltin(CodeGenContext *context, const std::string &funcName, const AST::Args &args,
+                                  AST::SourceLocation location) {
+    if (args.size() != 2 && args.size() != 3)
+        throw std::logic_error(funcName + "() expects 2 or 3 arguments");
+    const llvm::DataLayout &dataLayout = context->module->getDataLayout();
+
+    llvm::Type *type;
+    llvm::Value *ptr = CodeGenObjectPtr(context, args[0], true, type, funcName);
+    const bool isArrayUnsigned = args[0]->isUnsigned;
+    const uint64_t size = GetArrayLength(type);
+    if (args.size() == 3 && size == 0)
+        throw std::logic_error("The first argument of " + funcName + "() with an element count should be an array");
+
+    if (funcName == "memcpy") {
+        llvm::Type *srcType;
+        llvm::Value *srcPtr = CodeGenObjectPtr(context, args[1], false, srcType, funcName);
+        if (args.size() == 2) {
+            if (srcType != type)
+                throw std::logic_error("Arguments of memcpy() should have the same type");
+            return CreateObjectCopy(context, ptr, srcPtr, type);
+        }
+
+        // 按元素个数复制时两个数组的长度可以不同，但各部分的元素类型必须相同
+        auto parts = GetArrayParts(ptr, type);
+        const uint64_t srcSize = GetArrayLength(srcType);
+        auto srcParts = srcSize ? GetArrayParts(srcPtr, srcType) : decltype(parts)();
+        bool isSameElement = parts.size() == srcParts.size()
+                && (AST::TypeTable::FindSoAArrType(type) == nullptr) == (AST::TypeTable::FindSoAArrType(srcType) == nullptr);
+        for (size_t i = 0; isSameElement && i < parts.size(); ++i)
+            isSameElement = parts[i].second->getElementType() == srcParts[i].second->getElementType();
+        if (!isSameElement)
+            throw std::logic_error("Arguments of memcpy() should be arrays of the same element type");
+
+        llvm::Value *count = CodeGenCount(context, args[2], std::min(size, srcSize), funcName, location);
+        llvm::Value *result = nullptr;
+        for (size_t i = 0; i < parts.size(); ++i) {
+            llvm::Type *elementType = parts[i].second->getElementType();
+            const llvm::Align align = dataLayout.getABITypeAlign(elementType);
+            result = Builder.CreateMemCpy(parts[i].first, align, srcParts[i].first, align,
+                                 Builder.CreateNUWMul(count, Builder.getInt64(dataLayout.getTypeAllocSize(elementType))));
+        }
+        return result;
+    }
+
+    if (funcName == "memset") {
+        llvm::Value *byte = args[1]->CodeGen(context);
+        if (!byte->getType()->isIntegerTy())
+            throw std::logic_error("The value of memset() should be an integer");
+        byte = Builder.CreateZExtOrTrunc(byte, Builder.getInt8Ty());
+        if (args.size() == 2)
+            return Builder.CreateMemSet(ptr, byte, dataLayout.getTypeAllocSize(type), dataLayout.getABITypeAlign(type));
+
+        llvm::Value *count = CodeGenCount(context, args[2], size, funcName, location);
+        llvm::Value *result = nullptr;
+        for (auto &part : GetArrayParts(ptr, type)) {
+            llvm::Type *elementType = part.second->getElementType();
+            result = Builder.CreateMemSet(part.first, byte,
+                                 Builder.CreateNUWMul(count, Builder.getInt64(dataLayout.getTypeAllocSize(elementType))),
+                                 dataLayout.getABITypeAlign(elementType));
+        }
+        return result;
+    }
+
+    // fill：求出最内层元素的类型和每个第一维元素包含的最内层元素个数
+    if (!type->isArrayTy())
+        throw std::logic_error("The first argument of fill() should be an array");
+    llvm::Type *elementType = type->getArrayElementType();
+    uint64_t innerCount = 1;
+    while (elementType->isArrayTy()) {
+        innerCount *= elementType->getArrayNumElements();
+        elementType = elementType->getArrayElementType();
+    }
+    if (elementType->isStructTy())
+        throw std::logic_error("fill() expects an array of scalars or vectors");
+
+    llvm::Value *value = CastToType(args[1]->CodeGen(context), args[1]->isUnsigned, elementType, isArrayUnsigned);
+    llvm::Value *count = args.size() == 3 ? CodeGenCount(context, args[2], size, funcName, location)
+                                          : Builder.getInt64(size);
+    llvm::Value *total = Builder.CreateNUWMul(count, Builder.getInt64(innerCount));
+    const llvm::Align align = dataLayout.getABITypeAlign(elementType);
+
+    // 各字节相同的常量（如 0、-1、0.0）直接展开为 memset
+    if (auto constValue = llvm::dyn_cast<llvm::Constant>(value))
+        if (llvm::Value *byte = llvm::isBytewiseValue(constValue, dataLayout); byte && !llvm::isa<llvm::UndefValue>(byte))
+            return Builder.CreateMemSet(ptr, byte,
+                                        Builder.CreateNUWMul(total, Builder.getInt64(dataLayout.getTypeAllocSize(elementType))),
+                                        align);
+
+    return CreateFillLoop(context, Builder.CreateBitCast(ptr, elementType->getPointerTo()), elementType, value, total);
+}
+
+#endif //CP_PROJECT_MEMORY_HPP
@@ -1,29 +1,130 @@
+%code requires {
+
+#include <cstddef>
+
+/* 语法符号在源代码中的位置，除行列号外还记录字节偏移，用于取出函数定义的源代码 */
+struct YYLTYPE {
+    int first_line;
+    int first_column;
+    int last_line;
+    int last_column;
+    size_t first_offset;    // 起始字节偏移
+    size_t last_offset;     // 结束字节偏移（不含）
+};
+#define YYLTYPE_IS_DECLARED 1
+#define YYLTYPE_IS_TRIVIAL 1
+
+/* 整数字面量的值与类型，类型由 U、L 后缀和值的大小决定 */
+struct IntegerLiteral {
+    unsigned long long value;
+    bool isLong;
+    bool isUnsigned;
+};
+
+/* 实数字面量的值与类型，带有 F 后缀时为 float，否则为 double */
+struct RealLiteral {
+    double value;
+    bool isFloat;
+};
+
+}
+
 %{
 
 #include <cstdio>
 #include <cstdlib>
+#include <functional>
+#include <set>
 
 #include "AST.h"
 #include "codegen.h"
 
+/*
+ * 产生式的位置从第一个符号的起始位置到最后一个符号的结束位置，空产生式取前一个符号的结束位置；
+ * 同时记录在 AST::CurrentLocation 中，使语义动作中创建的节点得到产生式的起始位置
+ */
+#define YYLLOC_DEFAULT(Current, Rhs, N)                                         \
+    do {                                                                        \
+        if (N) {                                                                \
+            (Current).first_line = YYRHSLOC(Rhs, 1).first_line;                 \
+            (Current).first_column = YYRHSLOC(Rhs, 1).first_column;             \
+            (Current).first_offset = YYRHSLOC(Rhs, 1).first_offset;             \
+            (Current).last_line = YYRHSLOC(Rhs, N).last_line;                   \
+            (Current).last_column = YYRHSLOC(Rhs, N).last_column;               \
+            (Current).last_offset = YYRHSLOC(Rhs, N).last_offset;               \
+        } else {                                                                \
+            (Current).first_line = (Current).last_line = YYRHSLOC(Rhs, 0).last_line;            \
+            (Current).first_column = (Current).last_column = YYRHSLOC(Rhs, 0).last_column;      \
+            (Current).first_offset = (Current).last_offset = YYRHSLOC(Rhs, 0).last_offset;      \
+        }                                                                       \
+        AST::CurrentLocation.line = (Current).first_line;                       \
+        AST::CurrentLocation.column = (Current).first_column;                   \
+    } while (0)
+
 extern int yylex(void);
 void yyerror(const char *str) {
-    std::cout << "Error: " << str << std::endl;
+    std::cerr << "Error: " << str << std::endl;
     exit(1);
 }
 
 AST::Prog *Root;
 
+AST::SourceLocation AST::CurrentLocation;
+
 AST::TypeSpecifier *CurrentBaseType;
 
 std::string *CurrentVarName;
 
+std::set<std::string> CurrentCallees;   // 当前函数定义中调用的函数名称
+
+std::set<std::string> CurrentConstCallees;  // 当前函数定义中在编译期求值的表达式调用的函数名称
+
+std::set<std::string> GlobalConstCallees;   // 全局变量定义中调用的函数名称，全局变量的初始值都在编译期求值
+
+int ConstContextDepth = 0;  // 大于零时正在分析 const 变量定义或数组长度
+
+std::function<void(AST::Unit *)> UnitHandler;  // 流式编译时处理每个顶层单元的回调，为空时构建完整的 AST
+
+/* 流式编译时把归约出的单元立即交给回调，否则加入单元列表 */
+static void AddUnit(AST::Units *units, AST::Unit *unit) {
+    if (UnitHandler)
+        UnitHandler(unit);
+    else
+        units->push_back(unit);
+}
+
+/* 把结构体定义中的一个成员定义加入成员列表，成员不能是 const，也不能有初始值 */
+static void AddMembers(AST::StructType::Members *members, AST::VarDef *varDef) {
+    if (varDef->isConst)
+        yyerror("struct member cannot be const");
+    for (auto var : *varDef->varInitList) {
+        if (var->initExpr)
+            yyerror(("struct member " + var->varName + " cannot have an initializer").c_str());
+        members->push_back({ var->complexType ? var->complexType : varDef->typeSpecifier, var->varName });
+    }
+    delete varDef;
+}
+
+/* 为类型表中的结构体类型设置成员，每个结构体只能定义一次 */
+static AST::StructDef *DefineStruct(const std::string &name, AST::StructType::Members *members, bool isSoA) {
+    AST::StructType *structType = AST::TypeTable::GetStructType(name);
+    if (structType->isDefined)
+        yyerror(("redefinition of struct " + name).c_str());
+    structType->members = std::move(*members);
+    structType->isSoA = isSoA;
+    structType->isDefined = true;
+    delete members;
+    return new AST::StructDef(structType);
+}
+
+
 %}
 
 %union {
     char charVal;
     int intVal;
-    double doubleVal;
+    IntegerLiteral integerVal;
+    RealLiteral realVal;
     std::string *strVal;
     std::string *identifier;
 
@@ -42,11 +143,14 @@ std::string *CurrentVarName;
     AST::VarDef *varDef;
     AST::VarInit *varInit;
     AST::VarInitList *varInitList;
+    AST::StructDef *structDef;
+    AST::StructType::Members *members;
 
     AST::TypeSpecifier *typeSpecifier;
     AST::BuiltInType *builtInType;
     AST::ArrType *arrType;
     AST::PtrType *ptrType;
+    AST::Declarator *declarator;
 
     AST::Stmt *stmt;
     AST::Stmts *stmts;
@@ -54,11 +158,13 @@ std::string *CurrentVarName;
     AST::ExprStmt *exprStmt;
     AST::IfStmt *ifStmt;
     AST::ForStmt *forStmt;
+    AST::Reductions *reductions;
     AST::ReturnStmt *returnStmt;
     AST::EmptyStmt * emptyStmt;
 
     AST::Expr *expr;
     AST::FuncCall *funcCall;
+    AST::SubscriptExpr *subscriptExpr;
     AST::Args *args;
     AST::AddExpr *addExpr;
     AST::MulExpr *mulExpr;
@@ -79,18 +185,23 @@ std::string *CurrentVarName;
 
 %token<token>		TRUE FALSE NULLPTR
 %token<charVal>		CHARACTER
-%token<intVal>		INTEGER
-%token<doubleVal>   	REAL
+%token<integerVal>	INTEGER
+%token<realVal>   	REAL
 %token<strVal>		STRING
 %token<identifier>	IDENTIFIER
 %token<token>		SEMI COMMA DOT LPAREN RPAREN LBRACKET RBRACKET LBRACE RBRACE
-%token<token>		ADD SUB MUL DIV
+%token<token>		ADD SUB MUL DIV MOD
 %token<token>		EQUAL NEQ
 %token<token>		GREAT LESS
 %token<token>		NOT
 %token<token>		ASSIGN
-%token<token>		VOID BOOL CHAR INT DOUBLE
+%token<token>		VOID BOOL CHAR INT DOUBLE FLOAT
+%token<token>		SHORT LONG UNSIGNED
+%token<token>		STRUCT SOA
+%token<intVal>		VECTOR_TYPE
 %token<token>		IF ELSE FOR RETURN
+%token<token>		CONST
+%token<token>		PARALLEL REDUCTION COLON
 
 %type<prog>		Prog
 
@@ -105,10 +216,13 @@ std::string *CurrentVarName;
 %type<varDef>		VarDef
 %type<varInit>		VarInit
 %type<varInitList>	VarInitList
+%type<structDef>	StructDef
+%type<members>		StructMembers
 
-%type<typeSpecifier>	TypeSpecifier VarDefBaseType ComplexVar
+%type<typeSpecifier>	TypeSpecifier VarDefBaseType
+%type<declarator>	ComplexVar
 %type<builtInType>	BuiltInType
-%type<intVal>		ArrSize
+%type<expr>		ArrSize
 
 %type<stmt>		Stmt
 %type<stmts>		Stmts
@@ -118,6 +232,8 @@ std::string *CurrentVarName;
 %type<forStmt>		ForStmt
 %type<stmt>		ForInit
 %type<expr>		ForCondition ForIncrement
+%type<reductions>	Reductions
+%type<intVal>		ReductionOp
 %type<returnStmt>	ReturnStmt
 %type<emptyStmt>	EmptyStmt
 
@@ -129,29 +245,66 @@ std::string *CurrentVarName;
 %type<identifier>	IdentifierUse
 
 %left   ADD SUB
-%left   MUL DIV
+%left   MUL DIV MOD
 %right	NOT
-%left 	DOT
+%left 	DOT LBRACKET
+
+%locations
 
 %start  Prog
 
 %%
 
-Prog : Units { $$ = new AST::Prog($1); Root = $$; }
+Prog : Units {
+		$$ = new AST::Prog($1);
+		$$->constCallees.assign(GlobalConstCallees.begin(), GlobalConstCallees.end());
+		Root = $$;
+	}
 
-Units : Units Unit { $$ = $1; $$->push_back($2); }
-      | Unit { $$ = new AST::Units(); $$->push_back($1); }
+Units : Units Unit { $$ = $1; AddUnit($$, $2); }
+      | Unit { $$ = new AST::Units(); AddUnit($$, $1); }
 
 Unit : Def { $$ = $1; }
 
 Def : FuncDef { $$ = $1; }
-    | VarDef { $$ = $1; }
-
-FuncDef : TypeSpecifier IdentifierUse LPAREN Params RPAREN FuncBody { $$ = new AST::FuncDef($1, *$2, $4, $6); }
+    | VarDef {
+		$$ = $1;
+		GlobalConstCallees.insert(CurrentCallees.begin(), CurrentCallees.end());
+		CurrentCallees.clear();
+		CurrentConstCallees.clear();
+	}
+    | StructDef {
+		$$ = $1;
+		GlobalConstCallees.insert(CurrentCallees.begin(), CurrentCallees.end());
+		CurrentCallees.clear();
+		CurrentConstCallees.clear();
+	}
+
+/* 函数定义与全局变量定义以相同的 VarDefBaseType 开头，直到看到名称之后的符号才区分两者 */
+FuncDef : VarDefBaseType IdentifierUse LPAREN Params RPAREN FuncBody {
+		$$ = new AST::FuncDef($1, *$2, $4, $6);
+		$$->SetSourceRange(@$.first_offset, @5.last_offset, @$.last_offset);
+		$$->callees.assign(CurrentCallees.begin(), CurrentCallees.end());
+		$$->constCallees.assign(CurrentConstCallees.begin(), CurrentConstCallees.end());
+		CurrentCallees.clear();
+		CurrentConstCallees.clear();
+	}
+	/* 函数原型：只声明函数，使之前的代码可以调用之后定义的函数或 C 库中的函数 */
+	| VarDefBaseType IdentifierUse LPAREN Params RPAREN SEMI {
+		$$ = new AST::FuncDef($1, *$2, $4, nullptr);
+		$$->SetSourceRange(@$.first_offset, @5.last_offset, @$.last_offset);
+		CurrentCallees.clear();
+		CurrentConstCallees.clear();
+	}
 
 FuncBody : LBRACE Stmts RBRACE { $$ = new AST::FuncBody($2); }
 
 VarDef : VarDefBaseType VarInitList SEMI { $$ = new AST::VarDef($1, $2); }
+       | CONST { ++ConstContextDepth; } VarDefBaseType VarInitList SEMI {
+		--ConstContextDepth;
+		$$ = new AST::VarDef($3, $4);
+		$$->isConst = true;
+	}
 
 VarDefBaseType : TypeSpecifier { $$ = $1; CurrentBaseType = $$; }
 
@@ -160,33 +313,56 @@ VarInitList : VarInitList COMMA VarInit { $$ = $1; $$->push_back($3); }
 
 VarInit : IdentifierUse ASSIGN Expr { $$ = new AST::VarInit(*$1, $3); }
         | IdentifierUse { $$ = new AST::VarInit(*$1); }
-	| ComplexVar { $$ = new AST::VarInit(*CurrentVarName, $1, CurrentBaseType); }
+	| ComplexVar { $$ = new AST::VarInit(*CurrentVarName, *$1, CurrentBaseType); delete $1; }
 
-ComplexVar : IdentifierUse ArrSize %prec DOT { CurrentVarName = $1; $$ = new AST::ArrType(nullptr, $2); }
-	   | MUL IdentifierUse %prec NOT { CurrentVarName = $2; $$ = new AST::PtrType(nullptr); }
-	   | ComplexVar ArrSize %prec DOT { $$ = new AST::ArrType($1, $2); }
-	   | MUL ComplexVar %prec NOT { $$ = new AST::PtrType($2); }
+/* 声明符按从变量名向外的顺序记录各层，在 VarInit 中由基本类型向外构造出唯一化的类型 */
+ComplexVar : IdentifierUse ArrSize %prec DOT { CurrentVarName = $1; $$ = new AST::Declarator{ $2 }; }
+	   | MUL IdentifierUse %prec NOT { CurrentVarName = $2; $$ = new AST::Declarator{ nullptr }; }
+	   | ComplexVar ArrSize %prec DOT { $$ = $1; $$->push_back($2); }
+	   | MUL ComplexVar %prec NOT { $$ = $2; $$->push_back(nullptr); }
 	   | LPAREN ComplexVar RPAREN %prec DOT { $$ = $2; }
 
-ArrSize : LBRACKET TRUE RBRACKET { $$ = true; }
-	| LBRACKET FALSE RBRACKET { $$ = false; }
-	| LBRACKET CHARACTER RBRACKET { $$ = $2; }
-	| LBRACKET INTEGER RBRACKET { $$ = $2; }
+/* 数组长度可以是任意常量表达式，在代码生成时求值 */
+ArrSize : LBRACKET { ++ConstContextDepth; } Expr RBRACKET { --ConstContextDepth; $$ = $3; }
 
-TypeSpecifier : BuiltInType { $$ = $1; }
+/* 结构体定义，以 soa 开头时该结构体的数组按 SoA 布局存放；成员的数组长度与全局变量一样在编译期求值 */
+StructDef : STRUCT IDENTIFIER LBRACE StructMembers RBRACE SEMI { $$ = DefineStruct(*$2, $4, false); }
+	  | SOA STRUCT IDENTIFIER LBRACE StructMembers RBRACE SEMI { $$ = DefineStruct(*$3, $5, true); }
 
-BuiltInType : VOID { $$ = new AST::BuiltInType(AST::BuiltInType::_VOID); }
-	    | BOOL { $$ = new AST::BuiltInType(AST::BuiltInType::_BOOL); }
-            | CHAR { $$ = new AST::BuiltInType(AST::BuiltInType::_CHAR); }
-            | INT { $$ = new AST::BuiltInType(AST::BuiltInType::_INT); }
-            | DOUBLE {$$ = new AST::BuiltInType(AST::BuiltInType::_DOUBLE); }
+StructMembers : StructMembers VarDef { $$ = $1; AddMembers($$, $2); }
+	      | VarDef { $$ = new AST::StructType::Members(); AddMembers($$, $1); }
+
+TypeSpecifier : BuiltInType { $$ = $1; }
+	      | STRUCT IDENTIFIER { $$ = AST::TypeTable::GetStructType(*$2); }
+
+BuiltInType : VOID { $$ = AST::TypeTable::GetBuiltInType(AST::BuiltInType::_VOID); }
+	    | BOOL { $$ = AST::TypeTable::GetBuiltInType(AST::BuiltInType::_BOOL); }
+            | CHAR { $$ = AST::TypeTable::GetBuiltInType(AST::BuiltInType::_CHAR); }
+            | INT { $$ = AST::TypeTable::GetBuiltInType(AST::BuiltInType::_INT); }
+            | DOUBLE {$$ = AST::TypeTable::GetBuiltInType(AST::BuiltInType::_DOUBLE); }
+            | FLOAT { $$ = AST::TypeTable::GetBuiltInType(AST::BuiltInType::_FLOAT); }
+            | SHORT { $$ = AST::TypeTable::GetBuiltInType(AST::BuiltInType::_SHORT); }
+            | LONG { $$ = AST::TypeTable::GetBuiltInType(AST::BuiltInType::_LONG); }
+            | LONG LONG { $$ = AST::TypeTable::GetBuiltInType(AST::BuiltInType::_LONG); }
+            | UNSIGNED { $$ = AST::TypeTable::GetBuiltInType(AST::BuiltInType::_UINT); }
+            | UNSIGNED CHAR { $$ = AST::TypeTable::GetBuiltInType(AST::BuiltInType::_UCHAR); }
+            | UNSIGNED SHORT { $$ = AST::TypeTable::GetBuiltInType(AST::BuiltInType::_USHORT); }
+            | UNSIGNED INT { $$ = AST::TypeTable::GetBuiltInType(AST::BuiltInType::_UINT); }
+            | UNSIGNED LONG { $$ = AST::TypeTable::GetBuiltInType(AST::BuiltInType::_ULONG); }
+            | UNSIGNED LONG LONG { $$ = AST::TypeTable::GetBuiltInType(AST::BuiltInType::_ULONG); }
+            | VECTOR_TYPE { $$ = AST::TypeTable::GetBuiltInType(static_cast<AST::BuiltInType::TypeID>($1)); }
 
 Params : Params COMMA Param { $$ = $1; $$->push_back($3); }
        | Param { $$ = new AST::Params(); $$->push_back($1); }
        | VOID { $$ = new AST::Params(); }
        | { $$ = new AST::Params(); }
 
+/* 形参可以是指针，例如 int main(int argc, char **argv)；数组形参在代码生成时报错 */
 Param : TypeSpecifier IdentifierUse { $$ = new AST::Param($1, *$2); }
+      | TypeSpecifier ComplexVar {
+		$$ = new AST::Param(AST::TypeTable::GetDeclaredType($1, *$2), *CurrentVarName);
+		delete $2;
+	}
 
 Block : LBRACE Stmts RBRACE { $$ = new AST::Block($2); }
 
@@ -207,6 +383,22 @@ IfStmt : IF LPAREN Expr RPAREN Stmt ELSE Stmt { $$ = new AST::IfStmt($3, $5, $7)
        | IF LPAREN Expr RPAREN Stmt { $$ = new AST::IfStmt($3, $5); }
 
 ForStmt : FOR LPAREN ForInit ForCondition SEMI ForIncrement RPAREN Stmt { $$ = new AST::ForStmt($3, $4, $6, $8); }
+        | PARALLEL FOR LPAREN ForInit ForCondition SEMI ForIncrement RPAREN Reductions Stmt { $$ = new AST::ParallelForStmt($4, $5, $7, $9, $10); }
+
+Reductions : Reductions REDUCTION LPAREN ReductionOp COLON IdentifierUse RPAREN { $$ = $1; $$->push_back({ static_cast<AST::Reduction::Op>($4), *$6 }); }
+           | { $$ = new AST::Reductions(); }
+
+/* min 和 max 不是关键字，仍可用作变量名 */
+ReductionOp : ADD { $$ = AST::Reduction::ADD; }
+            | MUL { $$ = AST::Reduction::MUL; }
+            | IDENTIFIER {
+                if (*$1 == "min")
+                    $$ = AST::Reduction::MIN;
+                else if (*$1 == "max")
+                    $$ = AST::Reduction::MAX;
+                else
+                    yyerror(("unknown reduction operator " + *$1).c_str());
+            }
 
 ForInit : ExprStmt { $$ = $1; }
         | VarDef { $$ = $1; }
@@ -228,22 +420,31 @@ Expr : FuncCall { $$ = $1; }
      | Expr MUL Expr { $$ = new AST::MulExpr($1, $3); }
      | Expr SUB Expr { $$ = new AST::SubExpr($1, $3); }
      | Expr DIV Expr { $$ = new AST::DivExpr($1, $3); }
+     | Expr MOD Expr { $$ = new AST::ModExpr($1, $3); }
      | Expr EQUAL Expr { $$ = new AST::EqExpr($1, $3); }
      | Expr NEQ Expr { $$ = new AST::NeqExpr($1, $3); }
      | Expr GREAT Expr { $$ = new AST::GreatExpr($1, $3); }
      | Expr LESS Expr { $$ = new AST::LessExpr($1, $3); }
      | Expr ASSIGN Expr { $$ = new AST::AssignExpr($1, $3); }
+     | Expr LBRACKET Expr RBRACKET { $$ = new AST::SubscriptExpr($1, $3); }
+     | Expr DOT IDENTIFIER { $$ = new AST::MemberExpr($1, *$3); }
+     | VECTOR_TYPE LPAREN Args RPAREN { $$ = new AST::VectorExpr(AST::TypeTable::GetBuiltInType(static_cast<AST::BuiltInType::TypeID>($1)), $3); }
      | IdentifierUse { $$ = new AST::Variable(*$1); }
      | Constant { $$ = $1; }
 
 Constant : TRUE { $$ = new AST::Boolean(true); }
 	 | FALSE { $$ = new AST::Boolean(false); }
          | CHARACTER { $$ = new AST::Character($1); }
-         | INTEGER { $$ = new AST::Integer($1); }
-         | REAL { $$ = new AST::Real($1); }
+         | INTEGER { $$ = new AST::Integer($1.value, $1.isLong, $1.isUnsigned); }
+         | REAL { $$ = new AST::Real($1.value, $1.isFloat); }
          | STRING { $$ = new AST::ConstString(*$1); }
 
-FuncCall : IdentifierUse LPAREN Args RPAREN { $$ = new AST::FuncCall(*$1, $3); }
+FuncCall : IdentifierUse LPAREN Args RPAREN {
+		$$ = new AST::FuncCall(*$1, $3);
+		CurrentCallees.insert(*$1);
+		if (ConstContextDepth > 0)
+			CurrentConstCallees.insert(*$1);
+	}
 
 Args : Args COMMA Expr { $$ = $1; $$->push_back($3); }
      | Expr { $$ = new AST::Args(); $$->push_back($1); }
@@ -0,0 +1,46 @@
+//
+// Created by Pei Yuhang on 2023/6/5.
+//
+
+#include <iostream>
+
+#include <llvm/IR/PassTimingInfo.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include "timer.h"
+
+bool TimeReportEnabled = false;
+
+/**
+ * @brief 开启 Chrome trace 的记录，之后所有 PhaseTimer 和 LLVM 的 pass 都会记录事件
+ * @param programName 进程名称，显示在 trace 中
+ */
+void StartTimeTrace(const char *programName) {
+    // 粒度为 0 表示记录所有事件，不忽略耗时很短的事件
+    llvm::timeTraceProfilerInitialize(0, programName);
+}
+
+/**
+ * @brief 结束 Chrome trace 的记录，并写出 trace-event 格式的 JSON 文件，可用 chrome://tracing 或 Perfetto 打开
+ * @param traceFile 输出文件的名称
+ */
+void FinishTimeTrace(const std::string &traceFile) {
+    if (!llvm::timeTraceProfilerEnabled())
+        return;
+
+    if (llvm::Error error = llvm::timeTraceProfilerWrite(traceFile, traceFile))
+        std::cerr << "Cannot write time trace " << traceFile << ": " << llvm::toString(std::move(error)) << std::endl;
+    llvm::timeTraceProfilerCleanup();
+}
+
+/**
+ * @brief 向标准错误输出各编译阶段的耗时表格，以及后端 (legacy PassManager) 中各 pass 的耗时表格
+ */
+void PrintTimeReport() {
+    if (!TimeReportEnabled)
+        return;
+
+    llvm::reportAndResetTimings(&llvm::errs());
+    llvm::TimerGroup::printAll(llvm::errs());
+}
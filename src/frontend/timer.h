@@ -0,0 +1,39 @@
+//
+// Created by Pei Yuhang on 2023/6/5.
+//
+
+#ifndef CP_PROJECT_TIMER_H
+#define CP_PROJECT_TIMER_H
+
+#include <string>
+
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/TimeProfiler.h>
+#include <llvm/Support/Timer.h>
+
+// 是否在编译结束时输出 -ftime-report 风格的耗时表格
+extern bool TimeReportEnabled;
+
+/**
+ * @brief 编译流水线中一个阶段的计时器，在构造时开始计时，在析构时结束计时
+ *
+ * 同名阶段的耗时会在耗时表格中累加；若开启了 Chrome trace，还会记录一个事件，
+ * detail 作为事件的参数显示（例如函数名）。两者都未开启时，开销只有两次判断。
+ */
+class PhaseTimer {
+public:
+    explicit PhaseTimer(llvm::StringRef name, llvm::StringRef detail = "")
+        : timer(name, name, "CP_Project", "Compile pipeline", TimeReportEnabled), traceScope(name, detail) {}
+
+private:
+    llvm::NamedRegionTimer timer;       // 耗时表格中的计时器
+    llvm::TimeTraceScope traceScope;    // Chrome trace 中的事件
+};
+
+void StartTimeTrace(const char *programName);
+
+void FinishTimeTrace(const std::string &traceFile);
+
+void PrintTimeReport();
+
+#endif //CP_PROJECT_TIMER_H
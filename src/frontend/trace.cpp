@@ -0,0 +1,7 @@
+//
+// Created by Pei Yuhang on 2023/6/6.
+//
+
+#include "trace.h"
+
+TraceLevel CurrentTraceLevel = TraceLevel::None;
@@ -0,0 +1,39 @@
+//
+// Created by Pei Yuhang on 2023/6/6.
+//
+
+#ifndef CP_PROJECT_TRACE_H
+#define CP_PROJECT_TRACE_H
+
+#include <iostream>
+
+/**
+ * @brief 编译过程跟踪信息的详细程度，级别越高输出越多
+ */
+enum class TraceLevel {
+    None,   // 不输出任何跟踪信息（默认）
+    Phase,  // 输出各编译阶段的开始和结束
+    Node,   // 额外输出每个 AST 节点的代码生成过程
+    IR      // 额外输出生成的 LLVM IR
+};
+
+// 当前的跟踪级别，由命令行选项 -trace 设置
+extern TraceLevel CurrentTraceLevel;
+
+/*
+ * 输出一条跟踪信息，message 可以是任意 operator<< 链，例如 TRACE(TraceLevel::Node, "Creating " << name)
+ *
+ * 跟踪信息写入带缓冲的 std::clog（标准错误），不会混入程序自身的标准输出，也不会每行强制刷新。
+ * 跟踪级别低于 level 时，只需要一次整数比较；定义 CP_PROJECT_DISABLE_TRACE 时完全不生成代码。
+ */
+#ifdef CP_PROJECT_DISABLE_TRACE
+#define TRACE(level, message) do {} while (0)
+#else
+#define TRACE(level, message)                                       \
+    do {                                                            \
+        if (CurrentTraceLevel >= (level))                           \
+            std::clog << message << '\n';                           \
+    } while (0)
+#endif
+
+#endif //CP_PROJECT_TRACE_H
@@ -6,23 +6,154 @@
 #define CP_PROJECT_TYPE_HPP
 
 #include "codegen.h"
+#include "vector.hpp"
 
 llvm::Value *CastToBool(llvm::Value *val) {
     if (val->getType() == Builder.getInt1Ty())
         return val;
+    // 与同类型的零比较，各种宽度的整型都适用
     if (val->getType()->isIntegerTy())
-        return Builder.CreateICmpNE(val, llvm::ConstantInt::get(llvm::Type::getInt32Ty(Context), 0));
-
-    /// TODO: 需要完成其他类型转为布尔类型
+        return Builder.CreateICmpNE(val, llvm::ConstantInt::get(val->getType(), 0));
+    if (val->getType()->isFloatingPointTy())
+        return Builder.CreateFCmpUNE(val, llvm::ConstantFP::get(val->getType(), 0.0));
 
     throw std::logic_error("Cannot cast to bool");
 }
 
+/**
+ * @brief 将值隐式转换为目标类型，用于赋值、初始化、传参和返回
+ *
+ * 整型之间按源类型的符号扩展或截断，整型与浮点型之间按各自的符号转换，转换为 bool 时与零比较，指针之间直接转换。
+ * @param val 被转换的值
+ * @param isUnsigned val 是否为无符号整数
+ * @param type 目标类型
+ * @param toUnsigned 目标类型是否为无符号整型
+ * @return 转换后的值
+ */
+llvm::Value *CastToType(llvm::Value *val, bool isUnsigned, llvm::Type *type, bool toUnsigned) {
+    llvm::Type *valType = val->getType();
+    if (valType == type)
+        return val;
+    // bool 的值只有 0 和 1，总是零扩展
+    isUnsigned = isUnsigned || valType->isIntegerTy(1);
+
+    if (type->isIntegerTy(1) && (valType->isIntegerTy() || valType->isFloatingPointTy()))
+        return CastToBool(val);
+    if (valType->isIntegerTy() && type->isIntegerTy())
+        return Builder.CreateIntCast(val, type, !isUnsigned);
+    if (valType->isIntegerTy() && type->isFloatingPointTy())
+        return isUnsigned ? Builder.CreateUIToFP(val, type) : Builder.CreateSIToFP(val, type);
+    if (valType->isFloatingPointTy() && type->isIntegerTy())
+        return toUnsigned ? Builder.CreateFPToUI(val, type) : Builder.CreateFPToSI(val, type);
+    if (valType->isFloatingPointTy() && type->isFloatingPointTy())
+        return Builder.CreateFPCast(val, type);
+    if (valType->isPointerTy() && type->isPointerTy())
+        return Builder.CreatePointerCast(val, type);
+
+    throw std::logic_error("Cannot convert the value to the target type");
+}
+
+/**
+ * @brief 对二元运算的标量操作数进行寻常算术转换
+ *
+ * 有一侧为浮点型时两侧都转换为浮点型；否则两侧先提升到至少 int 的宽度，再转换为较宽的类型，
+ * 宽度相同时只要有一侧为无符号整数，结果就是无符号整数，与 C 语言的规则一致。
+ * @param lhs 左操作数，转换后写回
+ * @param lhsUnsigned 左操作数是否为无符号整数
+ * @param rhs 右操作数，转换后写回
+ * @param rhsUnsigned 右操作数是否为无符号整数
+ * @return 转换后的操作数是否为无符号整数
+ */
+bool ConvertArithmeticOperands(llvm::Value *&lhs, bool lhsUnsigned, llvm::Value *&rhs, bool rhsUnsigned) {
+    llvm::Type *lhsType = lhs->getType(), *rhsType = rhs->getType();
+
+    if (lhsType->isFloatingPointTy() || rhsType->isFloatingPointTy()) {
+        if (!(lhsType->isFloatingPointTy() || lhsType->isIntegerTy()) || !(rhsType->isFloatingPointTy() || rhsType->isIntegerTy()))
+            return false;
+        llvm::Type *type = !rhsType->isFloatingPointTy() ? lhsType : !lhsType->isFloatingPointTy() ? rhsType
+                : lhsType->getPrimitiveSizeInBits() >= rhsType->getPrimitiveSizeInBits() ? lhsType : rhsType;
+        lhs = CastToType(lhs, lhsUnsigned, type, false);
+        rhs = CastToType(rhs, rhsUnsigned, type, false);
+        return false;
+    }
+    if (!lhsType->isIntegerTy() || !rhsType->isIntegerTy())
+        return false;
+
+    // 整型提升：比 int 窄的整型（包括 unsigned char 和 unsigned short）都提升为 int
+    auto promote = [](llvm::Value *&val, bool &isUnsigned) {
+        if (val->getType()->getIntegerBitWidth() < 32) {
+            val = Builder.CreateIntCast(val, Builder.getInt32Ty(), !isUnsigned && !val->getType()->isIntegerTy(1));
+            isUnsigned = false;
+        }
+    };
+    promote(lhs, lhsUnsigned);
+    promote(rhs, rhsUnsigned);
+
+    const unsigned lhsWidth = lhs->getType()->getIntegerBitWidth(), rhsWidth = rhs->getType()->getIntegerBitWidth();
+    if (lhsWidth == rhsWidth)
+        return lhsUnsigned || rhsUnsigned;
+    // 较宽的类型能表示较窄类型的所有值，结果取较宽类型的符号
+    if (lhsWidth > rhsWidth) {
+        rhs = Builder.CreateIntCast(rhs, lhs->getType(), !rhsUnsigned);
+        return lhsUnsigned;
+    }
+    lhs = Builder.CreateIntCast(lhs, rhs->getType(), !lhsUnsigned);
+    return rhsUnsigned;
+}
+
+/**
+ * @brief 生成二元运算的指令，操作数先经过向量扩展和寻常算术转换，
+ *        再按整型与浮点型、有符号与无符号选择指令；操作数都是常量时 Builder 直接将结果折叠为常量
+ * @param op 运算的种类
+ * @param lhs 左操作数
+ * @param lhsUnsigned 左操作数是否为无符号整数
+ * @param rhs 右操作数
+ * @param rhsUnsigned 右操作数是否为无符号整数
+ * @param isUnsigned 结果是否为无符号整数，比较运算的结果总是有符号的
+ * @return 运算的结果
+ */
+llvm::Value *CreateBinaryOp(BinaryOp op, llvm::Value *lhs, bool lhsUnsigned, llvm::Value *rhs, bool rhsUnsigned,
+                            bool &isUnsigned) {
+    MatchVectorOperands(lhs, rhs);
+    bool operandsUnsigned = ConvertArithmeticOperands(lhs, lhsUnsigned, rhs, rhsUnsigned);
+    if (lhs->getType() != rhs->getType())
+        throw std::logic_error("Operands of a binary operation have different types");
+
+    const bool isFP = lhs->getType()->isFPOrFPVectorTy();
+    isUnsigned = false;
+    switch (op) {
+        case BinaryOp::ADD: isUnsigned = operandsUnsigned; return isFP ? Builder.CreateFAdd(lhs, rhs) : Builder.CreateAdd(lhs, rhs);
+        case BinaryOp::SUB: isUnsigned = operandsUnsigned; return isFP ? Builder.CreateFSub(lhs, rhs) : Builder.CreateSub(lhs, rhs);
+        case BinaryOp::MUL: isUnsigned = operandsUnsigned; return isFP ? Builder.CreateFMul(lhs, rhs) : Builder.CreateMul(lhs, rhs);
+        case BinaryOp::DIV:
+            isUnsigned = operandsUnsigned;
+            return isFP ? Builder.CreateFDiv(lhs, rhs) : operandsUnsigned ? Builder.CreateUDiv(lhs, rhs) : Builder.CreateSDiv(lhs, rhs);
+        case BinaryOp::MOD:
+            isUnsigned = operandsUnsigned;
+            return isFP ? Builder.CreateFRem(lhs, rhs) : operandsUnsigned ? Builder.CreateURem(lhs, rhs) : Builder.CreateSRem(lhs, rhs);
+        case BinaryOp::EQ: return isFP ? Builder.CreateFCmpOEQ(lhs, rhs) : Builder.CreateICmpEQ(lhs, rhs);
+        case BinaryOp::NEQ: return isFP ? Builder.CreateFCmpUNE(lhs, rhs) : Builder.CreateICmpNE(lhs, rhs);
+        case BinaryOp::GREAT:
+            return isFP ? Builder.CreateFCmpOGT(lhs, rhs) : operandsUnsigned ? Builder.CreateICmpUGT(lhs, rhs) : Builder.CreateICmpSGT(lhs, rhs);
+        case BinaryOp::LESS:
+            return isFP ? Builder.CreateFCmpOLT(lhs, rhs) : operandsUnsigned ? Builder.CreateICmpULT(lhs, rhs) : Builder.CreateICmpSLT(lhs, rhs);
+    }
+    throw std::logic_error("Unknown binary operation");
+}
+
 llvm::Type *GetPtrElementType(llvm::Value *ptr) {
     if (!ptr->getType()->isPointerTy())
         throw std::logic_error("Should pass a pointer to get the element type");
 
-    return static_cast<llvm::AllocaInst *>(ptr)->getAllocatedType();
+    // 局部变量的地址来自 alloca 指令，全局变量的地址是 llvm::GlobalVariable，数组元素的地址来自 getelementptr 指令
+    if (auto alloca = llvm::dyn_cast<llvm::AllocaInst>(ptr))
+        return alloca->getAllocatedType();
+    if (auto global = llvm::dyn_cast<llvm::GlobalVariable>(ptr))
+        return global->getValueType();
+    if (auto gep = llvm::dyn_cast<llvm::GEPOperator>(ptr))
+        return gep->getResultElementType();
+
+    throw std::logic_error("Cannot get the element type of the pointer");
 }
 
 #endif //CP_PROJECT_TYPE_HPP
@@ -0,0 +1,187 @@
+//
+// Created by Pei Yuhang on 2023/6/9.
+//
+
+#ifndef CP_PROJECT_VECTOR_HPP
+#define CP_PROJECT_VECTOR_HPP
+
+#include <set>
+
+#include "AST.h"
+#include "codegen.h"
+
+/*
+ * 向量类型（int2、int4、int8、double2、double4、float4、float8）的代码生成辅助函数
+ *
+ * 向量的算术运算和比较运算逐元素进行，比较的结果是 i1 向量（掩码），只能用于 select、any、all。
+ * 向量与标量运算时，标量先被扩展（splat）为各元素都相同的向量。
+ */
+
+/**
+ * @brief 将标量转换为向量元素的类型，整型可转换为浮点型，较窄的整型可扩展为较宽的整型，
+ *        浮点型转换为元素的浮点类型（如 2.0 与 float4 运算时按 float 处理）
+ * @param val 标量值
+ * @param elementType 向量元素的类型
+ */
+llvm::Value *CastToElementType(llvm::Value *val, llvm::Type *elementType) {
+    llvm::Type *type = val->getType();
+    if (type == elementType)
+        return val;
+    if (type->isIntegerTy() && elementType->isFloatingPointTy())
+        return Builder.CreateSIToFP(val, elementType);
+    if (type->isIntegerTy() && elementType->isIntegerTy()
+        && type->getIntegerBitWidth() < elementType->getIntegerBitWidth())
+        return type->isIntegerTy(1) ? Builder.CreateZExt(val, elementType) : Builder.CreateSExt(val, elementType);
+    if (type->isFloatingPointTy() && elementType->isFloatingPointTy())
+        return Builder.CreateFPCast(val, elementType);
+
+    throw std::logic_error("Cannot convert the value to the vector element type");
+}
+
+/**
+ * @brief 二元运算的一侧为向量、另一侧为标量时，将标量扩展为同类型的向量
+ */
+void MatchVectorOperands(llvm::Value *&lhs, llvm::Value *&rhs) {
+    auto lhsType = llvm::dyn_cast<llvm::FixedVectorType>(lhs->getType());
+    auto rhsType = llvm::dyn_cast<llvm::FixedVectorType>(rhs->getType());
+    if (lhsType && !rhsType)
+        rhs = Builder.CreateVectorSplat(lhsType->getNumElements(), CastToElementType(rhs, lhsType->getElementType()));
+    else if (rhsType && !lhsType)
+        lhs = Builder.CreateVectorSplat(rhsType->getNumElements(), CastToElementType(lhs, rhsType->getElementType()));
+    else if (lhsType && rhsType && lhsType != rhsType)
+        throw std::logic_error("Operands of a vector operation should have the same vector type");
+}
+
+/**
+ * @brief 获取向量的类型，value 不是向量时报错
+ * @param funcName 内置函数名称，用于错误信息
+ */
+llvm::FixedVectorType *GetVectorType(llvm::Value *value, const std::string &funcName) {
+    auto vectorType = llvm::dyn_cast<llvm::FixedVectorType>(value->getType());
+    if (!vectorType)
+        throw std::logic_error("Argument of " + funcName + "() should be a vector");
+    return vectorType;
+}
+
+/**
+ * @brief 检查向量的下标，常量下标必须在向量长度之内
+ */
+llvm::Value *CheckLaneIndex(llvm::Value *index, llvm::FixedVectorType *vectorType) {
+    if (!index->getType()->isIntegerTy())
+        throw std::logic_error("Vector lane index is not an integer");
+    if (auto constIndex = llvm::dyn_cast<llvm::ConstantInt>(index))
+        if (constIndex->getZExtValue() >= vectorType->getNumElements())
+            throw std::logic_error("Vector lane index " + std::to_string(constIndex->getSExtValue()) + " is out of range");
+    return index;
+}
+
+/**
+ * @brief 判断 funcName 是否为向量内置函数
+ */
+bool IsVectorBuiltin(const std::string &funcName) {
+    static const std::set<std::string> builtins = {
+        "extract", "insert", "shuffle", "select", "any", "all",
+        "reduce_add", "reduce_mul", "reduce_min", "reduce_max"
+    };
+    return builtins.count(funcName) > 0;
+}
+
+/**
+ * @brief 为向量内置函数生成代码，内置函数对各种向量类型通用，直接展开为 LLVM 的向量指令
+ *
+ *  - extract(v, i)：取出第 i 个元素
+ *  - insert(v, i, x)：返回将第 i 个元素替换为 x 的新向量
+ *  - shuffle(a, i0, i1, ...) / shuffle(a, b, i0, i1, ...)：按常量下标重排元素，下标从 a 的元素开始，接着是 b 的元素
+ *  - select(mask, a, b)：逐元素选择，掩码为真取 a 的元素，否则取 b 的元素
+ *  - any(mask) / all(mask)：掩码中是否有元素 / 全部元素为真
+ *  - reduce_add(v) / reduce_mul(v) / reduce_min(v) / reduce_max(v)：水平归约为标量，浮点型按元素顺序计算
+ *
+ * @param context 代码生成上下文
+ * @param funcName 内置函数名称
+ * @param args 实参表达式
+ * @return 内置函数的结果
+ */
+llvm::Value *CodeGenVectorBuiltin(CodeGenContext *context, const std::string &funcName, const AST::Args &args) {
+    auto expectArgs = [&](size_t count) {
+        if (args.size() != count)
+            throw std::logic_error(funcName + "() expects " + std::to_string(count) + " arguments");
+    };
+
+    if (funcName == "shuffle") {
+        if (args.size() < 2)
+            throw std::logic_error("shuffle() expects a vector and lane indices");
+        llvm::Value *first = args[0]->CodeGen(context);
+        llvm::FixedVectorType *vectorType = GetVectorType(first, funcName);
+        // 第二个实参为向量时是双源重排，否则所有后续实参都是下标
+        llvm::Value *second = nullptr;
+        size_t indexBegin = 1;
+        if (!dynamic_cast<AST::Integer *>(args[1])) {
+            second = args[1]->CodeGen(context);
+            if (second->getType() != vectorType)
+                throw std::logic_error("Both vectors of shuffle() should have the same type");
+            indexBegin = 2;
+        }
+        const unsigned lanes = vectorType->getNumElements() * (second ? 2 : 1);
+        std::vector<int> mask;
+        for (size_t i = indexBegin; i < args.size(); ++i) {
+            auto index = dynamic_cast<AST::Integer *>(args[i]);
+            if (!index)
+                throw std::logic_error("Lane indices of shuffle() should be integer constants");
+            if (index->intVal < 0 || static_cast<unsigned>(index->intVal) >= lanes)
+                throw std::logic_error("Vector lane index " + std::to_string(index->intVal) + " is out of range");
+            mask.push_back(index->intVal);
+        }
+        if (mask.empty())
+            throw std::logic_error("shuffle() expects lane indices");
+        return second ? Builder.CreateShuffleVector(first, second, mask) : Builder.CreateShuffleVector(first, mask);
+    }
+
+    std::vector<llvm::Value *> values;
+    for (auto arg : args)
+        values.push_back(arg->CodeGen(context));
+
+    if (funcName == "extract") {
+        expectArgs(2);
+        return Builder.CreateExtractElement(values[0], CheckLaneIndex(values[1], GetVectorType(values[0], funcName)));
+    }
+    if (funcName == "insert") {
+        expectArgs(3);
+        llvm::FixedVectorType *vectorType = GetVectorType(values[0], funcName);
+        return Builder.CreateInsertElement(values[0], CastToElementType(values[2], vectorType->getElementType()),
+                                           CheckLaneIndex(values[1], vectorType));
+    }
+    if (funcName == "select") {
+        expectArgs(3);
+        llvm::FixedVectorType *maskType = GetVectorType(values[0], funcName);
+        if (!maskType->getElementType()->isIntegerTy(1))
+            throw std::logic_error("First argument of select() should be a vector comparison");
+        MatchVectorOperands(values[1], values[2]);
+        auto vectorType = llvm::dyn_cast<llvm::FixedVectorType>(values[1]->getType());
+        if (!vectorType || vectorType->getNumElements() != maskType->getNumElements())
+            throw std::logic_error("Arguments of select() should have as many lanes as the mask");
+        return Builder.CreateSelect(values[0], values[1], values[2]);
+    }
+
+    expectArgs(1);
+    llvm::FixedVectorType *vectorType = GetVectorType(values[0], funcName);
+    llvm::Type *elementType = vectorType->getElementType();
+    if (funcName == "any" || funcName == "all") {
+        if (!elementType->isIntegerTy(1))
+            throw std::logic_error("Argument of " + funcName + "() should be a vector comparison");
+        return funcName == "any" ? Builder.CreateOrReduce(values[0]) : Builder.CreateAndReduce(values[0]);
+    }
+
+    // 浮点型的加法和乘法归约不带 fast-math 标志，按元素顺序计算，与逐个相加的结果一致
+    bool isFP = elementType->isFloatingPointTy();
+    if (funcName == "reduce_add")
+        return isFP ? Builder.CreateFAddReduce(llvm::ConstantFP::getNegativeZero(elementType), values[0])
+                    : Builder.CreateAddReduce(values[0]);
+    if (funcName == "reduce_mul")
+        return isFP ? Builder.CreateFMulReduce(llvm::ConstantFP::get(elementType, 1.0), values[0])
+                    : Builder.CreateMulReduce(values[0]);
+    if (funcName == "reduce_min")
+        return isFP ? Builder.CreateFPMinReduce(values[0]) : Builder.CreateIntMinReduce(values[0], true);
+    return isFP ? Builder.CreateFPMaxReduce(values[0]) : Builder.CreateIntMaxReduce(values[0], true);
+}
+
+#endif //CP_PROJECT_VECTOR_HPP
@@ -0,0 +1,33 @@
+//
+// Created by Pei Yuhang on 2023/6/11.
+//
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+
+#include "bounds.h"
+
+extern "C" void cp_bounds_check_failed(const char *location, int64_t index, int64_t size) {
+    // 先刷新程序已经输出的内容，使诊断信息出现在越界之前的输出之后
+    fflush(stdout);
+    fprintf(stderr, "%s: array index %" PRId64 " is out of bounds for an array of %" PRId64 " elements\n",
+            location, index, size);
+    abort();
+}
+
+extern "C" void cp_loop_bounds_check_failed(const char *location, const char *loopVarName, int64_t lo, int64_t hi,
+                                            int64_t validLo, int64_t validHi) {
+    fflush(stdout);
+    fprintf(stderr, "%s: loop variable %s ranges over [%" PRId64 ", %" PRId64 "), but the array accesses in the loop "
+                    "require it to stay within [%" PRId64 ", %" PRId64 ")\n",
+            location, loopVarName, lo, hi, validLo, validHi);
+    abort();
+}
+
+extern "C" void cp_length_check_failed(const char *location, const char *funcName, int64_t count, int64_t size) {
+    fflush(stdout);
+    fprintf(stderr, "%s: %s() count %" PRId64 " is out of range for an array of %" PRId64 " elements\n",
+            location, funcName, count, size);
+    abort();
+}
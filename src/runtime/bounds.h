@@ -0,0 +1,45 @@
+//
+// Created by Pei Yuhang on 2023/6/11.
+//
+
+#ifndef CP_PROJECT_BOUNDS_H
+#define CP_PROJECT_BOUNDS_H
+
+#include <cstdint>
+
+/*
+ * -fbounds-check 的运行时支持：越界时由生成的代码调用，输出源代码位置后以 SIGABRT 终止程序
+ *
+ * 与 parallel for 的运行时支持一样，同时被链接进编译器（供 JIT 使用）和 CP_Runtime 静态库（供 -exe 使用）。
+ */
+
+extern "C" {
+
+/**
+ * @brief 数组下标越界
+ * @param location 下标表达式的位置，形如 file.c:12:5
+ * @param index 下标的值
+ * @param size 数组的长度
+ */
+[[noreturn]] void cp_bounds_check_failed(const char *location, int64_t index, int64_t size);
+
+/**
+ * @brief 循环前的范围检查失败：循环变量的取值区间 [lo, hi) 超出了循环中数组访问允许的区间 [validLo, validHi)
+ * @param location 循环语句的位置
+ * @param loopVarName 循环变量名
+ */
+[[noreturn]] void cp_loop_bounds_check_failed(const char *location, const char *loopVarName, int64_t lo, int64_t hi,
+                                              int64_t validLo, int64_t validHi);
+
+/**
+ * @brief memcpy、memset、fill 的元素个数超出了数组的长度
+ * @param location 内置函数调用的位置
+ * @param funcName 内置函数名称
+ * @param count 元素个数
+ * @param size 数组的长度
+ */
+[[noreturn]] void cp_length_check_failed(const char *location, const char *funcName, int64_t count, int64_t size);
+
+}
+
+#endif //CP_PROJECT_BOUNDS_H
@@ -0,0 +1,285 @@
+//
+// Created by Pei Yuhang on 2023/6/8.
+//
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "parallel.h"
+
+namespace {
+
+    // 迭代区间最多被切分的块数，块越多负载越均衡，但每块的调度开销越大
+    constexpr int64_t MaxChunks = 1024;
+
+    /* 一次 parallel for 的执行状态 */
+    struct ParallelJob {
+        ParallelBody body;
+        void *captures;
+        int64_t lo;
+        uint64_t chunkSize;
+        uint64_t iterations;
+        int32_t reductionCount;
+        std::vector<uint64_t> partials;     // 每块 reductionCount 个 8 字节的归约结果
+    };
+
+    /* 每个线程的任务队列，所有者从队尾取块，窃取者从队首取块 */
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<int64_t> chunks;
+
+        bool Pop(int64_t &chunk) {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            if (this->chunks.empty())
+                return false;
+            chunk = this->chunks.back();
+            this->chunks.pop_back();
+            return true;
+        }
+
+        bool Steal(int64_t &chunk) {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            if (this->chunks.empty())
+                return false;
+            chunk = this->chunks.front();
+            this->chunks.pop_front();
+            return true;
+        }
+    };
+
+    /* 工作窃取线程池，调用 parallel for 的线程作为第 0 号线程参与执行 */
+    class WorkStealingPool {
+    public:
+        explicit WorkStealingPool(unsigned threadCount) : queues(threadCount) {
+            for (unsigned i = 1; i < threadCount; ++i)
+                this->threads.emplace_back(&WorkStealingPool::ThreadMain, this, i);
+        }
+
+        ~WorkStealingPool() {
+            {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                this->stopping = true;
+            }
+            this->wake.notify_all();
+            for (auto &thread : this->threads)
+                thread.join();
+        }
+
+        unsigned GetThreadCount() const { return this->queues.size(); }
+
+        void Run(ParallelJob &job, int64_t chunkCount) {
+            // 把块按连续区间平均分给各线程，相邻的迭代尽量在同一线程中执行
+            const unsigned threadCount = this->queues.size();
+            for (unsigned i = 0; i < threadCount; ++i)
+                for (int64_t chunk = chunkCount * i / threadCount; chunk < chunkCount * (i + 1) / threadCount; ++chunk)
+                    this->queues[i].chunks.push_back(chunk);
+
+            {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                this->job = &job;
+                this->busy = threadCount;
+                ++this->generation;
+            }
+            this->wake.notify_all();
+
+            Work(0);
+
+            // 等待所有线程离开本次任务，之后 job 才能被释放
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->done.wait(lock, [this] { return this->busy == 0; });
+            this->job = nullptr;
+        }
+
+    private:
+        void ThreadMain(unsigned index) {
+            unsigned seenGeneration = 0;
+            for (;;) {
+                {
+                    std::unique_lock<std::mutex> lock(this->mutex);
+                    this->wake.wait(lock, [&] { return this->stopping || this->generation != seenGeneration; });
+                    if (this->stopping)
+                        return;
+                    seenGeneration = this->generation;
+                }
+                Work(index);
+            }
+        }
+
+        // 先执行自己队列中的块，再依次从其他线程的队列中窃取，全部队列为空时结束
+        void Work(unsigned index) {
+            InParallel = true;
+            const unsigned threadCount = this->queues.size();
+            for (int64_t chunk;;) {
+                bool found = this->queues[index].Pop(chunk);
+                for (unsigned i = 1; !found && i < threadCount; ++i)
+                    found = this->queues[(index + i) % threadCount].Steal(chunk);
+                if (!found)
+                    break;
+                RunChunk(*this->job, chunk);
+            }
+            InParallel = false;
+
+            std::lock_guard<std::mutex> lock(this->mutex);
+            if (--this->busy == 0)
+                this->done.notify_all();
+        }
+
+    public:
+        // 块的起点和终点按 64 位补码回绕计算，对有符号和无符号的循环变量都适用
+        static void RunChunk(ParallelJob &job, int64_t chunk) {
+            uint64_t begin = std::min(job.iterations, chunk * job.chunkSize);
+            uint64_t end = begin + std::min(job.chunkSize, job.iterations - begin);
+            job.body(job.captures, static_cast<int64_t>(static_cast<uint64_t>(job.lo) + begin),
+                     static_cast<int64_t>(static_cast<uint64_t>(job.lo) + end),
+                     job.partials.data() + chunk * job.reductionCount);
+        }
+
+        static thread_local bool InParallel;   // 当前线程是否正在执行 parallel for 的循环体
+
+    private:
+        std::vector<std::thread> threads;
+        std::vector<WorkQueue> queues;
+        std::mutex mutex;
+        std::condition_variable wake, done;
+        ParallelJob *job = nullptr;
+        unsigned generation = 0;    // 每提交一次任务加一，用于唤醒等待的线程
+        unsigned busy = 0;          // 仍在执行本次任务的线程数
+        bool stopping = false;
+    };
+
+    thread_local bool WorkStealingPool::InParallel = false;
+
+    /**
+     * @brief 获取线程池，第一次调用时按 CP_NUM_THREADS 创建
+     */
+    WorkStealingPool &GetPool() {
+        static WorkStealingPool pool([] {
+            const char *env = std::getenv("CP_NUM_THREADS");
+            int threadCount = env ? std::atoi(env) : 0;
+            return threadCount > 0 ? static_cast<unsigned>(threadCount) : std::max(1u, std::thread::hardware_concurrency());
+        }());
+        return pool;
+    }
+
+    template<typename T>
+    T Identity(int32_t op) {
+        switch (op) {
+            case REDUCE_ADD: return 0;
+            case REDUCE_MUL: return 1;
+            case REDUCE_MIN: return std::numeric_limits<T>::has_infinity ? std::numeric_limits<T>::infinity() : std::numeric_limits<T>::max();
+            default: return std::numeric_limits<T>::has_infinity ? -std::numeric_limits<T>::infinity() : std::numeric_limits<T>::lowest();
+        }
+    }
+
+    template<typename T>
+    T Combine(int32_t op, T lhs, T rhs) {
+        // 整数加法和乘法按补码回绕，与生成代码中的运算一致
+        using Wrap = std::conditional_t<std::is_integral<T>::value, std::make_unsigned<T>, std::common_type<T>>;
+        using W = typename Wrap::type;
+        switch (op) {
+            case REDUCE_ADD: return static_cast<T>(static_cast<W>(lhs) + static_cast<W>(rhs));
+            case REDUCE_MUL: return static_cast<T>(static_cast<W>(lhs) * static_cast<W>(rhs));
+            case REDUCE_MIN: return std::min(lhs, rhs);
+            default: return std::max(lhs, rhs);
+        }
+    }
+
+    template<typename T>
+    T Load(const void *slot) {
+        T value;
+        std::memcpy(&value, slot, sizeof(T));
+        return value;
+    }
+
+    template<typename T>
+    void Store(void *slot, T value) {
+        std::memcpy(slot, &value, sizeof(T));
+    }
+
+    /**
+     * @brief 按归约变量的类型调用 func，参数为该类型的值初始化对象
+     */
+    template<typename Func>
+    void VisitKind(int32_t kind, Func func) {
+        switch (kind) {
+            case REDUCE_INT: func(int32_t()); break;
+            case REDUCE_DOUBLE: func(double()); break;
+            case REDUCE_LONG: func(int64_t()); break;
+            case REDUCE_UINT: func(uint32_t()); break;
+            case REDUCE_FLOAT: func(float()); break;
+            default: func(uint64_t()); break;
+        }
+    }
+
+    /**
+     * @brief 把每个块的归约结果按块的顺序合并进 results
+     */
+    void Reduce(const ParallelJob &job, int64_t chunkCount, const int32_t *reductionOps, void *results) {
+        for (int32_t r = 0; r < job.reductionCount; ++r) {
+            void *result = static_cast<uint64_t *>(results) + r;
+            int32_t op = reductionOps[r] / ReductionKindCount, kind = reductionOps[r] % ReductionKindCount;
+            VisitKind(kind, [&](auto type) {
+                using T = decltype(type);
+                for (int64_t chunk = 0; chunk < chunkCount; ++chunk)
+                    Store(result, Combine(op, Load<T>(result), Load<T>(&job.partials[chunk * job.reductionCount + r])));
+            });
+        }
+    }
+
+}
+
+/**
+ * @brief 并行执行 [lo, hi) 中的迭代
+ * @param body 被提取出的循环体
+ * @param captures 传给循环体的外部变量地址数组
+ * @param lo 迭代区间的起点，循环变量为 32 位时按其符号扩展为 64 位
+ * @param iterations 迭代次数，循环变量从 lo 开始依次加一
+ * @param reductionCount 归约变量的数量
+ * @param reductionOps 每个归约变量的运算，编码为 op * ReductionKindCount + kind
+ * @param results 每个归约变量占 8 字节，进入时为变量在循环前的值，返回时为归约后的值
+ */
+extern "C" void cp_parallel_for(ParallelBody body, void *captures, int64_t lo, uint64_t iterations,
+                                int32_t reductionCount, const int32_t *reductionOps, void *results) {
+    if (iterations == 0)
+        return;
+
+    // 块的划分只取决于迭代次数，与线程数无关，保证归约的合并顺序固定
+    const int64_t chunkCount = static_cast<int64_t>(std::min<uint64_t>(iterations, MaxChunks));
+    const uint64_t chunkSize = iterations / chunkCount + (iterations % chunkCount != 0);
+    ParallelJob job{ body, captures, lo, chunkSize, iterations, reductionCount, {} };
+    job.partials.resize(chunkCount * reductionCount);
+    for (int64_t chunk = 0; chunk < chunkCount; ++chunk)
+        for (int32_t r = 0; r < reductionCount; ++r) {
+            void *partial = &job.partials[chunk * reductionCount + r];
+            VisitKind(reductionOps[r] % ReductionKindCount, [&](auto type) {
+                Store(partial, Identity<decltype(type)>(reductionOps[r] / ReductionKindCount));
+            });
+        }
+
+    // 嵌套的 parallel for 以及单线程时直接顺序执行
+    WorkStealingPool &pool = GetPool();
+    if (WorkStealingPool::InParallel || pool.GetThreadCount() == 1)
+        for (int64_t chunk = 0; chunk < chunkCount; ++chunk)
+            WorkStealingPool::RunChunk(job, chunk);
+    else
+        pool.Run(job, chunkCount);
+
+    Reduce(job, chunkCount, reductionOps, results);
+}
+
+/**
+ * @brief 提前按 CP_NUM_THREADS 创建线程池，使线程的栈在此之后已经存在于进程的地址空间中
+ */
+extern "C" void cp_parallel_start() {
+    GetPool();
+}
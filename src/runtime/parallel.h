@@ -0,0 +1,57 @@
+//
+// Created by Pei Yuhang on 2023/6/8.
+//
+
+#ifndef CP_PROJECT_PARALLEL_H
+#define CP_PROJECT_PARALLEL_H
+
+#include <cstdint>
+
+/*
+ * parallel for 的运行时支持，由生成的代码调用，同时被链接进编译器（供 JIT 使用）和 CP_Runtime 静态库（供 -exe 使用）
+ *
+ * 循环的迭代区间按迭代次数被切分为固定数量的块，块的划分与线程数无关；各线程优先执行自己队列中的块，
+ * 队列为空时从其他线程的队列中窃取。每个块有独立的归约结果，全部块完成后按块的顺序合并，
+ * 因此无论线程数和调度顺序如何，归约结果都是确定的。
+ *
+ * 线程数由环境变量 CP_NUM_THREADS 指定，默认为 CPU 核数。
+ */
+
+/* 归约运算，与归约变量的类型一起编码为 op * ReductionKindCount + kind */
+enum ReductionOp : int32_t {
+    REDUCE_ADD = 0,
+    REDUCE_MUL = 1,
+    REDUCE_MIN = 2,
+    REDUCE_MAX = 3
+};
+
+/* 归约变量的类型 */
+enum ReductionKind : int32_t {
+    REDUCE_INT = 0,     // 32 位有符号整型
+    REDUCE_DOUBLE = 1,  // 双精度浮点型
+    REDUCE_LONG = 2,    // 64 位有符号整型
+    REDUCE_UINT = 3,    // 32 位无符号整型
+    REDUCE_ULONG = 4,   // 64 位无符号整型
+    REDUCE_FLOAT = 5,   // 单精度浮点型，块内和块间都按 float 运算
+    ReductionKindCount = 8
+};
+
+/**
+ * @brief 被提取出的循环体，执行 [lo, hi) 中的迭代
+ * @param captures 循环体用到的外部变量的地址组成的数组
+ * @param lo 本块的起点，按循环变量的类型截断后使用
+ * @param hi 本块的终点（不含），按循环变量的类型截断后使用
+ * @param partials 本块的归约结果，每个归约变量占 8 字节，进入时为各运算的单位元
+ */
+using ParallelBody = void (*)(void *captures, int64_t lo, int64_t hi, void *partials);
+
+extern "C" {
+
+void cp_parallel_for(ParallelBody body, void *captures, int64_t lo, uint64_t iterations,
+                     int32_t reductionCount, const int32_t *reductionOps, void *results);
+
+void cp_parallel_start();
+
+}
+
+#endif //CP_PROJECT_PARALLEL_H
@@ -0,0 +1,301 @@
+//
+// Created by Pei Yuhang on 2023/6/7.
+//
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <llvm/Support/raw_ostream.h>
+
+#include "server.h"
+
+/*
+ * 编译服务
+ *
+ * 服务进程在 Unix 域套接字上监听，每个连接是一个请求：
+ *   - 请求：第一行为以空格分隔的命令行选项（可以为空行），其后直到连接的写端关闭为止都是源代码
+ *   - 响应：若干 "键 值" 形式的行，依次为 status、compile_seconds、jit_seconds、run_seconds、latency_seconds，
+ *     然后是 "diagnostics <字节数>" 和 "output <字节数>" 两行，每行之后紧跟对应字节数的诊断信息和程序输出
+ *
+ * 服务进程在启动时完成 LLVM 目标、内置函数和 JIT 的初始化，每个连接由 fork 出的请求进程处理，
+ * 请求进程读取请求后再 fork 一个子进程编译运行，子进程得到已初始化状态的副本，且程序崩溃或调用 exit() 都不会影响服务进程。
+ * 子进程受 RunLimits 的资源限制，请求从连接建立起超过时间限制时，请求进程停止读取或终止子进程，响应的 status 为 timeout，
+ * 因此死循环的程序或不关闭写端的客户端都不会阻塞其他请求。
+ */
+
+/**
+ * @brief 向 fd 写入全部数据，对端提前关闭连接时放弃写入
+ */
+static void WriteAll(int fd, const std::string &data) {
+    for (size_t written = 0; written < data.size();) {
+        ssize_t n = write(fd, data.data() + written, data.size() - written);
+        if (n <= 0)
+            return;
+        written += n;
+    }
+}
+
+/**
+ * @brief 从文件开头读出 file 的全部内容
+ */
+static std::string ReadAll(FILE *file) {
+    std::string data;
+    char buffer[4096];
+    std::rewind(file);
+    for (size_t n; (n = std::fread(buffer, 1, sizeof(buffer), file)) > 0;)
+        data.append(buffer, n);
+    return data;
+}
+
+/**
+ * @brief 获取距离 deadline 的毫秒数，用作 poll 的超时；deadline 为 time_point::max() 表示不限制，此时为 -1
+ */
+static int RemainingMillis(std::chrono::steady_clock::time_point deadline) {
+    if (deadline == std::chrono::steady_clock::time_point::max())
+        return -1;
+    auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+    return static_cast<int>(std::clamp<long long>(remaining.count(), 0, INT_MAX));
+}
+
+/**
+ * @brief 读取一个请求：命令行选项按空格切分后存入 args，源代码写入 sourceFile
+ * @param deadline 读取的期限，到期时客户端仍未关闭写端则放弃读取
+ * @return 请求是否完整
+ */
+static bool ReadRequest(int clientFd, std::vector<std::string> &args, FILE *sourceFile,
+                        std::chrono::steady_clock::time_point deadline) {
+    std::string header;
+    bool headerDone = false;
+    char buffer[4096];
+    for (;;) {
+        pollfd pollFd{ clientFd, POLLIN, 0 };
+        int ready = poll(&pollFd, 1, RemainingMillis(deadline));
+        if (ready < 0 && errno == EINTR)
+            continue;
+        if (ready <= 0)
+            return false;
+        ssize_t n = read(clientFd, buffer, sizeof(buffer));
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+
+        size_t offset = 0;
+        if (!headerDone) {
+            const char *newline = static_cast<const char *>(std::memchr(buffer, '\n', n));
+            offset = newline ? newline - buffer + 1 : n;
+            header.append(buffer, newline ? offset - 1 : offset);
+            headerDone = newline != nullptr;
+        }
+        std::fwrite(buffer + offset, 1, n - offset, sourceFile);
+    }
+    if (!headerDone)
+        return false;
+
+    std::istringstream headerStream(header);
+    for (std::string arg; headerStream >> arg;)
+        args.push_back(arg);
+    std::fflush(sourceFile);
+    std::rewind(sourceFile);
+    return true;
+}
+
+/**
+ * @brief 等待子进程结束，到 deadline 时仍未结束则将其终止，调用前须阻塞 SIGCHLD
+ * @return 子进程是否在期限内结束
+ */
+static bool WaitChild(pid_t pid, int &waitStatus, std::chrono::steady_clock::time_point deadline) {
+    sigset_t childSignal;
+    sigemptyset(&childSignal);
+    sigaddset(&childSignal, SIGCHLD);
+    while (waitpid(pid, &waitStatus, WNOHANG) != pid) {
+        int timeout = RemainingMillis(deadline);
+        if (timeout < 0) {
+            waitpid(pid, &waitStatus, 0);
+            break;
+        }
+        timespec wait{ timeout / 1000, timeout % 1000 * 1000000L };
+        if (sigtimedwait(&childSignal, nullptr, &wait) < 0 && errno == EAGAIN) {
+            kill(pid, SIGKILL);
+            waitpid(pid, &waitStatus, 0);
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief 在请求进程中读取一个请求，在子进程中编译运行，并将结果写回客户端
+ * @param clientFd 客户端连接
+ * @param options 服务模式的选项
+ * @param handler 处理请求的回调函数
+ * @return 请求的状态，用于服务进程的日志
+ */
+static std::string HandleRequest(int clientFd, const ServerOptions &options, const RequestHandler &handler) {
+    auto requestStart = std::chrono::steady_clock::now();
+    auto deadline = options.timeoutSeconds > 0
+            ? requestStart + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                    std::chrono::duration<double>(options.timeoutSeconds))
+            : std::chrono::steady_clock::time_point::max();
+
+    FILE *sourceFile = std::tmpfile(), *outputFile = std::tmpfile(), *diagFile = std::tmpfile(), *statsFile = std::tmpfile();
+    if (!sourceFile || !outputFile || !diagFile || !statsFile)
+        throw std::runtime_error(std::string("Cannot create temporary file: ") + std::strerror(errno));
+
+    std::vector<std::string> args;
+    std::string status;
+    if (!ReadRequest(clientFd, args, sourceFile, deadline)) {
+        status = RemainingMillis(deadline) == 0 ? "timeout" : "bad_request";
+    } else {
+        // 在 fork 之前阻塞 SIGCHLD，子进程结束的信号保留到 WaitChild 中的 sigtimedwait 取走
+        sigset_t childSignal, oldMask;
+        sigemptyset(&childSignal);
+        sigaddset(&childSignal, SIGCHLD);
+        sigprocmask(SIG_BLOCK, &childSignal, &oldMask);
+
+        // fork 之前清空缓冲区，避免子进程重复输出请求进程尚未写出的内容
+        std::fflush(nullptr);
+        pid_t pid = fork();
+        if (pid < 0)
+            throw std::runtime_error(std::string("Cannot fork: ") + std::strerror(errno));
+
+        if (pid == 0) {
+            sigprocmask(SIG_SETMASK, &oldMask, nullptr);
+            close(clientFd);
+            SetAddressSpaceLimit(options.limits.memoryBytes);
+            SetOutputLimit(options.limits.outputBytes);
+            SetCpuTimer(options.limits.cpuSeconds);
+
+            dup2(fileno(sourceFile), STDIN_FILENO);
+            dup2(fileno(outputFile), STDOUT_FILENO);
+            dup2(fileno(diagFile), STDERR_FILENO);
+
+            RunStats stats;
+            int exitCode;
+            try {
+                exitCode = handler(args, stats);
+            } catch (const std::exception &error) {
+                std::cerr << "Error: " << error.what() << std::endl;
+                exitCode = 1;
+            }
+            std::fprintf(statsFile, "%f %f %f", stats.compileSeconds, stats.jitSeconds, stats.runSeconds);
+            std::cout.flush();
+            llvm::outs().flush();
+            std::fflush(nullptr);
+            _exit(exitCode);
+        }
+
+        int waitStatus = 0;
+        if (!WaitChild(pid, waitStatus, deadline))
+            status = "timeout";
+        else
+            status = WIFSIGNALED(waitStatus) ? "signal " + std::to_string(WTERMSIG(waitStatus))
+                                             : "exit " + std::to_string(WEXITSTATUS(waitStatus));
+    }
+
+    RunStats stats;
+    std::rewind(statsFile);
+    if (std::fscanf(statsFile, "%lf %lf %lf", &stats.compileSeconds, &stats.jitSeconds, &stats.runSeconds) != 3)
+        stats = RunStats();
+    double latency = std::chrono::duration<double>(std::chrono::steady_clock::now() - requestStart).count();
+
+    const std::string diagnostics = ReadAll(diagFile), output = ReadAll(outputFile);
+    std::ostringstream response;
+    response << "status " << status << "\n"
+             << "compile_seconds " << stats.compileSeconds << "\n"
+             << "jit_seconds " << stats.jitSeconds << "\n"
+             << "run_seconds " << stats.runSeconds << "\n"
+             << "latency_seconds " << latency << "\n"
+             << "diagnostics " << diagnostics.size() << "\n" << diagnostics
+             << "output " << output.size() << "\n" << output;
+    WriteAll(clientFd, response.str());
+
+    for (FILE *file : { sourceFile, outputFile, diagFile, statsFile })
+        std::fclose(file);
+    return status + ", " + std::to_string(latency * 1000) + " ms";
+}
+
+/**
+ * @brief 在 Unix 域套接字上监听并在各自的请求进程中处理请求，不会返回，除非套接字无法创建
+ * @param socketPath 套接字路径，已存在的文件会被删除
+ * @param options 服务模式的选项
+ * @param handler 处理请求的回调函数
+ * @return 进程的退出码
+ */
+int RunServer(const std::string &socketPath, const ServerOptions &options, const RequestHandler &handler) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(address.sun_path)) {
+        std::cerr << "Socket path is too long: " << socketPath << std::endl;
+        return 1;
+    }
+    std::strcpy(address.sun_path, socketPath.c_str());
+
+    int serverFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(socketPath.c_str());
+    if (serverFd < 0 || bind(serverFd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0
+        || listen(serverFd, SOMAXCONN) < 0) {
+        std::cerr << "Cannot listen on " << socketPath << ": " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+
+    // 客户端提前断开时，写入响应不应使服务进程退出
+    signal(SIGPIPE, SIG_IGN);
+    std::clog << "Listening on " << socketPath << std::endl;
+
+    unsigned activeRequests = 0;
+    for (unsigned long requestCount = 1;; ++requestCount) {
+        // 回收已结束的请求进程，同时处理的请求达到上限时等待其中一个结束
+        while (activeRequests > 0) {
+            pid_t pid = waitpid(-1, nullptr, activeRequests >= options.maxRequests ? 0 : WNOHANG);
+            if (pid < 0 && errno == EINTR)
+                continue;
+            if (pid <= 0)
+                break;
+            --activeRequests;
+        }
+
+        int clientFd = accept(serverFd, nullptr, nullptr);
+        if (clientFd < 0)
+            continue;
+
+        std::fflush(nullptr);
+        pid_t pid = fork();
+        if (pid < 0) {
+            std::clog << "Request " << requestCount << ": cannot fork: " << std::strerror(errno) << std::endl;
+            close(clientFd);
+            continue;
+        }
+
+        if (pid == 0) {
+            close(serverFd);
+            std::string status;
+            try {
+                status = HandleRequest(clientFd, options, handler);
+            } catch (const std::exception &error) {
+                status = error.what();
+            }
+            close(clientFd);
+            std::clog << "Request " << requestCount << ": " << status << std::endl;
+            _exit(0);
+        }
+
+        close(clientFd);
+        ++activeRequests;
+    }
+}
@@ -0,0 +1,39 @@
+//
+// Created by Pei Yuhang on 2023/6/7.
+//
+
+#ifndef CP_PROJECT_SERVER_H
+#define CP_PROJECT_SERVER_H
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "backend/executor.h"
+
+/* 一次编译运行的耗时统计 */
+struct RunStats {
+    double compileSeconds = 0;  // 编译耗时（秒）
+    double jitSeconds = 0;      // JIT 编译耗时（秒）
+    double runSeconds = 0;      // main 函数执行耗时（秒）
+};
+
+/**
+ * @brief 处理一个请求的回调函数，在子进程中调用，此时标准输入为请求中的源代码，
+ *        标准输出和标准错误分别被重定向到程序输出和诊断信息
+ * @param args 请求中的命令行选项
+ * @param stats 用于返回耗时统计
+ * @return 进程的退出码
+ */
+using RequestHandler = std::function<int(const std::vector<std::string> &args, RunStats &stats)>;
+
+/* 服务模式的选项 */
+struct ServerOptions {
+    unsigned maxRequests = 1;       // 同时处理的请求数
+    double timeoutSeconds = 0;      // 每个请求从连接建立到响应的墙钟时间限制（秒），为 0 时不限制
+    RunLimits limits;               // 编译运行请求的子进程的 CPU 时间、地址空间和输出大小限制
+};
+
+int RunServer(const std::string &socketPath, const ServerOptions &options, const RequestHandler &handler);
+
+#endif //CP_PROJECT_SERVER_H
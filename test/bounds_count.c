@@ -0,0 +1,18 @@
+// -fbounds-check 运行时应输出 7 0 后报告
+//   memset() count 11 is out of range for an array of 10 elements
+// 并终止：内存内置函数的元素个数不是常量时在运行时检查；把 n 换成常量 11 时编译器直接报错
+
+int a[10];
+
+int main() {
+    int n;
+    n = 10;
+    fill(a, 7, n);
+    printInt(a[9]);
+    memset(a, 0, n);
+    printInt(a[9]);
+    n = n + 1;
+    memset(a, 0, n);
+    printInt(a[0]);
+    return 0;
+}
@@ -0,0 +1,40 @@
+// -fbounds-check 运行时应输出 45 81 4950 99：
+// 循环中以 i、i - 1 为下标的访问都合并为循环开始前的区间检查并通过。前两个循环的上界为常量，检查在编译期完成，
+// 后两个循环的上界为局部变量 n，各生成一次运行时检查；以 -emit=ll 输出时 main 中没有 cp_bounds_check_failed 的调用，
+// cp_loop_bounds_check_failed 只出现在后两个循环之前
+
+soa struct P { int x; int id; };
+
+int a[10];
+int b[100];
+struct P ps[100];
+
+int main() {
+    int i, n, s;
+    for (i = 0; i < 10; i = i + 1) {
+        a[i] = i;
+    }
+    s = 0;
+    for (i = 1; i < 10; i = i + 1) {
+        s = s + a[i - 1] + a[i] - a[i] + 1;
+    }
+    printInt(s);
+    s = 0;
+    for (i = 1; i < 10; i = i + 1) {
+        s = s + a[i] * a[i] - a[i - 1] * a[i - 1];
+    }
+    printInt(s);
+    n = 100;
+    for (i = 0; i < n; i = i + 1) {
+        b[i] = i;
+    }
+    s = 0;
+    for (i = 0; i < n; i = i + 1) {
+        ps[i].x = b[i];
+        ps[i].id = i;
+        s = s + ps[i].x;
+    }
+    printInt(s);
+    printInt(ps[99].id);
+    return 0;
+}
@@ -0,0 +1,15 @@
+// -fbounds-check 运行时应在循环开始前报告
+//   loop variable i ranges over [0, 11), but the array accesses in the loop require it to stay within [0, 10)
+// 并终止，循环一次也不执行，因此没有任何输出
+
+int a[10];
+
+int main() {
+    int i, n;
+    n = 11;
+    for (i = 0; i < n; i = i + 1) {
+        printInt(i);
+        a[i] = i;
+    }
+    return 0;
+}
@@ -0,0 +1,17 @@
+// -fbounds-check 运行时应在 a[10] 处报告越界并终止：
+// memset 改写了循环的上界 n，循环中的访问不能合并为循环开始前的区间检查
+
+int a[10];
+
+int main() {
+    int i, n;
+    n = 10;
+    for (i = 0; i < n; i = i + 1) {
+        a[i] = i;
+        if (i == 5) {
+            memset(n, 1);
+        }
+    }
+    printInt(a[9]);
+    return 0;
+}
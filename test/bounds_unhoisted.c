@@ -0,0 +1,74 @@
+// -fbounds-check 运行时应输出 10 10 1 10 10 而不报告越界：
+// 以下循环的上界都超过数组的长度，但实际的访问没有越界。循环中有 return、给循环变量或上界赋值、
+// 重新定义了循环变量，或者访问只在 if 分支中执行，因此都不能合并为循环开始前的区间检查，只能逐次检查
+
+int a[10];
+
+int earlyReturn(int n) {
+    int i;
+    for (i = 0; i < n; i = i + 1) {
+        if (i == 10) {
+            return i;
+        }
+        a[i] = i;
+    }
+    return n;
+}
+
+int assignLoopVar() {
+    int i, count;
+    count = 0;
+    for (i = 0; i < 20; i = i + 1) {
+        a[i] = i;
+        count = count + 1;
+        if (i == 9) {
+            i = 20;
+        }
+    }
+    return count;
+}
+
+int shadow() {
+    int i, s;
+    s = 0;
+    for (i = 0; i < 20; i = i + 1) {
+        int i;
+        i = 3;
+        a[i] = 1;
+        s = a[i];
+    }
+    return s;
+}
+
+int conditional() {
+    int i, count;
+    count = 0;
+    for (i = 0; i < 20; i = i + 1) {
+        if (i < 10) {
+            a[i] = i;
+            count = count + 1;
+        }
+    }
+    return count;
+}
+
+int assignBound() {
+    int i, n;
+    n = 20;
+    for (i = 0; i < n; i = i + 1) {
+        a[i] = i;
+        if (i == 9) {
+            n = 10;
+        }
+    }
+    return n;
+}
+
+int main() {
+    printInt(earlyReturn(20));
+    printInt(assignLoopVar());
+    printInt(shadow());
+    printInt(conditional());
+    printInt(assignBound());
+    return 0;
+}
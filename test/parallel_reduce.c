@@ -0,0 +1,37 @@
+// parallel for 的归约结果与线程数无关，以 CP_NUM_THREADS=1、2、8 分别运行都应输出
+//   4950 109641728 -50 50 50 495.000000 100
+// 乘积按 32 位补码回绕；double 的和按固定的块顺序合并，同样与线程数无关
+
+int a[100];
+double d[100];
+
+int main() {
+    int i, sum = 0, prod = 1, lo = 1000, hi = 0, neg = 0;
+    double dsum = 0.0;
+    for (i = 0; i < 100; i = i + 1) {
+        a[i] = i * 37 % 101 - 50;
+        d[i] = i * 0.1;
+    }
+    parallel for (i = 0; i < 100; i = i + 1) reduction(+: sum) {
+        sum = sum + i;
+    }
+    parallel for (i = 1; i < 20; i = i + 1) reduction(*: prod) {
+        prod = prod * i;
+    }
+    parallel for (i = 0; i < 100; i = i + 1) reduction(min: lo) reduction(max: hi) reduction(+: neg) {
+        if (a[i] < lo) lo = a[i];
+        if (hi < a[i]) hi = a[i];
+        if (a[i] < 0) neg = neg + 1;
+    }
+    parallel for (i = 0; i < 100; i = i + 1) reduction(+: dsum) {
+        dsum = dsum + d[i];
+    }
+    printInt(sum);
+    printInt(prod);
+    printInt(lo);
+    printInt(hi);
+    printInt(neg);
+    printDouble(dsum);
+    printInt(i);
+    return 0;
+}
@@ -0,0 +1,23 @@
+// SoA 布局的数组以 const 变量为长度时，同一结构体、同一长度的数组可以整体赋值和复制，应输出 9 90 4
+
+soa struct P { int x; int id; };
+
+const int N = 10;
+
+struct P a[N];
+struct P b[N];
+
+int main() {
+    int i;
+    for (i = 0; i < N; i = i + 1) {
+        a[i].x = i;
+        a[i].id = i * 10;
+    }
+    b = a;
+    printInt(b[9].x);
+    printInt(b[9].id);
+    memset(a, 0);
+    memcpy(a, b, 5);
+    printInt(a[4].x + a[5].x);
+    return 0;
+}
@@ -0,0 +1,56 @@
+// 无符号运算、寻常算术转换和整数字面量的类型，应依次输出
+//   0 1 0 1 3 2147483644 -3 9 -7 0 4294967296 2147483648 8589934590 18446744073709551615 1 4294967295
+//   42949672945 4294967300
+// 比较、除法和取余的操作数都是变量或字面量，避免与加减法的结合顺序混淆
+
+int less(long x, long y) {
+    if (x < y) return 1;
+    return 0;
+}
+
+int main() {
+    int m = 0 - 1, r = 0, s;
+    unsigned u = 0u - 7, big = 4294967295u;
+    long l = 0 - 1L;
+    unsigned long ul = 0UL;
+    long i, lsum = 0;
+
+    // int 与 unsigned 比较时 -1 转换为 4294967295u
+    if (m < 1u) r = 1;
+    printInt(r);
+    // long 能表示 unsigned 的所有值，比较按有符号的 long 进行
+    r = 0;
+    if (l < 1u) r = 1;
+    printInt(r);
+    // unsigned long 与 int 比较时 -1 转换为最大的 unsigned long
+    r = 0;
+    if (m < 1UL) r = 1;
+    printInt(r);
+    // 按值传参时转换为形参类型，再按有符号比较
+    printInt(less(m, 1u));
+
+    // udiv / urem 与 sdiv / srem
+    printUnsigned(7u / 2);
+    printUnsigned(u / 2);
+    s = 0 - 7;
+    printInt(s / 2);
+    printUnsigned(u % 10);
+    printInt(s % 10);
+
+    // 4294967295u 为 unsigned，加一回绕为 0；4294967295 没有后缀，为 long
+    printUnsigned(big + 1u);
+    printLong(4294967295 + 1);
+    printLong(2147483648);
+    printLong(4294967295u * 2L);
+    printUnsignedLong(ul - 1);
+    printInt(18446744073709551615UL / 18446744073709551615UL);
+    printUnsignedLong(big);
+
+    // parallel for 的循环变量为 long 时，迭代区间可以超出 int 的范围
+    parallel for (i = 4294967290; i < 4294967300; i = i + 1) reduction(+: lsum) {
+        lsum = lsum + i;
+    }
+    printLong(lsum);
+    printLong(i);
+    return 0;
+}
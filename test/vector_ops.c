@@ -0,0 +1,48 @@
+// 向量类型与向量内置函数，应依次输出
+//   10 3 23 45 4 8 11 1 0 1 109 24 1 8 36 2.500000 5.750000 0.000000 32.000000
+
+int4 scale(int4 v, int k) {
+    return v * k;
+}
+
+int main() {
+    int4 a = int4(1, 2, 3, 4);
+    int4 b = int4(10);
+    int4 c, d;
+    int8 e = int8(1, 2, 3, 4, 5, 6, 7, 8);
+    double4 x = double4(0.5, 1.5, 2.5, 3.5);
+    double2 y;
+    float4 f = float4(2.0f);
+
+    // 逐元素运算，标量扩展到每个元素
+    printInt(reduce_add(a));
+    printInt(extract(a, 2));
+    c = a + b * 2;
+    printInt(extract(c, 3) - extract(a, 0));
+    d = insert(a, 0, 42);
+    printInt(extract(d, 0) + extract(d, 2));
+
+    // shuffle 的下标为常量，双操作数时 b 的下标接在 a 之后
+    printInt(extract(shuffle(a, 3, 2, 1, 0), 0));
+    printInt(extract(shuffle(e, 7, 0), 0));
+    printInt(extract(shuffle(a, b, 0, 4), 1) + extract(shuffle(a, b, 0, 4), 0));
+
+    // 比较得到掩码，用于 select、any 和 all
+    printBool(any(a < 2));
+    printBool(all(a < 4));
+    printBool(all(a < 5));
+    c = select(a < 3, a * 100, b);
+    printInt(extract(c, 0) + extract(c, 3) - extract(c, 1) / 200);
+    printInt(reduce_mul(a));
+    printInt(reduce_min(scale(a, 3)) - 2);
+    printInt(reduce_max(e));
+    printInt(reduce_add(e) + 0);
+
+    // 浮点向量按元素顺序归约
+    printDouble(extract(x, 2));
+    y = shuffle(x, 1, 3);
+    printDouble(reduce_mul(y) - 1.0 * 0.25 + 0.75);
+    printDouble(reduce_min(x - x));
+    printFloat(reduce_add(f * f * 2.0f));
+    return 0;
+}